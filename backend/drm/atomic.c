@@ -1,5 +1,9 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
 #include <gbm.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -10,6 +14,10 @@
 struct atomic {
 	drmModeAtomicReq *req;
 	bool failed;
+
+	// IN_FENCE_FD values, closed once the request has been committed
+	int *fence_fds;
+	size_t fence_fds_len;
 };
 
 static void atomic_begin(struct atomic *atom) {
@@ -45,6 +53,10 @@ static bool atomic_commit(struct atomic *atom,
 
 static void atomic_finish(struct atomic *atom) {
 	drmModeAtomicFree(atom->req);
+	for (size_t i = 0; i < atom->fence_fds_len; i++) {
+		close(atom->fence_fds[i]);
+	}
+	free(atom->fence_fds);
 }
 
 static void atomic_add(struct atomic *atom, uint32_t id, uint32_t prop, uint64_t val) {
@@ -54,6 +66,26 @@ static void atomic_add(struct atomic *atom, uint32_t id, uint32_t prop, uint64_t
 	}
 }
 
+/**
+ * Add a property whose value is a file descriptor. Takes ownership of the
+ * file descriptor, which is kept open until the request is committed.
+ */
+static void atomic_add_fd(struct atomic *atom, uint32_t id, uint32_t prop,
+		int fd) {
+	int *fds = realloc(atom->fence_fds,
+		(atom->fence_fds_len + 1) * sizeof(fds[0]));
+	if (fds == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		close(fd);
+		atom->failed = true;
+		return;
+	}
+	atom->fence_fds = fds;
+	atom->fence_fds[atom->fence_fds_len++] = fd;
+
+	atomic_add(atom, id, prop, fd);
+}
+
 static bool create_mode_blob(struct wlr_drm_backend *drm,
 		struct wlr_drm_connector *conn, const struct wlr_output_state *state,
 		uint32_t *blob_id) {
@@ -134,15 +166,11 @@ static void plane_disable(struct atomic *atom, struct wlr_drm_plane *plane) {
 	atomic_add(atom, id, props->crtc_id, 0);
 }
 
-static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
-		struct wlr_drm_plane *plane, uint32_t crtc_id, int32_t x, int32_t y) {
+static void set_plane_fb_props(struct atomic *atom,
+		struct wlr_drm_plane *plane, struct wlr_drm_fb *fb, uint32_t crtc_id,
+		const struct wlr_box *dst) {
 	uint32_t id = plane->id;
 	const union wlr_drm_plane_props *props = &plane->props;
-	struct wlr_drm_fb *fb = plane_get_next_fb(plane);
-	if (fb == NULL) {
-		wlr_log(WLR_ERROR, "Failed to acquire FB");
-		goto error;
-	}
 
 	uint32_t width = gbm_bo_get_width(fb->bo);
 	uint32_t height = gbm_bo_get_height(fb->bo);
@@ -152,12 +180,38 @@ static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
 	atomic_add(atom, id, props->src_y, 0);
 	atomic_add(atom, id, props->src_w, (uint64_t)width << 16);
 	atomic_add(atom, id, props->src_h, (uint64_t)height << 16);
-	atomic_add(atom, id, props->crtc_w, width);
-	atomic_add(atom, id, props->crtc_h, height);
+	atomic_add(atom, id, props->crtc_w, dst->width);
+	atomic_add(atom, id, props->crtc_h, dst->height);
 	atomic_add(atom, id, props->fb_id, fb->id);
 	atomic_add(atom, id, props->crtc_id, crtc_id);
-	atomic_add(atom, id, props->crtc_x, (uint64_t)x);
-	atomic_add(atom, id, props->crtc_y, (uint64_t)y);
+	atomic_add(atom, id, props->crtc_x, (uint64_t)dst->x);
+	atomic_add(atom, id, props->crtc_y, (uint64_t)dst->y);
+
+	// Let the kernel wait for the producer instead of relying on implicit
+	// synchronization
+	if (props->in_fence_fd != 0) {
+		int fence_fd = wlr_buffer_dup_acquire_fence(fb->wlr_buf);
+		if (fence_fd >= 0) {
+			atomic_add_fd(atom, id, props->in_fence_fd, fence_fd);
+		}
+	}
+}
+
+static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
+		struct wlr_drm_plane *plane, uint32_t crtc_id, int32_t x, int32_t y) {
+	struct wlr_drm_fb *fb = plane_get_next_fb(plane);
+	if (fb == NULL) {
+		wlr_log(WLR_ERROR, "Failed to acquire FB");
+		goto error;
+	}
+
+	struct wlr_box dst = {
+		.x = x,
+		.y = y,
+		.width = gbm_bo_get_width(fb->bo),
+		.height = gbm_bo_get_height(fb->bo),
+	};
+	set_plane_fb_props(atom, plane, fb, crtc_id, &dst);
 
 	return;
 
@@ -166,6 +220,47 @@ error:
 	atom->failed = true;
 }
 
+/**
+ * Attach the commit's out fence to the buffer replaced by next_fb, if any.
+ * The fence is signalled once the new buffer is displayed, at which point
+ * the previous one isn't read by the display engine anymore.
+ */
+static void plane_add_release_fence(struct wlr_drm_plane *plane,
+		struct wlr_drm_fb *next_fb, int out_fence_fd) {
+	struct wlr_drm_fb *fb =
+		plane->queued_fb != NULL ? plane->queued_fb : plane->current_fb;
+	if (fb == NULL || fb == next_fb) {
+		return;
+	}
+
+	int fence_fd = fcntl(out_fence_fd, F_DUPFD_CLOEXEC, 0);
+	if (fence_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to duplicate out fence");
+		return;
+	}
+	wlr_buffer_add_release_fence(fb->wlr_buf, fence_fd);
+}
+
+static void crtc_add_release_fences(struct wlr_drm_connector *conn,
+		const struct wlr_output_state *state, int out_fence_fd) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	plane_add_release_fence(crtc->primary,
+		plane_get_next_fb(crtc->primary), out_fence_fd);
+	if (crtc->cursor) {
+		struct wlr_drm_fb *next_fb = drm_connector_is_cursor_visible(conn) ?
+			plane_get_next_fb(crtc->cursor) : NULL;
+		plane_add_release_fence(crtc->cursor, next_fb, out_fence_fd);
+	}
+	if (state->committed & WLR_OUTPUT_STATE_LAYERS) {
+		for (size_t i = 0; i < crtc->overlays_len; i++) {
+			struct wlr_drm_plane *overlay = crtc->overlays[i];
+			plane_add_release_fence(overlay, overlay->pending_fb,
+				out_fence_fd);
+		}
+	}
+}
+
 static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		struct wlr_drm_connector *conn, const struct wlr_output_state *state,
 		uint32_t flags) {
@@ -240,11 +335,34 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 				plane_disable(&atom, crtc->cursor);
 			}
 		}
+		// Overlay planes are left untouched unless the layers are updated
+		if (state->committed & WLR_OUTPUT_STATE_LAYERS) {
+			for (size_t i = 0; i < crtc->overlays_len; i++) {
+				struct wlr_drm_plane *overlay = crtc->overlays[i];
+				if (overlay->pending_fb != NULL) {
+					set_plane_fb_props(&atom, overlay, overlay->pending_fb,
+						crtc->id, &overlay->pending_dst);
+				} else {
+					plane_disable(&atom, overlay);
+				}
+			}
+		}
 	} else {
 		plane_disable(&atom, crtc->primary);
 		if (crtc->cursor) {
 			plane_disable(&atom, crtc->cursor);
 		}
+		for (size_t i = 0; i < crtc->overlays_len; i++) {
+			plane_disable(&atom, crtc->overlays[i]);
+		}
+	}
+
+	// The kernel writes a sync_file signalled when the commit is applied
+	int32_t out_fence_fd = -1;
+	if (active && crtc->props.out_fence_ptr != 0 &&
+			!(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+		atomic_add(&atom, crtc->id, crtc->props.out_fence_ptr,
+			(uint64_t)(uintptr_t)&out_fence_fd);
 	}
 
 	bool ok = atomic_commit(&atom, conn, flags);
@@ -254,6 +372,11 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		commit_blob(drm, &crtc->mode_id, mode_id);
 		commit_blob(drm, &crtc->gamma_lut, gamma_lut);
 
+		if (out_fence_fd >= 0) {
+			crtc_add_release_fences(conn, state, out_fence_fd);
+			close(out_fence_fd);
+		}
+
 		if (vrr_enabled != prev_vrr_enabled) {
 			output->adaptive_sync_status = vrr_enabled ?
 				WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED :
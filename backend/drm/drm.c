@@ -17,6 +17,7 @@
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -30,6 +31,7 @@
 #include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
 #include "util/signal.h"
+#include "util/time.h"
 
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL |
@@ -89,6 +91,18 @@ bool check_drm_features(struct wlr_drm_backend *drm) {
 	int ret = drmGetCap(drm->fd, DRM_CAP_TIMESTAMP_MONOTONIC, &cap);
 	drm->clock = (ret == 0 && cap == 1) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
 
+	const char *predictive = getenv("WLR_DRM_PREDICTIVE_FRAME_SCHEDULING");
+	if (predictive != NULL && strcmp(predictive, "1") == 0) {
+		if (drm->clock == CLOCK_MONOTONIC) {
+			wlr_log(WLR_DEBUG, "WLR_DRM_PREDICTIVE_FRAME_SCHEDULING set, "
+				"delaying frame events until the vblank deadline");
+			drm->predictive_frame_scheduling = true;
+		} else {
+			wlr_log(WLR_ERROR, "Predictive frame scheduling requires "
+				"monotonic DRM timestamps");
+		}
+	}
+
 	const char *no_modifiers = getenv("WLR_DRM_NO_MODIFIERS");
 	if (no_modifiers != NULL && strcmp(no_modifiers, "1") == 0) {
 		wlr_log(WLR_DEBUG, "WLR_DRM_NO_MODIFIERS set, disabling modifiers");
@@ -118,6 +132,12 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	p->id = drm_plane->plane_id;
 	p->props = *props;
 
+	if (p->props.zpos != 0 && !get_drm_prop(drm->fd, p->id, p->props.zpos,
+			&p->zpos)) {
+		wlr_log(WLR_DEBUG, "Failed to read zpos of plane %"PRIu32, p->id);
+		p->zpos = 0;
+	}
+
 	for (size_t j = 0; j < drm_plane->count_formats; ++j) {
 		wlr_drm_format_set_add(&p->formats, drm_plane->formats[j],
 			DRM_FORMAT_MOD_INVALID);
@@ -166,6 +186,25 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	case DRM_PLANE_TYPE_CURSOR:
 		crtc->cursor = p;
 		break;
+	case DRM_PLANE_TYPE_OVERLAY:;
+		struct wlr_drm_plane **overlays = realloc(crtc->overlays,
+			(crtc->overlays_len + 1) * sizeof(crtc->overlays[0]));
+		if (overlays == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			goto error;
+		}
+		crtc->overlays = overlays;
+
+		// Keep the overlays sorted by zpos, so that layers can be assigned
+		// from bottom to top
+		size_t i = crtc->overlays_len;
+		while (i > 0 && overlays[i - 1]->zpos > p->zpos) {
+			overlays[i] = overlays[i - 1];
+			i--;
+		}
+		overlays[i] = p;
+		crtc->overlays_len++;
+		break;
 	default:
 		abort();
 	}
@@ -173,6 +212,7 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	return true;
 
 error:
+	wlr_drm_format_set_finish(&p->formats);
 	free(p);
 	return false;
 }
@@ -207,13 +247,6 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 			goto error;
 		}
 
-		// We don't really care about overlay planes, as we don't support them
-		// yet.
-		if (type == DRM_PLANE_TYPE_OVERLAY) {
-			drmModeFreePlane(plane);
-			continue;
-		}
-
 		assert(drm->num_crtcs <= 32);
 		struct wlr_drm_crtc *crtc = NULL;
 		for (size_t j = 0; j < drm->num_crtcs ; j++) {
@@ -223,6 +256,15 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 			}
 
 			struct wlr_drm_crtc *candidate = &drm->crtcs[j];
+			if (type == DRM_PLANE_TYPE_OVERLAY) {
+				// Overlay planes are statically assigned, spread them evenly
+				// across the CRTCs they support
+				if (crtc == NULL ||
+						candidate->overlays_len < crtc->overlays_len) {
+					crtc = candidate;
+				}
+				continue;
+			}
 			if ((type == DRM_PLANE_TYPE_PRIMARY && !candidate->primary) ||
 					(type == DRM_PLANE_TYPE_CURSOR && !candidate->cursor)) {
 				crtc = candidate;
@@ -318,6 +360,11 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 			wlr_drm_format_set_finish(&crtc->cursor->formats);
 			free(crtc->cursor);
 		}
+		for (size_t j = 0; j < crtc->overlays_len; j++) {
+			wlr_drm_format_set_finish(&crtc->overlays[j]->formats);
+			free(crtc->overlays[j]);
+		}
+		free(crtc->overlays);
 	}
 
 	free(drm->crtcs);
@@ -348,17 +395,34 @@ static bool drm_crtc_commit(struct wlr_drm_connector *conn,
 		const struct wlr_output_state *state, uint32_t flags) {
 	struct wlr_drm_backend *drm = conn->backend;
 	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	bool ok = drm->iface->crtc_commit(drm, conn, state, flags);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	bool layers = state->committed & WLR_OUTPUT_STATE_LAYERS;
 	if (ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+		wlr_output_record_commit_time(&conn->output, &start, &end);
+
 		drm_plane_set_committed(crtc->primary);
 		if (crtc->cursor != NULL) {
 			drm_plane_set_committed(crtc->cursor);
 		}
+		if (layers) {
+			for (size_t i = 0; i < crtc->overlays_len; i++) {
+				drm_plane_set_committed(crtc->overlays[i]);
+			}
+			crtc->overlays_queued = true;
+		}
 	} else {
 		drm_fb_clear(&crtc->primary->pending_fb);
 		if (crtc->cursor != NULL) {
 			drm_fb_clear(&crtc->cursor->pending_fb);
 		}
+		for (size_t i = 0; i < crtc->overlays_len; i++) {
+			drm_fb_clear(&crtc->overlays[i]->pending_fb);
+		}
 	}
 	return ok;
 }
@@ -433,6 +497,86 @@ static bool drm_connector_set_pending_fb(struct wlr_drm_connector *conn,
 	return true;
 }
 
+/**
+ * Try to assign each layer to an overlay plane. Layers are added one by one
+ * and checked with a test-only commit: the ones rejected by the kernel are left
+ * for the compositor to composite.
+ */
+static void drm_connector_set_pending_layers(struct wlr_drm_connector *conn,
+		const struct wlr_output_state *state) {
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	assert(crtc != NULL);
+
+	for (size_t i = 0; i < crtc->overlays_len; i++) {
+		drm_fb_clear(&crtc->overlays[i]->pending_fb);
+	}
+	for (size_t i = 0; i < state->layers_len; i++) {
+		state->layers[i].accepted = false;
+	}
+
+	if (crtc->overlays_len == 0 || state->layers_len == 0) {
+		return;
+	}
+	if (drm->iface == &legacy_iface) {
+		wlr_drm_conn_log(conn, WLR_DEBUG,
+			"Cannot use overlay planes with legacy KMS API");
+		return;
+	}
+	if (drm->parent != NULL) {
+		// Client buffers are allocated on the parent GPU
+		return;
+	}
+	if (drm_connector_state_is_modeset(state)) {
+		return;
+	}
+
+	// Layers are displayed above the primary buffer: skip the overlay planes
+	// which the hardware stacks below (or at the same zpos as) the primary
+	// plane, since their contents would be hidden
+	size_t next_overlay = 0;
+	struct wlr_drm_plane *primary = crtc->primary;
+	if (primary->props.zpos != 0) {
+		while (next_overlay < crtc->overlays_len) {
+			struct wlr_drm_plane *plane = crtc->overlays[next_overlay];
+			if (plane->props.zpos != 0 && plane->zpos > primary->zpos) {
+				break;
+			}
+			next_overlay++;
+		}
+	}
+
+	for (size_t i = 0; i < state->layers_len; i++) {
+		struct wlr_output_layer_state *layer_state = &state->layers[i];
+		if (layer_state->buffer == NULL) {
+			continue;
+		}
+		if (next_overlay == crtc->overlays_len) {
+			break;
+		}
+
+		struct wlr_drm_plane *plane = crtc->overlays[next_overlay];
+		if (!drm_fb_import(&plane->pending_fb, drm, layer_state->buffer,
+				&plane->formats)) {
+			wlr_drm_conn_log(conn, WLR_DEBUG,
+				"Failed to import buffer for layer %zu", i);
+			continue;
+		}
+		plane->pending_dst = layer_state->dst_box;
+
+		if (!drm->iface->crtc_commit(drm, conn, state,
+				DRM_MODE_ATOMIC_TEST_ONLY)) {
+			wlr_drm_conn_log(conn, WLR_DEBUG,
+				"Layer %zu rejected by plane %"PRIu32, i, plane->id);
+			drm_fb_clear(&plane->pending_fb);
+			continue;
+		}
+
+		layer_state->accepted = true;
+		next_overlay++;
+	}
+}
+
 static bool drm_connector_alloc_crtc(struct wlr_drm_connector *conn);
 
 static bool drm_connector_test(struct wlr_output *output) {
@@ -467,6 +611,13 @@ static bool drm_connector_test(struct wlr_output *output) {
 		}
 	}
 
+	// Drop overlay buffers left over by a previous test
+	if (conn->crtc != NULL) {
+		for (size_t i = 0; i < conn->crtc->overlays_len; i++) {
+			drm_fb_clear(&conn->crtc->overlays[i]->pending_fb);
+		}
+	}
+
 	if ((output->pending.committed & WLR_OUTPUT_STATE_BUFFER) &&
 			output->pending.buffer_type == WLR_OUTPUT_STATE_BUFFER_SCANOUT) {
 		if (!drm_connector_set_pending_fb(conn, &output->pending)) {
@@ -477,6 +628,13 @@ static bool drm_connector_test(struct wlr_output *output) {
 		}
 	}
 
+	// Leaves the accepted layers in the overlay planes' pending_fb, for the
+	// commit which follows
+	if ((output->pending.committed & WLR_OUTPUT_STATE_LAYERS) &&
+			conn->crtc != NULL) {
+		drm_connector_set_pending_layers(conn, &output->pending);
+	}
+
 	return true;
 }
 
@@ -564,6 +722,8 @@ bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 	return true;
 }
 
+static void drm_connector_handle_frame_commit(struct wlr_drm_connector *conn);
+
 static bool drm_connector_commit(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 
@@ -571,7 +731,15 @@ static bool drm_connector_commit(struct wlr_output *output) {
 		return false;
 	}
 
-	return drm_connector_commit_state(conn, &output->pending);
+	if (!drm_connector_commit_state(conn, &output->pending)) {
+		return false;
+	}
+
+	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+		drm_connector_handle_frame_commit(conn);
+	}
+
+	return true;
 }
 
 static void drm_connector_rollback_render(struct wlr_output *output) {
@@ -607,6 +775,26 @@ static size_t drm_connector_get_gamma_size(struct wlr_output *output) {
 	return drm_crtc_get_gamma_lut_size(drm, crtc);
 }
 
+static struct wlr_buffer *drm_connector_get_render_buffer(
+		struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	if (conn->backend->parent) {
+		// The rendered buffer lives on the parent GPU, we only have a copy
+		return NULL;
+	}
+	if (!crtc) {
+		return NULL;
+	}
+
+	struct wlr_drm_fb *fb = crtc->primary->queued_fb;
+	if (fb == NULL) {
+		fb = crtc->primary->current_fb;
+	}
+	return fb != NULL ? fb->wlr_buf : NULL;
+}
+
 static bool drm_connector_export_dmabuf(struct wlr_output *output,
 		struct wlr_dmabuf_attributes *attribs) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -1007,6 +1195,11 @@ static void drm_connector_destroy_output(struct wlr_output *output) {
 	conn->possible_crtcs = 0;
 	conn->pending_page_flip_crtc = 0;
 
+	if (conn->frame_schedule.timer != NULL) {
+		wl_event_source_remove(conn->frame_schedule.timer);
+	}
+	memset(&conn->frame_schedule, 0, sizeof(conn->frame_schedule));
+
 	struct wlr_drm_mode *mode, *mode_tmp;
 	wl_list_for_each_safe(mode, mode_tmp, &conn->output.modes, wlr_mode.link) {
 		wl_list_remove(&mode->wlr_mode.link);
@@ -1052,6 +1245,7 @@ static const struct wlr_output_impl output_impl = {
 	.rollback_render = drm_connector_rollback_render,
 	.get_gamma_size = drm_connector_get_gamma_size,
 	.export_dmabuf = drm_connector_export_dmabuf,
+	.get_render_buffer = drm_connector_get_render_buffer,
 	.get_cursor_formats = drm_connector_get_cursor_formats,
 	.get_cursor_size = drm_connector_get_cursor_size,
 };
@@ -1133,6 +1327,10 @@ static void dealloc_crtc(struct wlr_drm_connector *conn) {
 
 	drm_plane_finish_surface(conn->crtc->primary);
 	drm_plane_finish_surface(conn->crtc->cursor);
+	for (size_t i = 0; i < conn->crtc->overlays_len; i++) {
+		drm_plane_finish_surface(conn->crtc->overlays[i]);
+	}
+	conn->crtc->overlays_queued = false;
 
 	conn->cursor_enabled = false;
 	conn->crtc = NULL;
@@ -1515,6 +1713,133 @@ static int mhz_to_nsec(int mhz) {
 	return 1000000000000LL / mhz;
 }
 
+// Bounds and step sizes of the safety margin used by predictive frame
+// scheduling, in nanoseconds. The margin grows quickly after a missed vblank
+// and shrinks slowly while deadlines are met.
+#define FRAME_SCHEDULE_MIN_MARGIN 1000000
+#define FRAME_SCHEDULE_MISS_STEP 1000000
+#define FRAME_SCHEDULE_HIT_STEP 50000
+
+static int64_t get_monotonic_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void drm_connector_send_frame(struct wlr_drm_connector *conn) {
+	conn->frame_schedule.frame_sent = get_monotonic_nsec();
+	wlr_output_send_frame(&conn->output);
+}
+
+static int handle_frame_schedule_timer(void *data) {
+	struct wlr_drm_connector *conn = data;
+	if (conn->backend->session->active && conn->output.enabled) {
+		drm_connector_send_frame(conn);
+	}
+	return 0;
+}
+
+static void drm_connector_handle_frame_commit(struct wlr_drm_connector *conn) {
+	if (conn->frame_schedule.frame_sent == 0) {
+		// This frame wasn't triggered by a frame event we've scheduled
+		return;
+	}
+
+	int64_t now = get_monotonic_nsec();
+	int64_t refresh = conn->output.refresh > 0 ?
+		mhz_to_nsec(conn->output.refresh) : 0;
+	if (refresh == 0 || now > conn->frame_schedule.deadline + refresh) {
+		// The compositor went idle after the last frame event, and this
+		// frame was triggered by something else (e.g. an idle frame
+		// scheduled via wlr_output_schedule_frame): measuring it against
+		// the stale frame event would poison the estimate
+		conn->frame_schedule.frame_sent = 0;
+		conn->frame_schedule.deadline = 0;
+		return;
+	}
+
+	int64_t duration = now - conn->frame_schedule.frame_sent;
+	if (duration > refresh) {
+		duration = refresh;
+	}
+	int64_t *avg = &conn->frame_schedule.render_duration;
+	if (*avg == 0) {
+		*avg = duration;
+	} else {
+		*avg += (duration - *avg) / 8;
+	}
+
+	conn->frame_schedule.target = conn->frame_schedule.deadline;
+	conn->frame_schedule.frame_sent = 0;
+	conn->frame_schedule.deadline = 0;
+}
+
+/**
+ * Send a frame event for the next vblank. With predictive frame scheduling,
+ * the frame event is delayed so that the compositor starts rendering as late
+ * as possible: just before the vblank deadline minus the estimated time it
+ * takes to render and commit a frame, minus a safety margin which adapts to
+ * missed deadlines.
+ */
+static void drm_connector_schedule_frame(struct wlr_drm_connector *conn,
+		const struct timespec *present_time) {
+	struct wlr_output *output = &conn->output;
+	if (!conn->backend->predictive_frame_scheduling || output->refresh <= 0 ||
+			output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED) {
+		drm_connector_send_frame(conn);
+		return;
+	}
+
+	int64_t refresh = mhz_to_nsec(output->refresh);
+	int64_t present = timespec_to_nsec(present_time);
+	int64_t max_margin = refresh / 2;
+	int64_t *margin = &conn->frame_schedule.margin;
+	if (*margin == 0) {
+		*margin = refresh / 4;
+	}
+
+	int64_t target = conn->frame_schedule.target;
+	if (target != 0) {
+		// A frame presented more than half a refresh cycle after its
+		// deadline missed its vblank
+		if (present > target + refresh / 2) {
+			*margin += FRAME_SCHEDULE_MISS_STEP;
+		} else {
+			*margin -= FRAME_SCHEDULE_HIT_STEP;
+		}
+		if (*margin > max_margin) {
+			*margin = max_margin;
+		} else if (*margin < FRAME_SCHEDULE_MIN_MARGIN) {
+			*margin = FRAME_SCHEDULE_MIN_MARGIN;
+		}
+		conn->frame_schedule.target = 0;
+	}
+
+	int64_t deadline = present + refresh;
+	conn->frame_schedule.deadline = deadline;
+
+	int64_t delay = deadline - conn->frame_schedule.render_duration - *margin -
+		get_monotonic_nsec();
+	int delay_ms = delay / 1000000;
+	if (delay_ms <= 0) {
+		drm_connector_send_frame(conn);
+		return;
+	}
+
+	if (conn->frame_schedule.timer == NULL) {
+		struct wl_event_loop *loop =
+			wl_display_get_event_loop(conn->backend->display);
+		conn->frame_schedule.timer = wl_event_loop_add_timer(loop,
+			handle_frame_schedule_timer, conn);
+		if (conn->frame_schedule.timer == NULL) {
+			wlr_drm_conn_log(conn, WLR_ERROR, "Failed to create timer");
+			drm_connector_send_frame(conn);
+			return;
+		}
+	}
+	wl_event_source_timer_update(conn->frame_schedule.timer, delay_ms);
+}
+
 static void page_flip_handler(int fd, unsigned seq,
 		unsigned tv_sec, unsigned tv_usec, unsigned crtc_id, void *data) {
 	struct wlr_drm_backend *drm = data;
@@ -1548,6 +1873,14 @@ static void page_flip_handler(int fd, unsigned seq,
 		drm_fb_move(&conn->crtc->cursor->current_fb,
 			&conn->crtc->cursor->queued_fb);
 	}
+	if (conn->crtc->overlays_queued) {
+		// Disabled overlays have a NULL queued_fb, release their buffer too
+		for (size_t i = 0; i < conn->crtc->overlays_len; i++) {
+			struct wlr_drm_plane *overlay = conn->crtc->overlays[i];
+			drm_fb_move(&overlay->current_fb, &overlay->queued_fb);
+		}
+		conn->crtc->overlays_queued = false;
+	}
 
 	uint32_t present_flags = WLR_OUTPUT_PRESENT_VSYNC |
 		WLR_OUTPUT_PRESENT_HW_CLOCK | WLR_OUTPUT_PRESENT_HW_COMPLETION;
@@ -1576,7 +1909,7 @@ static void page_flip_handler(int fd, unsigned seq,
 	wlr_output_send_present(&conn->output, &present_event);
 
 	if (drm->session->active && conn->output.enabled) {
-		wlr_output_send_frame(&conn->output);
+		drm_connector_schedule_frame(conn, &present_time);
 	}
 }
 
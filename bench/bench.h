@@ -0,0 +1,61 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+
+/**
+ * Compositor state shared by all benchmarks: a headless backend with the
+ * Pixman renderer, so that results don't depend on the GPU.
+ */
+struct bench_server {
+	struct wl_display *display;
+	struct wl_event_loop *event_loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_compositor *compositor;
+	struct wlr_seat *seat;
+};
+
+/**
+ * An in-process Wayland client connected to the bench server. Requests are
+ * dispatched by pumping both sides of the connection from the same thread.
+ */
+struct bench_client {
+	struct bench_server *server;
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct wl_seat *seat;
+	struct wl_client *wl_client; // server side
+};
+
+struct bench {
+	const char *name;
+	// Prepare the benchmark state, returns NULL on failure
+	void *(*setup)(struct bench_server *server);
+	// Run the benchmarked operation `iters` times
+	void (*run)(void *state, size_t iters);
+	void (*teardown)(void *state);
+};
+
+extern const struct bench benches[];
+extern const size_t benches_len;
+
+struct bench_client *bench_client_create(struct bench_server *server);
+void bench_client_destroy(struct bench_client *client);
+/**
+ * Flush the client's requests and let the server process them, until the
+ * server has replied to all of them.
+ */
+bool bench_client_roundtrip(struct bench_client *client);
+/**
+ * Create a shm buffer filled with opaque pixels.
+ */
+struct wl_buffer *bench_client_create_buffer(struct bench_client *client,
+	int width, int height);
+
+#endif
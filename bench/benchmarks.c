@@ -0,0 +1,491 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pixman.h>
+#include <stdlib.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+#include <wlr/backend/headless.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/region.h>
+#include "bench.h"
+#include "util/signal.h"
+
+#define OUTPUT_WIDTH 1920
+#define OUTPUT_HEIGHT 1080
+
+/**
+ * Deterministic pseudo-random numbers, so that runs are comparable.
+ */
+static uint32_t next_random(uint32_t *state) {
+	*state = *state * 1103515245 + 12345;
+	return (*state >> 16) & 0x7FFF;
+}
+
+/* Signal emission */
+
+#define SIGNAL_LISTENERS_LEN 64
+
+struct signal_state {
+	struct wl_signal signal;
+	struct wl_listener listeners[SIGNAL_LISTENERS_LEN];
+	size_t count;
+};
+
+static void signal_handle_notify(struct wl_listener *listener, void *data) {
+	struct signal_state *state = data;
+	state->count++;
+}
+
+static void *signal_setup(struct bench_server *server) {
+	struct signal_state *state = calloc(1, sizeof(*state));
+	if (state == NULL) {
+		return NULL;
+	}
+	wl_signal_init(&state->signal);
+	for (size_t i = 0; i < SIGNAL_LISTENERS_LEN; i++) {
+		state->listeners[i].notify = signal_handle_notify;
+		wl_signal_add(&state->signal, &state->listeners[i]);
+	}
+	return state;
+}
+
+static void signal_run(void *data, size_t iters) {
+	struct signal_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		wlr_signal_emit_safe(&state->signal, state);
+	}
+}
+
+static void signal_teardown(void *data) {
+	struct signal_state *state = data;
+	for (size_t i = 0; i < SIGNAL_LISTENERS_LEN; i++) {
+		wl_list_remove(&state->listeners[i].link);
+	}
+	free(state);
+}
+
+/* Region transformations */
+
+struct region_state {
+	pixman_region32_t src, dst;
+};
+
+static void *region_setup(struct bench_server *server) {
+	struct region_state *state = calloc(1, sizeof(*state));
+	if (state == NULL) {
+		return NULL;
+	}
+	pixman_region32_init(&state->src);
+	pixman_region32_init(&state->dst);
+
+	// A checkerboard of 64 disjoint rectangles
+	for (int y = 0; y < 16; y++) {
+		for (int x = y % 2; x < 8; x += 2) {
+			pixman_region32_union_rect(&state->src, &state->src,
+				x * 200, y * 60, 100, 30);
+		}
+	}
+	return state;
+}
+
+static void region_transform_run(void *data, size_t iters) {
+	struct region_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		wlr_region_transform(&state->dst, &state->src,
+			WL_OUTPUT_TRANSFORM_90, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	}
+}
+
+static void region_scale_run(void *data, size_t iters) {
+	struct region_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		wlr_region_scale(&state->dst, &state->src, 1.5);
+	}
+}
+
+static void region_teardown(void *data) {
+	struct region_state *state = data;
+	pixman_region32_fini(&state->src);
+	pixman_region32_fini(&state->dst);
+	free(state);
+}
+
+/* Output damage tracking */
+
+#define DAMAGE_BOXES_LEN 32
+
+struct damage_state {
+	struct wlr_output *output;
+	struct wlr_output_damage *damage;
+	struct wlr_box boxes[DAMAGE_BOXES_LEN];
+	pixman_region32_t buffer_damage;
+};
+
+static void damage_teardown(void *data);
+
+static void *damage_setup(struct bench_server *server) {
+	struct damage_state *state = calloc(1, sizeof(*state));
+	if (state == NULL) {
+		return NULL;
+	}
+	pixman_region32_init(&state->buffer_damage);
+
+	state->output = wlr_headless_add_output(server->backend,
+		OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	if (state->output == NULL) {
+		damage_teardown(state);
+		return NULL;
+	}
+	wlr_output_enable(state->output, true);
+	if (!wlr_output_commit(state->output)) {
+		damage_teardown(state);
+		return NULL;
+	}
+
+	state->damage = wlr_output_damage_create(state->output);
+	if (state->damage == NULL) {
+		damage_teardown(state);
+		return NULL;
+	}
+
+	uint32_t seed = 1;
+	for (size_t i = 0; i < DAMAGE_BOXES_LEN; i++) {
+		state->boxes[i] = (struct wlr_box){
+			.x = next_random(&seed) % OUTPUT_WIDTH,
+			.y = next_random(&seed) % OUTPUT_HEIGHT,
+			.width = 16 + next_random(&seed) % 256,
+			.height = 16 + next_random(&seed) % 256,
+		};
+	}
+
+	return state;
+}
+
+static void damage_add_run(void *data, size_t iters) {
+	struct damage_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		for (size_t j = 0; j < DAMAGE_BOXES_LEN; j++) {
+			wlr_output_damage_add_box(state->damage, &state->boxes[j]);
+		}
+		pixman_region32_clear(&state->damage->current);
+	}
+}
+
+static void *damage_attach_render_setup(struct bench_server *server) {
+	struct damage_state *state = damage_setup(server);
+	if (state == NULL) {
+		return NULL;
+	}
+
+	bool needs_frame;
+	if (!wlr_output_damage_attach_render(state->damage, &needs_frame,
+			&state->buffer_damage)) {
+		damage_teardown(state);
+		return NULL;
+	}
+	wlr_output_rollback(state->output);
+
+	return state;
+}
+
+static void damage_attach_render_run(void *data, size_t iters) {
+	struct damage_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		for (size_t j = 0; j < DAMAGE_BOXES_LEN; j++) {
+			wlr_output_damage_add_box(state->damage, &state->boxes[j]);
+		}
+
+		bool needs_frame;
+		wlr_output_damage_attach_render(state->damage, &needs_frame,
+			&state->buffer_damage);
+		wlr_output_rollback(state->output);
+		pixman_region32_clear(&state->damage->current);
+	}
+}
+
+static void damage_teardown(void *data) {
+	struct damage_state *state = data;
+	if (state->damage != NULL) {
+		wlr_output_damage_destroy(state->damage);
+	}
+	wlr_output_destroy(state->output);
+	pixman_region32_fini(&state->buffer_damage);
+	free(state);
+}
+
+/* Output layout hit tests */
+
+#define LAYOUT_GRID 4
+#define LAYOUT_OUTPUTS_LEN (LAYOUT_GRID * LAYOUT_GRID)
+#define LAYOUT_POINTS_LEN 1024
+
+struct layout_state {
+	struct wlr_output_layout *layout;
+	struct wlr_output *outputs[LAYOUT_OUTPUTS_LEN];
+	double points[LAYOUT_POINTS_LEN][2];
+	size_t hits;
+};
+
+static void layout_teardown(void *data);
+
+static void *layout_setup(struct bench_server *server) {
+	struct layout_state *state = calloc(1, sizeof(*state));
+	if (state == NULL) {
+		return NULL;
+	}
+
+	state->layout = wlr_output_layout_create();
+	if (state->layout == NULL) {
+		layout_teardown(state);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < LAYOUT_OUTPUTS_LEN; i++) {
+		struct wlr_output *output = wlr_headless_add_output(server->backend,
+			OUTPUT_WIDTH, OUTPUT_HEIGHT);
+		if (output == NULL) {
+			layout_teardown(state);
+			return NULL;
+		}
+		state->outputs[i] = output;
+		wlr_output_layout_add(state->layout, output,
+			(i % LAYOUT_GRID) * OUTPUT_WIDTH, (i / LAYOUT_GRID) * OUTPUT_HEIGHT);
+	}
+
+	// Some points fall outside of the layout
+	uint32_t seed = 1;
+	for (size_t i = 0; i < LAYOUT_POINTS_LEN; i++) {
+		state->points[i][0] = (double)(next_random(&seed) %
+			(LAYOUT_GRID * OUTPUT_WIDTH + OUTPUT_WIDTH)) - OUTPUT_WIDTH / 2;
+		state->points[i][1] = (double)(next_random(&seed) %
+			(LAYOUT_GRID * OUTPUT_HEIGHT + OUTPUT_HEIGHT)) - OUTPUT_HEIGHT / 2;
+	}
+
+	return state;
+}
+
+static void layout_output_at_run(void *data, size_t iters) {
+	struct layout_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		const double *point = state->points[i % LAYOUT_POINTS_LEN];
+		if (wlr_output_layout_output_at(state->layout,
+				point[0], point[1]) != NULL) {
+			state->hits++;
+		}
+	}
+}
+
+static void layout_closest_point_run(void *data, size_t iters) {
+	struct layout_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		const double *point = state->points[i % LAYOUT_POINTS_LEN];
+		double x, y;
+		wlr_output_layout_closest_point(state->layout, NULL,
+			point[0], point[1], &x, &y);
+	}
+}
+
+static void layout_teardown(void *data) {
+	struct layout_state *state = data;
+	wlr_output_layout_destroy(state->layout);
+	for (size_t i = 0; i < LAYOUT_OUTPUTS_LEN; i++) {
+		wlr_output_destroy(state->outputs[i]);
+	}
+	free(state);
+}
+
+/* Surface commits and pointer events, through a real client */
+
+// Number of requests or events sent before waiting for the other side, this
+// needs to be low enough for the socket buffers not to fill up
+#define CLIENT_BATCH_LEN 32
+#define SURFACE_SIZE 512
+#define SURFACE_DAMAGE_SIZE 32
+
+struct client_state {
+	struct bench_server *server;
+	struct bench_client *client;
+	struct wl_surface *surface;
+	struct wl_buffer *buffer;
+	struct wl_pointer *pointer;
+
+	struct wlr_surface *wlr_surface;
+	struct wl_listener new_surface;
+
+	uint32_t seed;
+	uint32_t time_msec;
+};
+
+static void client_handle_new_surface(struct wl_listener *listener,
+		void *data) {
+	struct client_state *state =
+		wl_container_of(listener, state, new_surface);
+	state->wlr_surface = data;
+}
+
+static void client_teardown(void *data);
+
+static void *client_setup(struct bench_server *server) {
+	struct client_state *state = calloc(1, sizeof(*state));
+	if (state == NULL) {
+		return NULL;
+	}
+	state->server = server;
+	state->seed = 1;
+
+	state->new_surface.notify = client_handle_new_surface;
+	wl_signal_add(&server->compositor->events.new_surface,
+		&state->new_surface);
+
+	state->client = bench_client_create(server);
+	if (state->client == NULL) {
+		client_teardown(state);
+		return NULL;
+	}
+
+	state->surface = wl_compositor_create_surface(state->client->compositor);
+	state->buffer = bench_client_create_buffer(state->client,
+		SURFACE_SIZE, SURFACE_SIZE);
+	if (state->buffer == NULL) {
+		client_teardown(state);
+		return NULL;
+	}
+	state->pointer = wl_seat_get_pointer(state->client->seat);
+
+	wl_surface_attach(state->surface, state->buffer, 0, 0);
+	wl_surface_damage_buffer(state->surface, 0, 0, SURFACE_SIZE, SURFACE_SIZE);
+	wl_surface_commit(state->surface);
+	if (!bench_client_roundtrip(state->client) || state->wlr_surface == NULL) {
+		client_teardown(state);
+		return NULL;
+	}
+
+	return state;
+}
+
+static void surface_commit_run(void *data, size_t iters) {
+	struct client_state *state = data;
+	for (size_t i = 0; i < iters; i++) {
+		int x = next_random(&state->seed) % (SURFACE_SIZE - SURFACE_DAMAGE_SIZE);
+		int y = next_random(&state->seed) % (SURFACE_SIZE - SURFACE_DAMAGE_SIZE);
+		wl_surface_attach(state->surface, state->buffer, 0, 0);
+		wl_surface_damage_buffer(state->surface, x, y,
+			SURFACE_DAMAGE_SIZE, SURFACE_DAMAGE_SIZE);
+		wl_surface_commit(state->surface);
+
+		if (i % CLIENT_BATCH_LEN == CLIENT_BATCH_LEN - 1) {
+			bench_client_roundtrip(state->client);
+		}
+	}
+	bench_client_roundtrip(state->client);
+}
+
+static void *pointer_motion_setup(struct bench_server *server) {
+	struct client_state *state = client_setup(server);
+	if (state == NULL) {
+		return NULL;
+	}
+
+	wlr_seat_pointer_notify_enter(server->seat, state->wlr_surface, 0, 0);
+	if (server->seat->pointer_state.focused_client == NULL) {
+		client_teardown(state);
+		return NULL;
+	}
+	return state;
+}
+
+static void pointer_motion_run(void *data, size_t iters) {
+	struct client_state *state = data;
+	struct wlr_seat *seat = state->server->seat;
+	for (size_t i = 0; i < iters; i++) {
+		double x = next_random(&state->seed) % SURFACE_SIZE;
+		double y = next_random(&state->seed) % SURFACE_SIZE;
+		wlr_seat_pointer_notify_motion(seat, state->time_msec++, x, y);
+		wlr_seat_pointer_notify_frame(seat);
+
+		if (i % CLIENT_BATCH_LEN == CLIENT_BATCH_LEN - 1) {
+			bench_client_roundtrip(state->client);
+		}
+	}
+	bench_client_roundtrip(state->client);
+}
+
+static void client_teardown(void *data) {
+	struct client_state *state = data;
+	wlr_seat_pointer_clear_focus(state->server->seat);
+	if (state->pointer != NULL) {
+		wl_pointer_release(state->pointer);
+	}
+	if (state->buffer != NULL) {
+		wl_buffer_destroy(state->buffer);
+	}
+	if (state->surface != NULL) {
+		wl_surface_destroy(state->surface);
+	}
+	bench_client_destroy(state->client);
+	wl_list_remove(&state->new_surface.link);
+	free(state);
+}
+
+const struct bench benches[] = {
+	{
+		.name = "signal_emit_safe",
+		.setup = signal_setup,
+		.run = signal_run,
+		.teardown = signal_teardown,
+	},
+	{
+		.name = "region_transform",
+		.setup = region_setup,
+		.run = region_transform_run,
+		.teardown = region_teardown,
+	},
+	{
+		.name = "region_scale",
+		.setup = region_setup,
+		.run = region_scale_run,
+		.teardown = region_teardown,
+	},
+	{
+		.name = "output_damage_add",
+		.setup = damage_setup,
+		.run = damage_add_run,
+		.teardown = damage_teardown,
+	},
+	{
+		.name = "output_damage_attach_render",
+		.setup = damage_attach_render_setup,
+		.run = damage_attach_render_run,
+		.teardown = damage_teardown,
+	},
+	{
+		.name = "output_layout_output_at",
+		.setup = layout_setup,
+		.run = layout_output_at_run,
+		.teardown = layout_teardown,
+	},
+	{
+		.name = "output_layout_closest_point",
+		.setup = layout_setup,
+		.run = layout_closest_point_run,
+		.teardown = layout_teardown,
+	},
+	{
+		.name = "surface_commit",
+		.setup = client_setup,
+		.run = surface_commit_run,
+		.teardown = client_teardown,
+	},
+	{
+		.name = "seat_pointer_motion",
+		.setup = pointer_motion_setup,
+		.run = pointer_motion_run,
+		.teardown = client_teardown,
+	},
+};
+
+const size_t benches_len = sizeof(benches) / sizeof(benches[0]);
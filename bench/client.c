@@ -0,0 +1,200 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+#include "bench.h"
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct bench_client *client = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		client->compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0) {
+		client->seat = wl_registry_bind(registry, name, &wl_seat_interface, 5);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// Who cares?
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+struct bench_client *bench_client_create(struct bench_server *server) {
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+		perror("socketpair failed");
+		return NULL;
+	}
+
+	struct bench_client *client = calloc(1, sizeof(*client));
+	if (client == NULL) {
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+	client->server = server;
+
+	client->wl_client = wl_client_create(server->display, fds[0]);
+	if (client->wl_client == NULL) {
+		fprintf(stderr, "wl_client_create failed\n");
+		close(fds[0]);
+		close(fds[1]);
+		free(client);
+		return NULL;
+	}
+
+	client->display = wl_display_connect_to_fd(fds[1]);
+	if (client->display == NULL) {
+		fprintf(stderr, "wl_display_connect_to_fd failed\n");
+		wl_client_destroy(client->wl_client);
+		close(fds[1]);
+		free(client);
+		return NULL;
+	}
+
+	client->registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(client->registry, &registry_listener, client);
+	if (!bench_client_roundtrip(client)) {
+		bench_client_destroy(client);
+		return NULL;
+	}
+
+	if (client->compositor == NULL || client->shm == NULL ||
+			client->seat == NULL) {
+		fprintf(stderr, "Missing globals\n");
+		bench_client_destroy(client);
+		return NULL;
+	}
+
+	return client;
+}
+
+void bench_client_destroy(struct bench_client *client) {
+	if (client == NULL) {
+		return;
+	}
+	if (client->seat != NULL) {
+		wl_seat_destroy(client->seat);
+	}
+	if (client->shm != NULL) {
+		wl_shm_destroy(client->shm);
+	}
+	if (client->compositor != NULL) {
+		wl_compositor_destroy(client->compositor);
+	}
+	wl_registry_destroy(client->registry);
+	wl_display_disconnect(client->display);
+	wl_client_destroy(client->wl_client);
+	free(client);
+}
+
+static void sync_handle_done(void *data, struct wl_callback *callback,
+		uint32_t serial) {
+	bool *done = data;
+	*done = true;
+}
+
+static const struct wl_callback_listener sync_listener = {
+	.done = sync_handle_done,
+};
+
+bool bench_client_roundtrip(struct bench_client *client) {
+	bool done = false;
+	struct wl_callback *callback = wl_display_sync(client->display);
+	wl_callback_add_listener(callback, &sync_listener, &done);
+
+	while (!done) {
+		if (wl_display_flush(client->display) < 0 && errno != EAGAIN) {
+			perror("wl_display_flush failed");
+			break;
+		}
+
+		wl_event_loop_dispatch(client->server->event_loop, 0);
+		wl_display_flush_clients(client->server->display);
+
+		while (wl_display_prepare_read(client->display) != 0) {
+			wl_display_dispatch_pending(client->display);
+		}
+		// The client socket is non-blocking, this doesn't wait
+		if (wl_display_read_events(client->display) < 0) {
+			perror("wl_display_read_events failed");
+			break;
+		}
+		if (wl_display_dispatch_pending(client->display) < 0) {
+			perror("wl_display_dispatch_pending failed");
+			break;
+		}
+	}
+
+	if (!done) {
+		wl_callback_destroy(callback);
+	}
+	return done;
+}
+
+static int create_shm_file(size_t size) {
+	char name[64];
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	snprintf(name, sizeof(name), "/wlroots-bench-%d-%ld", getpid(), ts.tv_nsec);
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		return -1;
+	}
+	shm_unlink(name);
+
+	int ret;
+	while ((ret = ftruncate(fd, size)) < 0 && errno == EINTR) {
+		// No-op
+	}
+	if (ret < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+struct wl_buffer *bench_client_create_buffer(struct bench_client *client,
+		int width, int height) {
+	int stride = width * 4;
+	size_t size = (size_t)stride * height;
+
+	int fd = create_shm_file(size);
+	if (fd < 0) {
+		perror("Failed to create shm file");
+		return NULL;
+	}
+
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		perror("mmap failed");
+		close(fd);
+		return NULL;
+	}
+	memset(data, 0xFF, size);
+	munmap(data, size);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, size);
+	close(fd);
+	struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0,
+		width, height, stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	return buffer;
+}
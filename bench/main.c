@@ -0,0 +1,206 @@
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include <wlr/version.h>
+#include "bench.h"
+
+/**
+ * Runs the benchmarks and prints the results as JSON on stdout. For each
+ * benchmark, the number of iterations is first calibrated so that a sample
+ * takes at least the requested time, then several samples are measured.
+ * Timings are reported in nanoseconds per iteration.
+ */
+
+// Upper bound on the number of iterations per sample
+#define MAX_ITERS (1 << 24)
+
+static const char usage[] =
+	"usage: wlr-bench [options]\n"
+	"  -f <filter>   only run benchmarks whose name contains <filter>\n"
+	"  -s <samples>  number of samples per benchmark (default: 10)\n"
+	"  -t <ms>       minimum duration of a sample (default: 20)\n"
+	"  -l            list benchmarks and exit\n";
+
+static int64_t get_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t time_run(const struct bench *bench, void *state, size_t iters) {
+	int64_t start = get_time_ns();
+	bench->run(state, iters);
+	return get_time_ns() - start;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static bool run_bench(const struct bench *bench, struct bench_server *server,
+		size_t samples_len, int64_t min_sample_ns, bool first) {
+	void *state = bench->setup(server);
+	if (state == NULL) {
+		fprintf(stderr, "Failed to set up benchmark %s, skipping\n",
+			bench->name);
+		return false;
+	}
+
+	// Warm up caches and lazily-allocated state, then calibrate
+	size_t iters = 1;
+	bench->run(state, iters);
+	while (iters < MAX_ITERS && time_run(bench, state, iters) < min_sample_ns) {
+		iters *= 2;
+	}
+
+	double *samples = calloc(samples_len, sizeof(samples[0]));
+	if (samples == NULL) {
+		bench->teardown(state);
+		return false;
+	}
+	double sum = 0;
+	for (size_t i = 0; i < samples_len; i++) {
+		samples[i] = (double)time_run(bench, state, iters) / iters;
+		sum += samples[i];
+	}
+
+	bench->teardown(state);
+
+	double mean = sum / samples_len;
+	double var = 0;
+	for (size_t i = 0; i < samples_len; i++) {
+		var += (samples[i] - mean) * (samples[i] - mean);
+	}
+	double stddev = samples_len > 1 ? sqrt(var / (samples_len - 1)) : 0;
+
+	qsort(samples, samples_len, sizeof(samples[0]), compare_doubles);
+	double median = samples_len % 2 == 1 ? samples[samples_len / 2] :
+		(samples[samples_len / 2 - 1] + samples[samples_len / 2]) / 2;
+
+	printf("%s\n\t\t{\n", first ? "" : ",");
+	printf("\t\t\t\"name\": \"%s\",\n", bench->name);
+	printf("\t\t\t\"iterations\": %zu,\n", iters);
+	printf("\t\t\t\"samples\": %zu,\n", samples_len);
+	printf("\t\t\t\"ns_per_iter\": {\n");
+	printf("\t\t\t\t\"min\": %.3f,\n", samples[0]);
+	printf("\t\t\t\t\"median\": %.3f,\n", median);
+	printf("\t\t\t\t\"mean\": %.3f,\n", mean);
+	printf("\t\t\t\t\"max\": %.3f,\n", samples[samples_len - 1]);
+	printf("\t\t\t\t\"stddev\": %.3f\n", stddev);
+	printf("\t\t\t}\n\t\t}");
+
+	free(samples);
+	return true;
+}
+
+static bool server_init(struct bench_server *server) {
+	// Results must not depend on the GPU
+	setenv("WLR_RENDERER", "pixman", true);
+
+	server->display = wl_display_create();
+	if (server->display == NULL) {
+		return false;
+	}
+	server->event_loop = wl_display_get_event_loop(server->display);
+
+	server->backend = wlr_headless_backend_create(server->display);
+	if (server->backend == NULL) {
+		return false;
+	}
+
+	server->renderer = wlr_backend_get_renderer(server->backend);
+	if (!wlr_renderer_init_wl_display(server->renderer, server->display)) {
+		return false;
+	}
+
+	server->compositor =
+		wlr_compositor_create(server->display, server->renderer);
+	server->seat = wlr_seat_create(server->display, "seat0");
+	if (server->compositor == NULL || server->seat == NULL) {
+		return false;
+	}
+	wlr_seat_set_capabilities(server->seat, WL_SEAT_CAPABILITY_POINTER);
+
+	return wlr_backend_start(server->backend);
+}
+
+int main(int argc, char *argv[]) {
+	const char *filter = NULL;
+	size_t samples_len = 10;
+	int64_t min_sample_ms = 20;
+
+	int c;
+	while ((c = getopt(argc, argv, "f:s:t:lh")) != -1) {
+		switch (c) {
+		case 'f':
+			filter = optarg;
+			break;
+		case 's':
+			samples_len = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			min_sample_ms = strtol(optarg, NULL, 10);
+			break;
+		case 'l':
+			for (size_t i = 0; i < benches_len; i++) {
+				printf("%s\n", benches[i].name);
+			}
+			return EXIT_SUCCESS;
+		default:
+			fprintf(stderr, "%s", usage);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind < argc || samples_len == 0 || min_sample_ms <= 0) {
+		fprintf(stderr, "%s", usage);
+		return EXIT_FAILURE;
+	}
+
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench_server server = {0};
+	if (!server_init(&server)) {
+		fprintf(stderr, "Failed to initialize the compositor\n");
+		if (server.display != NULL) {
+			wl_display_destroy(server.display);
+		}
+		return EXIT_FAILURE;
+	}
+
+	printf("{\n");
+	printf("\t\"version\": \"%s\",\n", WLR_VERSION_STR);
+	printf("\t\"benchmarks\": [");
+
+	bool first = true, ok = true;
+	for (size_t i = 0; i < benches_len; i++) {
+		const struct bench *bench = &benches[i];
+		if (filter != NULL && strstr(bench->name, filter) == NULL) {
+			continue;
+		}
+		if (run_bench(bench, &server, samples_len,
+				min_sample_ms * 1000000, first)) {
+			first = false;
+		} else {
+			ok = false;
+		}
+	}
+
+	printf("\n\t]\n}\n");
+
+	wl_display_destroy_clients(server.display);
+	wl_display_destroy(server.display);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
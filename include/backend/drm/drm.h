@@ -11,6 +11,7 @@
 #include <wlr/backend/drm.h>
 #include <wlr/backend/session.h>
 #include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_box.h>
 #include <xf86drmMode.h>
 #include "backend/drm/iface.h"
 #include "backend/drm/properties.h"
@@ -34,6 +35,11 @@ struct wlr_drm_plane {
 
 	struct wlr_drm_format_set formats;
 
+	/* Overlay planes only: destination of pending_fb on the CRTC */
+	struct wlr_box pending_dst;
+	/* Initial zpos, zero if the property doesn't exist */
+	uint64_t zpos;
+
 	union wlr_drm_plane_props props;
 };
 
@@ -50,6 +56,12 @@ struct wlr_drm_crtc {
 	struct wlr_drm_plane *primary;
 	struct wlr_drm_plane *cursor;
 
+	/* Overlay planes, sorted by increasing zpos */
+	struct wlr_drm_plane **overlays;
+	size_t overlays_len;
+	/* Whether the last page-flip updated the overlay planes */
+	bool overlays_queued;
+
 	union wlr_drm_crtc_props props;
 };
 
@@ -60,6 +72,7 @@ struct wlr_drm_backend {
 	const struct wlr_drm_interface *iface;
 	clockid_t clock;
 	bool addfb2_modifiers;
+	bool predictive_frame_scheduling;
 
 	int fd;
 	char *name;
@@ -135,6 +148,17 @@ struct wlr_drm_connector {
 	 * they're sent.
 	 */
 	uint32_t pending_page_flip_crtc;
+
+	// Predictive frame scheduling state, see drm_connector_schedule_frame().
+	// Times are in nanoseconds, on CLOCK_MONOTONIC.
+	struct {
+		struct wl_event_source *timer;
+		int64_t frame_sent; // zero if no frame event is in flight
+		int64_t deadline; // vblank targeted by the last frame event
+		int64_t target; // vblank targeted by the last committed frame
+		int64_t render_duration; // moving average
+		int64_t margin;
+	} frame_schedule;
 };
 
 struct wlr_drm_backend *get_drm_backend_from_backend(
@@ -37,8 +37,9 @@ union wlr_drm_crtc_props {
 
 		uint32_t active;
 		uint32_t mode_id;
+		uint32_t out_fence_ptr;
 	};
-	uint32_t props[6];
+	uint32_t props[7];
 };
 
 union wlr_drm_plane_props {
@@ -59,8 +60,10 @@ union wlr_drm_plane_props {
 		uint32_t crtc_h;
 		uint32_t fb_id;
 		uint32_t crtc_id;
+		uint32_t zpos; // Not guaranteed to exist
+		uint32_t in_fence_fd;
 	};
-	uint32_t props[13];
+	uint32_t props[15];
 };
 
 bool get_drm_connector_props(int fd, uint32_t id,
@@ -14,6 +14,19 @@
 #include <wlr/render/wlr_texture.h>
 #include <wlr/util/log.h>
 
+// Number of render passes for which GPU timestamps are kept around
+#define GLES2_TIMER_QUERIES_LEN 8
+// Number of pixel buffer objects used to stage texture uploads
+#define GLES2_UPLOAD_PBOS_LEN 3
+
+// GLES3 enums, the NV_pixel_buffer_object and EXT_map_buffer_range ones have
+// the same values
+#define PIXEL_PACK_BUFFER GL_PIXEL_PACK_BUFFER_NV
+#define PIXEL_UNPACK_BUFFER GL_PIXEL_UNPACK_BUFFER_NV
+#define MAP_READ_BIT GL_MAP_READ_BIT_EXT
+#define MAP_WRITE_BIT GL_MAP_WRITE_BIT_EXT
+#define MAP_INVALIDATE_BUFFER_BIT GL_MAP_INVALIDATE_BUFFER_BIT_EXT
+
 struct wlr_gles2_pixel_format {
 	uint32_t drm_format;
 	GLint gl_format, gl_type;
@@ -43,6 +56,10 @@ struct wlr_gles2_renderer {
 		bool debug_khr;
 		bool egl_image_external_oes;
 		bool egl_image_oes;
+		// GLES3 or NV_pixel_buffer_object + EXT_map_buffer_range +
+		// OES_mapbuffer, used for asynchronous read-back
+		bool pixel_buffer_object;
+		bool disjoint_timer_query_ext;
 	} exts;
 
 	struct {
@@ -52,6 +69,13 @@ struct wlr_gles2_renderer {
 		PFNGLPOPDEBUGGROUPKHRPROC glPopDebugGroupKHR;
 		PFNGLPUSHDEBUGGROUPKHRPROC glPushDebugGroupKHR;
 		PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC glEGLImageTargetRenderbufferStorageOES;
+		PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRange;
+		PFNGLUNMAPBUFFEROESPROC glUnmapBuffer;
+		PFNGLGENQUERIESEXTPROC glGenQueriesEXT;
+		PFNGLDELETEQUERIESEXTPROC glDeleteQueriesEXT;
+		PFNGLQUERYCOUNTEREXTPROC glQueryCounterEXT;
+		PFNGLGETQUERYOBJECTUIVEXTPROC glGetQueryObjectuivEXT;
+		PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
 	} procs;
 
 	struct {
@@ -71,6 +95,32 @@ struct wlr_gles2_renderer {
 
 	struct wlr_gles2_buffer *current_buffer;
 	uint32_t viewport_width, viewport_height;
+
+	// Vertex data for render_texture_batch, streamed to the VBO on flush
+	struct {
+		GLuint vbo;
+		GLfloat *verts;
+		size_t len, cap; // in vertices
+	} batch;
+
+	// Usage hint for read-back pixel buffer objects
+	GLenum pbo_usage;
+
+	// GPU timestamps taken at the beginning and end of the last render
+	// passes, indexed by wlr_renderer.render_seq modulo the array length
+	struct {
+		GLuint begin, end;
+		uint64_t render_seq; // zero if unused
+		bool ended;
+	} timer_queries[GLES2_TIMER_QUERIES_LEN];
+
+	// Staging buffers for texture uploads, used in a round-robin fashion so
+	// that an upload doesn't wait for the previous one to complete
+	struct {
+		GLuint pbo; // zero if not created yet
+		size_t size;
+	} upload_pbos[GLES2_UPLOAD_PBOS_LEN];
+	size_t upload_pbo_next;
 };
 
 struct wlr_gles2_buffer {
@@ -105,10 +155,23 @@ struct wlr_gles2_texture {
 	uint32_t drm_format; // used to interpret upload data
 	// If imported from a wlr_buffer
 	struct wlr_buffer *buffer;
+	// Last acquire fence of the buffer waited on, see
+	// wlr_buffer.acquire_fence_seq
+	uint64_t acquire_fence_seq;
 
 	struct wl_listener buffer_destroy;
 };
 
+struct wlr_gles2_readback {
+	struct wlr_readback wlr_readback;
+	struct wlr_gles2_renderer *renderer;
+
+	GLuint pbo;
+	uint32_t pbo_stride;
+	EGLSyncKHR sync; // EGL_NO_SYNC_KHR if fences aren't supported
+	int fence_fd; // exported native fence, -1 if unsupported
+};
+
 const struct wlr_gles2_pixel_format *get_gles2_format_from_drm(uint32_t fmt);
 const struct wlr_gles2_pixel_format *get_gles2_format_from_gl(
 	GLint gl_format, GLint gl_type, bool alpha);
@@ -129,6 +192,23 @@ struct wlr_texture *gles2_texture_from_dmabuf(struct wlr_renderer *wlr_renderer,
 struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
 	struct wlr_buffer *buffer);
 void gles2_texture_destroy(struct wlr_gles2_texture *texture);
+/**
+ * Make the GPU wait for the acquire fence of the texture's buffer, if any,
+ * before sampling from it.
+ */
+void gles2_texture_wait_acquire_fence(struct wlr_gles2_texture *texture);
+
+/**
+ * Make the GPU wait for a sync_file before executing further commands. Takes
+ * ownership of the file descriptor. Returns false if the renderer doesn't
+ * support explicit synchronization, in which case implicit synchronization
+ * is relied upon.
+ */
+bool gles2_wait_fence(struct wlr_gles2_renderer *renderer, int fence_fd);
+
+struct wlr_readback *gles2_read_pixels_async(struct wlr_renderer *wlr_renderer,
+	uint32_t drm_format, uint32_t width, uint32_t height,
+	uint32_t src_x, uint32_t src_y);
 
 void push_gles2_debug_(struct wlr_gles2_renderer *renderer,
 	const char *file, const char *func);
@@ -1,9 +1,12 @@
 #ifndef RENDER_PIXMAN_H
 #define RENDER_PIXMAN_H
 
+#include <pthread.h>
+#include <wayland-server-core.h>
 #include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_box.h>
 #include "render/pixel_format.h"
 
 struct wlr_pixman_pixel_format {
@@ -13,6 +16,62 @@ struct wlr_pixman_pixel_format {
 
 struct wlr_pixman_buffer;
 
+/**
+ * A pool of threads executing tasks in parallel.
+ */
+struct wlr_pixman_worker_pool {
+	pthread_t *threads;
+	size_t threads_len;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond, done_cond;
+	bool stop;
+
+	// Current job, protected by the mutex
+	void (*func)(void *data, size_t index);
+	void *data;
+	size_t next, done, count;
+};
+
+enum wlr_pixman_draw_type {
+	WLR_PIXMAN_DRAW_FILL,
+	WLR_PIXMAN_DRAW_IMAGE,
+	WLR_PIXMAN_DRAW_QUAD,
+};
+
+/**
+ * A draw operation, clipped to the render target and scissor box.
+ *
+ * The result of a draw operation on a pixel row only depends on the previous
+ * contents of that row, so horizontal bands of the render target can be
+ * rendered independently.
+ */
+struct wlr_pixman_draw {
+	enum wlr_pixman_draw_type type;
+	pixman_op_t op;
+	struct wlr_box box; // render target coordinates
+
+	// FILL and QUAD
+	struct pixman_color color;
+
+	// IMAGE: source pixels
+	pixman_format_code_t format;
+	void *data;
+	int stride;
+	int src_x, src_y; // source coordinates of the box origin
+	uint16_t mask_alpha; // no mask is used if 0xFFFF
+	struct wlr_buffer *buffer; // locked until the draw is executed, or NULL
+	// Whether the data pointer access to the buffer began for this draw, and
+	// needs to be ended once it's executed
+	bool end_access;
+	struct wl_shm_buffer *shm_buffer; // NULL if not a client shm buffer
+
+	// IMAGE and QUAD: image size and transform
+	int width, height;
+	bool has_transform;
+	struct pixman_transform transform;
+};
+
 struct wlr_pixman_renderer {
 	struct wlr_renderer wlr_renderer;
 
@@ -22,6 +81,16 @@ struct wlr_pixman_renderer {
 	struct wlr_pixman_buffer *current_buffer;
 	int32_t width, height;
 
+	bool has_scissor;
+	struct wlr_box scissor;
+
+	// Worker threads, NULL if rendering on the compositor thread only
+	struct wlr_pixman_worker_pool *workers;
+	// Draws deferred until the end of the render pass, if using workers
+	struct wlr_pixman_draw *draws;
+	size_t draws_len, draws_cap;
+	int tile_height;
+
 	struct wlr_drm_format_set drm_formats;
 };
 
@@ -52,4 +121,13 @@ pixman_format_code_t get_pixman_format_from_drm(uint32_t fmt);
 uint32_t get_drm_format_from_pixman(pixman_format_code_t fmt);
 const uint32_t *get_pixman_drm_formats(size_t *len);
 
+struct wlr_pixman_worker_pool *pixman_worker_pool_create(size_t threads_len);
+void pixman_worker_pool_destroy(struct wlr_pixman_worker_pool *pool);
+/**
+ * Call `func` for each index in [0, count), in parallel, and wait for all
+ * calls to return. The calling thread runs some of the calls too.
+ */
+void pixman_worker_pool_run(struct wlr_pixman_worker_pool *pool,
+	void (*func)(void *data, size_t index), void *data, size_t count);
+
 #endif
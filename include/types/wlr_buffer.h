@@ -24,6 +24,14 @@ struct wlr_shm_client_buffer {
 
 struct wlr_shm_client_buffer *shm_client_buffer_create(
 	struct wl_resource *resource);
+/**
+ * Get the wl_shm_buffer of a shm client buffer, or NULL if the buffer isn't
+ * one or if the client has destroyed the wl_buffer.
+ *
+ * Threads other than the compositor one need to protect their accesses to the
+ * buffer data with wl_shm_buffer_begin_access and wl_shm_buffer_end_access.
+ */
+struct wl_shm_buffer *buffer_get_wl_shm_buffer(struct wlr_buffer *buffer);
 
 /**
  * Buffer capabilities.
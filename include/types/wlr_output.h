@@ -0,0 +1,12 @@
+#ifndef TYPES_WLR_OUTPUT_H
+#define TYPES_WLR_OUTPUT_H
+
+#include <time.h>
+#include <wlr/types/wlr_output_timing.h>
+
+void output_timing_handle_frame(struct wlr_output_timing *timing);
+void output_timing_handle_attach_render(struct wlr_output_timing *timing);
+void output_timing_record_commit(struct wlr_output_timing *timing,
+	const struct timespec *start, const struct timespec *end);
+
+#endif
@@ -13,6 +13,13 @@ void seat_client_create_pointer(struct wlr_seat_client *seat_client,
 void seat_client_destroy_pointer(struct wl_resource *resource);
 void seat_client_send_pointer_leave_raw(struct wlr_seat_client *seat_client,
 	struct wlr_surface *surface);
+/**
+ * Mark motion events as deferred until the next output frame, when motion
+ * coalescing is enabled. The motion_flush event is emitted when they need to
+ * be sent.
+ */
+void seat_pointer_defer_motion(struct wlr_seat *wlr_seat);
+void seat_pointer_flush_motion(struct wlr_seat *wlr_seat);
 
 void seat_client_create_keyboard(struct wlr_seat_client *seat_client,
 	uint32_t version, uint32_t id);
@@ -1,7 +1,14 @@
 #ifndef UTIL_SHM_H
 #define UTIL_SHM_H
 
+#include <stddef.h>
+
 int create_shm_file(void);
 int allocate_shm_file(size_t size);
+/**
+ * Create a file filled with the provided data, which can be shared with
+ * untrusted processes: they can't write to nor resize it. Returns -1 on error.
+ */
+int allocate_ro_shm_file(const void *data, size_t size);
 
 #endif
@@ -22,7 +22,8 @@
 	(WLR_OUTPUT_STATE_DAMAGE | \
 	WLR_OUTPUT_STATE_SCALE | \
 	WLR_OUTPUT_STATE_TRANSFORM | \
-	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED)
+	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED | \
+	WLR_OUTPUT_STATE_LAYERS)
 
 /**
  * A backend implementation of wlr_output.
@@ -84,6 +85,11 @@ struct wlr_output_impl {
 	 * Zero can be returned if the output doesn't support gamma LUTs.
 	 */
 	size_t (*get_gamma_size)(struct wlr_output *output);
+	/**
+	 * Get the buffer rendered via attach_render and submitted by the last
+	 * commit, if any. The returned buffer isn't locked.
+	 */
+	struct wlr_buffer *(*get_render_buffer)(struct wlr_output *output);
 	/**
 	 * Export the output's current back-buffer as a DMA-BUF.
 	 */
@@ -164,5 +170,13 @@ void wlr_output_send_frame(struct wlr_output *output);
  */
 void wlr_output_send_present(struct wlr_output *output,
 	struct wlr_output_event_present *event);
+/**
+ * Record the time spent submitting a frame to the display, for instance in the
+ * KMS commit ioctl. This is a no-op unless frame timing is enabled.
+ *
+ * See wlr_output_timing.
+ */
+void wlr_output_record_commit_time(struct wlr_output *output,
+	const struct timespec *start, const struct timespec *end);
 
 #endif
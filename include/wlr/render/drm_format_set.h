@@ -5,12 +5,20 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * A DRM format and its supported modifiers, sorted in ascending order.
+ */
 struct wlr_drm_format {
 	uint32_t format;
 	size_t len, cap;
 	uint64_t modifiers[];
 };
 
+/**
+ * A set of DRM formats, sorted by format code. The set must be built with
+ * wlr_drm_format_set_add() to keep it sorted, lookups use binary search and
+ * don't allocate.
+ */
 struct wlr_drm_format_set {
 	size_t len, cap;
 	struct wlr_drm_format **formats;
@@ -27,4 +35,14 @@ bool wlr_drm_format_set_has(const struct wlr_drm_format_set *set,
 bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 	uint64_t modifier);
 
+/**
+ * Intersect two DRM format sets `a` and `b`, storing in `dst` the formats and
+ * modifiers supported by both sets. `dst` may alias `a` or `b`, its previous
+ * contents are released.
+ *
+ * Returns false on failure or if the intersection is empty.
+ */
+bool wlr_drm_format_set_intersect(struct wlr_drm_format_set *dst,
+	const struct wlr_drm_format_set *a, const struct wlr_drm_format_set *b);
+
 #endif
@@ -48,6 +48,9 @@ struct wlr_egl {
 		bool image_base_khr;
 		bool image_dmabuf_import_ext;
 		bool image_dmabuf_import_modifiers_ext;
+		bool fence_sync_khr;
+		bool wait_sync_khr;
+		bool native_fence_sync_android;
 
 		// Device extensions
 		bool device_drm_ext;
@@ -65,6 +68,11 @@ struct wlr_egl {
 		PFNEGLDEBUGMESSAGECONTROLKHRPROC eglDebugMessageControlKHR;
 		PFNEGLQUERYDISPLAYATTRIBEXTPROC eglQueryDisplayAttribEXT;
 		PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT;
+		PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+		PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+		PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+		PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
+		PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
 	} procs;
 
 	struct wl_display *wl_display;
@@ -152,4 +160,30 @@ bool wlr_egl_restore_context(struct wlr_egl_context *context);
 
 int wlr_egl_dup_drm_fd(struct wlr_egl *egl);
 
+/**
+ * Create an EGL native fence sync. If fence_fd is -1, the sync is signalled
+ * once the commands submitted so far by the current context are done, and
+ * can be exported with wlr_egl_dup_fence_fd once the commands are flushed.
+ * Otherwise, the sync imports the sync_file and takes ownership of fence_fd
+ * on success.
+ *
+ * Requires EGL_ANDROID_native_fence_sync. Returns EGL_NO_SYNC_KHR on error.
+ */
+EGLSyncKHR wlr_egl_create_sync(struct wlr_egl *egl, int fence_fd);
+
+void wlr_egl_destroy_sync(struct wlr_egl *egl, EGLSyncKHR sync);
+
+/**
+ * Export an EGL native fence sync as a sync_file. Returns -1 on error.
+ */
+int wlr_egl_dup_fence_fd(struct wlr_egl *egl, EGLSyncKHR sync);
+
+/**
+ * Make the GPU wait for the sync to be signalled before executing further
+ * commands submitted by the current context. This doesn't block the CPU.
+ *
+ * Requires EGL_KHR_wait_sync.
+ */
+bool wlr_egl_wait_sync(struct wlr_egl *egl, EGLSyncKHR sync);
+
 #endif
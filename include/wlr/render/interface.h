@@ -28,6 +28,8 @@ struct wlr_renderer_impl {
 	bool (*render_subtexture_with_matrix)(struct wlr_renderer *renderer,
 		struct wlr_texture *texture, const struct wlr_fbox *box,
 		const float matrix[static 9], float alpha);
+	bool (*render_texture_batch)(struct wlr_renderer *renderer,
+		const struct wlr_render_texture_item *items, size_t items_len);
 	void (*render_quad_with_matrix)(struct wlr_renderer *renderer,
 		const float color[static 4], const float matrix[static 9]);
 	const uint32_t *(*get_shm_texture_formats)(struct wlr_renderer *renderer,
@@ -45,6 +47,11 @@ struct wlr_renderer_impl {
 		uint32_t *flags, uint32_t stride, uint32_t width, uint32_t height,
 		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
 		void *data);
+	struct wlr_readback *(*read_pixels_async)(struct wlr_renderer *renderer,
+		uint32_t fmt, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y);
+	bool (*get_render_time)(struct wlr_renderer *renderer,
+		uint64_t render_seq, uint64_t *ns);
 	struct wlr_texture *(*texture_from_pixels)(struct wlr_renderer *renderer,
 		uint32_t fmt, uint32_t stride, uint32_t width, uint32_t height,
 		const void *data);
@@ -70,10 +77,25 @@ struct wlr_texture_impl {
 		uint32_t stride, uint32_t width, uint32_t height,
 		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
 		const void *data);
+	// Optional, falls back to write_pixels for each rectangle
+	bool (*write_pixels_region)(struct wlr_texture *texture, uint32_t stride,
+		int rects_len, const pixman_box32_t *rects, const void *data);
 	void (*destroy)(struct wlr_texture *texture);
 };
 
 void wlr_texture_init(struct wlr_texture *texture,
 	const struct wlr_texture_impl *impl, uint32_t width, uint32_t height);
 
+struct wlr_readback_impl {
+	bool (*is_ready)(struct wlr_readback *readback);
+	int (*get_fence_fd)(struct wlr_readback *readback);
+	bool (*finish)(struct wlr_readback *readback, uint32_t *flags,
+		uint32_t stride, uint32_t dst_x, uint32_t dst_y, void *data);
+	void (*destroy)(struct wlr_readback *readback);
+};
+
+void wlr_readback_init(struct wlr_readback *readback,
+	const struct wlr_readback_impl *impl, uint32_t format,
+	uint32_t width, uint32_t height);
+
 #endif
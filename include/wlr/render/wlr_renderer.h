@@ -20,6 +20,7 @@ enum wlr_renderer_read_pixels_flags {
 };
 
 struct wlr_renderer_impl;
+struct wlr_readback_impl;
 struct wlr_drm_format_set;
 struct wlr_buffer;
 
@@ -29,11 +30,31 @@ struct wlr_renderer {
 	bool rendering;
 	bool rendering_with_buffer;
 
+	// Render pass sequence number. Incremented by wlr_renderer_begin(), may
+	// overflow.
+	uint64_t render_seq;
+
+	// Buffer import cache statistics: number of wlr_texture_from_buffer()
+	// calls which re-used a previously imported texture, and number of calls
+	// which had to import the buffer
+	struct {
+		uint64_t hits, misses;
+	} texture_cache;
+
 	struct {
 		struct wl_signal destroy;
 	} events;
 };
 
+/**
+ * An asynchronous pixel read-back, see wlr_renderer_read_pixels_async().
+ */
+struct wlr_readback {
+	const struct wlr_readback_impl *impl;
+	uint32_t format;
+	uint32_t width, height;
+};
+
 struct wlr_renderer *wlr_renderer_autocreate(struct wlr_backend *backend);
 
 void wlr_renderer_begin(struct wlr_renderer *r, uint32_t width, uint32_t height);
@@ -64,6 +85,30 @@ bool wlr_render_texture_with_matrix(struct wlr_renderer *r,
 bool wlr_render_subtexture_with_matrix(struct wlr_renderer *r,
 	struct wlr_texture *texture, const struct wlr_fbox *box,
 	const float matrix[static 9], float alpha);
+/**
+ * A textured quad queued for rendering with wlr_render_texture_batch().
+ */
+struct wlr_render_texture_item {
+	struct wlr_texture *texture;
+	struct wlr_fbox src_box;
+	float matrix[9];
+	float alpha;
+	// Rectangles the quad is clipped to, in the same coordinate space as the
+	// scissor box. If empty, the quad isn't clipped.
+	const struct wlr_box *clip_rects;
+	size_t clip_rects_len;
+};
+/**
+ * Renders a list of textured quads, in order. This is equivalent to calling
+ * wlr_renderer_scissor() and wlr_render_subtexture_with_matrix() for each
+ * clip rectangle of each item, but lets the renderer merge consecutive items
+ * into fewer draw calls.
+ *
+ * The current scissor box is ignored, and is reset once the batch has been
+ * rendered.
+ */
+bool wlr_render_texture_batch(struct wlr_renderer *r,
+	const struct wlr_render_texture_item *items, size_t items_len);
 /**
  * Renders a solid rectangle in the specified color.
  */
@@ -106,6 +151,51 @@ const struct wlr_drm_format_set *wlr_renderer_get_dmabuf_texture_formats(
 bool wlr_renderer_read_pixels(struct wlr_renderer *r, uint32_t fmt,
 	uint32_t *flags, uint32_t stride, uint32_t width, uint32_t height,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data);
+/**
+ * Starts reading pixels out of the currently bound surface without waiting for
+ * the GPU to finish rendering. The pixels are copied into renderer-owned
+ * memory in the background.
+ *
+ * Once wlr_readback_is_ready() returns true, wlr_readback_finish() can copy
+ * the pixels out without stalling. The read-back must be destroyed with
+ * wlr_readback_destroy() before the renderer.
+ *
+ * Returns NULL if the renderer doesn't support asynchronous read-back, in which
+ * case wlr_renderer_read_pixels() can be used instead.
+ */
+struct wlr_readback *wlr_renderer_read_pixels_async(struct wlr_renderer *r,
+	uint32_t fmt, uint32_t width, uint32_t height,
+	uint32_t src_x, uint32_t src_y);
+/**
+ * Checks whether the GPU has finished copying the pixels. This doesn't block.
+ */
+bool wlr_readback_is_ready(struct wlr_readback *readback);
+/**
+ * Get a sync_file which becomes readable once the read-back is ready, so that
+ * it can be waited for in an event loop. The file descriptor is owned by the
+ * read-back. Returns -1 if the renderer can't export one.
+ */
+int wlr_readback_get_fence_fd(struct wlr_readback *readback);
+/**
+ * Copies the pixels read back into data. `stride` is in bytes. This blocks if
+ * the read-back isn't ready yet.
+ *
+ * `flags` has the same meaning as in wlr_renderer_read_pixels().
+ */
+bool wlr_readback_finish(struct wlr_readback *readback, uint32_t *flags,
+	uint32_t stride, uint32_t dst_x, uint32_t dst_y, void *data);
+void wlr_readback_destroy(struct wlr_readback *readback);
+/**
+ * Get the time spent by the GPU executing a render pass, in nanoseconds. The
+ * render pass is identified by the value of `render_seq` after
+ * wlr_renderer_begin() was called.
+ *
+ * This doesn't block. Returns false if the renderer doesn't support GPU timer
+ * queries, if the GPU hasn't finished the render pass yet, or if the render
+ * pass is too old.
+ */
+bool wlr_renderer_get_render_time(struct wlr_renderer *r, uint64_t render_seq,
+	uint64_t *ns);
 
 /**
  * Creates necessary shm and invokes the initialization of the implementation.
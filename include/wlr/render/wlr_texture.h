@@ -9,6 +9,7 @@
 #ifndef WLR_RENDER_WLR_TEXTURE_H
 #define WLR_RENDER_WLR_TEXTURE_H
 
+#include <pixman.h>
 #include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/render/dmabuf.h>
@@ -68,6 +69,17 @@ bool wlr_texture_write_pixels(struct wlr_texture *texture,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
 	const void *data);
 
+/**
+ * Update the region of a texture with raw pixels. `data` contains the whole
+ * texture contents, only the pixels inside the region are uploaded. The same
+ * constraints as wlr_texture_write_pixels() apply.
+ *
+ * Fragmented regions may be simplified, in which case pixels outside of the
+ * region are uploaded too.
+ */
+bool wlr_texture_write_pixels_region(struct wlr_texture *texture,
+	uint32_t stride, const pixman_region32_t *region, const void *data);
+
 /**
  * Destroys this wlr_texture.
  */
@@ -54,6 +54,13 @@ struct wlr_buffer {
 		struct wl_signal destroy;
 		struct wl_signal release;
 	} events;
+
+	// private state
+
+	int acquire_fence_fd; // -1 if none
+	int release_fence_fd; // -1 if none
+	// Incremented each time the acquire fence is replaced
+	uint64_t acquire_fence_seq;
 };
 
 /**
@@ -99,6 +106,36 @@ bool wlr_buffer_get_dmabuf(struct wlr_buffer *buffer,
  */
 bool wlr_buffer_get_shm(struct wlr_buffer *buffer,
 	struct wlr_shm_attributes *attribs);
+/**
+ * Set the acquire fence of the buffer. This is a sync_file which is signalled
+ * once the producer is done writing to the buffer, consumers must wait for it
+ * before reading the buffer contents. This replaces the previous acquire
+ * fence, if any.
+ *
+ * Takes ownership of the file descriptor. -1 clears the fence.
+ */
+void wlr_buffer_set_acquire_fence(struct wlr_buffer *buffer, int fence_fd);
+/**
+ * Get a new file descriptor referring to the acquire fence of the buffer.
+ * Returns -1 if the buffer has no acquire fence. The caller is responsible
+ * for closing the returned file descriptor.
+ */
+int wlr_buffer_dup_acquire_fence(struct wlr_buffer *buffer);
+/**
+ * Add a release fence to the buffer. This is a sync_file which is signalled
+ * once a consumer is done reading from the buffer. Release fences from
+ * multiple consumers are merged. If merging fails, this blocks until the
+ * previous release fence is signalled.
+ *
+ * Takes ownership of the file descriptor.
+ */
+bool wlr_buffer_add_release_fence(struct wlr_buffer *buffer, int fence_fd);
+/**
+ * Remove the release fence from the buffer and return it, or -1 if there is
+ * none. Producers must wait for it before writing to the buffer again. The
+ * caller is responsible for closing the returned file descriptor.
+ */
+int wlr_buffer_take_release_fence(struct wlr_buffer *buffer);
 
 /**
  * A client buffer.
@@ -27,6 +27,17 @@ struct wlr_idle {
 	struct wl_event_loop *event_loop;
 	bool enabled;
 
+	// private state
+
+	// Single timer shared by all idle timeouts, armed for the earliest
+	// deadline of the heap
+	struct wl_event_source *timer_source;
+	int64_t timer_deadline; // milliseconds, 0 if disarmed
+	// Binary min-heap of enabled, non-idle timeouts ordered by deadline
+	struct wlr_idle_timeout **heap;
+	size_t heap_len, heap_cap;
+	int64_t activity_time; // milliseconds, last wlr_idle_notify_activity()
+
 	struct wl_listener display_destroy;
 	struct {
 		struct wl_signal activity_notify;
@@ -37,15 +48,25 @@ struct wlr_idle {
 };
 
 struct wlr_idle_timeout {
+	struct wlr_idle *idle;
 	struct wl_resource *resource;
 	struct wl_list link;
 	struct wlr_seat *seat;
 
-	struct wl_event_source *idle_source;
 	bool idle_state;
 	bool enabled;
 	uint32_t timeout; // milliseconds
 
+	// private state
+
+	// Activity only updates last_activity. The deadline stored in the heap
+	// may be earlier than last_activity + timeout, it's updated lazily when
+	// the shared timer fires.
+	int64_t last_activity; // milliseconds
+	int64_t deadline; // milliseconds
+	size_t heap_index;
+	bool in_heap;
+
 	struct {
 		struct wl_signal idle;
 		struct wl_signal resume;
@@ -53,6 +53,8 @@ struct wlr_keyboard {
 
 	char *keymap_string;
 	size_t keymap_size;
+	// Read-only file containing keymap_string, shared by all clients
+	int keymap_fd; // -1 if unset
 	struct xkb_keymap *keymap;
 	struct xkb_state *xkb_state;
 	xkb_led_index_t led_indexes[WLR_LED_COUNT];
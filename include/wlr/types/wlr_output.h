@@ -33,7 +33,7 @@ struct wlr_output_cursor {
 	int32_t hotspot_x, hotspot_y;
 	struct wl_list link;
 
-	// only when using a software cursor without a surface
+	// only when using a software cursor without a surface, created lazily
 	struct wlr_texture *texture;
 
 	// only when using a cursor surface
@@ -44,6 +44,12 @@ struct wlr_output_cursor {
 	struct {
 		struct wl_signal destroy;
 	} events;
+
+	// private state
+
+	// Packed ARGB8888 copy of the image set with wlr_output_cursor_set_image
+	uint8_t *image_pixels;
+	uint32_t image_width, image_height;
 };
 
 enum wlr_output_adaptive_sync_status {
@@ -61,6 +67,7 @@ enum wlr_output_state_field {
 	WLR_OUTPUT_STATE_TRANSFORM = 1 << 5,
 	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED = 1 << 6,
 	WLR_OUTPUT_STATE_GAMMA_LUT = 1 << 7,
+	WLR_OUTPUT_STATE_LAYERS = 1 << 8,
 };
 
 enum wlr_output_state_buffer_type {
@@ -73,6 +80,8 @@ enum wlr_output_state_mode_type {
 	WLR_OUTPUT_STATE_MODE_CUSTOM,
 };
 
+struct wlr_output_layer_state;
+
 /**
  * Holds the double-buffered output state.
  */
@@ -99,9 +108,27 @@ struct wlr_output_state {
 	// only valid if WLR_OUTPUT_STATE_GAMMA_LUT
 	uint16_t *gamma_lut;
 	size_t gamma_lut_size;
+
+	// only valid if WLR_OUTPUT_STATE_LAYERS
+	struct wlr_output_layer_state *layers;
+	size_t layers_len;
 };
 
 struct wlr_output_impl;
+struct wlr_output_timing;
+
+/**
+ * Direct scan-out statistics, see wlr_output_try_scanout_surface().
+ */
+struct wlr_output_scanout_stats {
+	uint64_t attempts;
+	uint64_t successes;
+	// Reasons for falling back to rendering
+	uint64_t no_dmabuf; // no buffer, or not a DMA-BUF
+	uint64_t geometry_mismatch; // size, transform or scale doesn't match
+	uint64_t unsupported_format; // format or modifier not supported
+	uint64_t test_failed; // rejected by the backend
+};
 
 /**
  * A compositor output region. This typically corresponds to a monitor that
@@ -183,11 +210,19 @@ struct wlr_output {
 	struct wlr_output_cursor *hardware_cursor;
 	struct wlr_swapchain *cursor_swapchain;
 	struct wlr_buffer *cursor_front_buffer;
+	// Rendered buffers for recent cursor images, most recently used first
+	struct wl_list cursor_buffer_cache; // output_cursor_cache_entry::link
 	int software_cursor_locks; // number of locks forcing software cursors
 
 	struct wlr_swapchain *swapchain;
 	struct wlr_buffer *back_buffer;
 
+	struct wl_list layers; // wlr_output_layer.link
+
+	struct wlr_output_scanout_stats scanout_stats;
+
+	struct wlr_output_timing *timing; // may be NULL, see wlr_output_timing
+
 	struct wl_listener display_destroy;
 
 	void *data;
@@ -207,6 +242,9 @@ struct wlr_output_event_commit {
 	struct wlr_output *output;
 	uint32_t committed; // bitmask of enum wlr_output_state_field
 	struct timespec *when;
+	// The committed buffer, if WLR_OUTPUT_STATE_BUFFER is set and the backend
+	// exposes it, NULL otherwise
+	struct wlr_buffer *buffer;
 };
 
 enum wlr_output_present_flag {
@@ -341,6 +379,29 @@ bool wlr_output_attach_render(struct wlr_output *output, int *buffer_age);
  */
 void wlr_output_attach_buffer(struct wlr_output *output,
 	struct wlr_buffer *buffer);
+/**
+ * Try to display a surface's buffer directly on the output, without
+ * compositing it (direct scan-out). This is useful for fullscreen surfaces.
+ *
+ * The surface's buffer must be a DMA-BUF covering the whole output: its size
+ * must match the output's, its transform must match the output's and its
+ * surface-local size multiplied by the output scale must match the output's
+ * transformed resolution. Its format and modifier must be supported by the
+ * output's primary plane. Then the buffer is attached and the pending state
+ * is tested. This function must be called before attaching any other buffer.
+ *
+ * Returns true if the buffer has been attached, in which case the compositor
+ * should call `wlr_output_commit` without rendering. Otherwise, the pending
+ * state is left untouched and the compositor should fall back to
+ * `wlr_output_attach_render` for this frame. In both cases the output's
+ * `scanout_stats` are updated.
+ *
+ * Sub-surfaces and other content displayed on top of the surface aren't taken
+ * into account: the compositor must make sure the surface is the only visible
+ * content on the output.
+ */
+bool wlr_output_try_scanout_surface(struct wlr_output *output,
+	struct wlr_surface *surface);
 /**
  * Get the preferred format for reading pixels.
  * This function might change the current rendering context.
@@ -0,0 +1,80 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_LAYER_H
+#define WLR_TYPES_WLR_OUTPUT_LAYER_H
+
+#include <stdbool.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_output.h>
+
+/**
+ * An output layer.
+ *
+ * Output layers are displayed above the output's primary buffer. They allow
+ * compositors to offload the composition of some buffers (e.g. fullscreen
+ * video or game surfaces) to the display engine, for instance via KMS overlay
+ * planes.
+ *
+ * Compositors set the layers with wlr_output_set_layers(), then call
+ * wlr_output_test(). The backend marks the layers it can display as accepted.
+ * Layers which haven't been accepted need to be composited into the primary
+ * buffer by the compositor.
+ */
+struct wlr_output_layer {
+	struct wlr_output *output;
+	struct wl_list link; // wlr_output.layers
+
+	void *data;
+};
+
+/**
+ * The state of an output layer for a single commit.
+ */
+struct wlr_output_layer_state {
+	struct wlr_output_layer *layer;
+
+	// Buffer to display, or NULL to disable the layer
+	struct wlr_buffer *buffer;
+	// Destination of the buffer, in output-buffer-local coordinates. The
+	// buffer is scaled to fit.
+	struct wlr_box dst_box;
+
+	// Populated by the backend after wlr_output_test() and
+	// wlr_output_commit(), indicates whether the backend displays the layer
+	bool accepted;
+};
+
+/**
+ * Create a new output layer.
+ */
+struct wlr_output_layer *wlr_output_layer_create(struct wlr_output *output);
+
+/**
+ * Destroy an output layer.
+ *
+ * The layer's last buffer stays on screen until the output's layers are next
+ * committed.
+ */
+void wlr_output_layer_destroy(struct wlr_output_layer *layer);
+
+/**
+ * Set the output's layers, ordered from bottom to top. Layers absent from the
+ * list are disabled.
+ *
+ * The array isn't copied: it must remain valid until wlr_output_test() or
+ * wlr_output_commit() returns, so that the backend can populate the
+ * `accepted` fields. Layers must be committed along with a buffer.
+ *
+ * Layers are double-buffered state, see `wlr_output_commit`.
+ */
+void wlr_output_set_layers(struct wlr_output *output,
+	struct wlr_output_layer_state *layers, size_t layers_len);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_TIMING_H
+#define WLR_TYPES_WLR_OUTPUT_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+
+/**
+ * Number of frames kept in the timing history of an output.
+ */
+#define WLR_OUTPUT_TIMING_HISTORY_LEN 128
+
+/**
+ * Timing information for a frame committed to an output.
+ *
+ * Timestamps use CLOCK_MONOTONIC, except `present` which uses the backend's
+ * presentation clock. They are zero if the corresponding step hasn't been
+ * observed: for instance the frame wasn't started by a frame event, the
+ * backend doesn't report commit times or the frame hasn't been presented
+ * (yet).
+ */
+struct wlr_output_frame_timing {
+	// See wlr_output.commit_seq
+	uint32_t commit_seq;
+
+	// The frame event was sent
+	struct timespec frame;
+	// The compositor started rendering, with wlr_output_attach_render()
+	struct timespec render_begin;
+	// The compositor called wlr_output_commit()
+	struct timespec render_end;
+	// The backend submitted the frame to the display, e.g. the KMS atomic
+	// commit or page-flip ioctl
+	struct timespec commit_begin, commit_end;
+	// The frame turned into light
+	struct timespec present;
+
+	// Render pass used to draw the frame, see wlr_renderer.render_seq. Zero
+	// if the frame wasn't rendered with the output's renderer.
+	uint64_t render_seq;
+	// Time spent by the GPU rendering the frame, valid if has_gpu_render_time
+	// is set. Filled in asynchronously once the GPU is done.
+	uint64_t gpu_render_ns;
+	bool has_gpu_render_time;
+};
+
+/**
+ * Records where the time goes for each frame committed to an output: frame
+ * event, rendering, backend commit and presentation.
+ *
+ * The history is a ring buffer containing the last
+ * WLR_OUTPUT_TIMING_HISTORY_LEN committed frames.
+ */
+struct wlr_output_timing {
+	struct wlr_output *output;
+
+	struct wlr_output_frame_timing history[WLR_OUTPUT_TIMING_HISTORY_LEN];
+	size_t history_len;
+	size_t history_next; // index of the next entry to write
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	// private state
+
+	struct wlr_output_frame_timing pending;
+	uint64_t render_seq_start;
+
+	struct wl_listener output_precommit;
+	struct wl_listener output_commit;
+	struct wl_listener output_present;
+	struct wl_listener output_destroy;
+};
+
+/**
+ * Start recording frame timings for the output. Returns NULL if the output
+ * already has timing recording enabled.
+ *
+ * The wlr_output_timing is destroyed along with the output.
+ */
+struct wlr_output_timing *wlr_output_timing_create(struct wlr_output *output);
+void wlr_output_timing_destroy(struct wlr_output_timing *timing);
+/**
+ * Get a frame from the history. The most recently committed frame has the age
+ * zero. Returns NULL if there is no such frame.
+ */
+const struct wlr_output_frame_timing *wlr_output_timing_get_frame(
+	struct wlr_output_timing *timing, size_t age);
+/**
+ * Write the frame history in the Chrome trace event format, as JSON. The
+ * result can be loaded in Perfetto or chrome://tracing.
+ *
+ * Returns false on write error.
+ */
+bool wlr_output_timing_write_trace(struct wlr_output_timing *timing,
+	FILE *f);
+
+#endif
@@ -54,6 +54,14 @@ struct wlr_relative_pointer_v1 {
 	struct wl_listener seat_destroy;
 	struct wl_listener pointer_destroy;
 
+	// private state
+
+	// Accumulated motion, when the seat coalesces pointer motion
+	bool motion_pending;
+	uint64_t motion_time_usec;
+	double motion_dx, motion_dy, motion_dx_unaccel, motion_dy_unaccel;
+	struct wl_listener seat_motion_flush;
+
 	void *data;
 };
 
@@ -63,6 +71,9 @@ struct wlr_relative_pointer_manager_v1 *wlr_relative_pointer_manager_v1_create(
 /**
  * Send a relative motion event to the seat. Time is given in microseconds
  * (unlike wl_pointer which uses milliseconds).
+ *
+ * If the seat coalesces pointer motion, the deltas are accumulated and their
+ * sum is sent along with the wl_pointer motion events.
  */
 void wlr_relative_pointer_manager_v1_send_relative_motion(
 	struct wlr_relative_pointer_manager_v1 *manager, struct wlr_seat *seat,
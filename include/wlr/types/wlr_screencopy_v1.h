@@ -10,9 +10,12 @@
 #define WLR_TYPES_WLR_SCREENCOPY_V1_H
 
 #include <stdbool.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_box.h>
 
+struct wlr_readback;
+
 struct wlr_screencopy_manager_v1 {
 	struct wl_global *global;
 	struct wl_list frames; // wlr_screencopy_frame_v1::link
@@ -57,6 +60,13 @@ struct wlr_screencopy_frame_v1 {
 	struct wl_listener output_destroy;
 	struct wl_listener output_enable;
 
+	// Pending asynchronous read-back for shm buffers
+	struct wlr_readback *readback;
+	struct wl_event_source *readback_source;
+	struct timespec readback_when;
+	struct wlr_box readback_damage;
+	bool readback_has_damage;
+
 	void *data;
 };
 
@@ -13,6 +13,7 @@
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_pointer.h>
 #include <wlr/types/wlr_surface.h>
 
@@ -170,8 +171,20 @@ struct wlr_seat_pointer_state {
 
 	struct wl_listener surface_destroy;
 
+	// Motion coalescing, see wlr_seat_pointer_coalesce_motion()
+	struct wlr_output *coalesce_output;
+	bool motion_deferred; // some motion events haven't been sent yet
+	bool frame_deferred;
+	bool motion_pending; // a wl_pointer.motion event hasn't been sent yet
+	uint32_t motion_time;
+	double motion_sx, motion_sy;
+	struct wl_listener coalesce_output_frame;
+	struct wl_listener coalesce_output_destroy;
+
 	struct {
 		struct wl_signal focus_change; // wlr_seat_pointer_focus_change_event
+		// Deferred motion events are being sent to the focused client
+		struct wl_signal motion_flush; // wlr_seat
 	} events;
 };
 
@@ -396,6 +409,18 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time_msec,
  */
 void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat);
 
+/**
+ * Coalesce pointer motion events sent to clients. Motion events are
+ * accumulated and sent when the output sends a frame event, so that clients
+ * receive at most one motion event per frame. Button, axis and focus change
+ * events flush the accumulated motion first, so event order is preserved.
+ *
+ * The output should be the one the cursor is on. Pass NULL to disable
+ * coalescing.
+ */
+void wlr_seat_pointer_coalesce_motion(struct wlr_seat *wlr_seat,
+		struct wlr_output *output);
+
 /**
  * Notify the seat of a pointer enter event to the given surface and request it
  * to be the focused surface for the pointer. Pass surface-local coordinates
@@ -74,6 +74,15 @@ struct wlr_surface_role {
 	void (*precommit)(struct wlr_surface *surface);
 };
 
+/**
+ * A surface in a flattened surface tree, with its position relative to the
+ * root surface.
+ */
+struct wlr_surface_tree_entry {
+	struct wlr_surface *surface;
+	int x, y;
+};
+
 struct wlr_surface_output {
 	struct wlr_surface *surface;
 	struct wlr_output *output;
@@ -152,6 +161,19 @@ struct wlr_surface {
 	struct wl_listener renderer_destroy;
 
 	void *data;
+
+	// private state
+
+	// Previous buffer kept around to be updated in-place when the client
+	// alternates between two wl_shm buffers, and the damage it's missing
+	struct wlr_client_buffer *spare_buffer;
+	pixman_region32_t spare_damage;
+
+	// This surface and its subsurfaces in rendering order, rebuilt lazily
+	// when the tree is changed
+	struct wlr_surface_tree_entry *tree;
+	size_t tree_len, tree_cap;
+	bool tree_dirty;
 };
 
 struct wlr_subsurface_state {
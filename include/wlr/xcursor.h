@@ -42,6 +42,7 @@
 #ifndef WLR_XCURSOR_H
 #define WLR_XCURSOR_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <wlr/util/edges.h>
 
@@ -69,6 +70,12 @@ struct wlr_xcursor_theme {
 	struct wlr_xcursor **cursors;
 	char *name;
 	int size;
+
+	// private state
+
+	// Hash table of cursors by name, chained through their entries
+	struct wlr_xcursor_theme_entry **entries;
+	size_t entries_len, entries_cap;
 };
 
 /**
@@ -80,6 +87,15 @@ struct wlr_xcursor_theme {
  */
 struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size);
 
+/**
+ * Same as wlr_xcursor_theme_load, but only indexes the cursor files of the
+ * theme. A cursor is decoded the first time it's looked up with
+ * wlr_xcursor_theme_get_cursor, so `cursors` only contains the cursors
+ * decoded so far.
+ */
+struct wlr_xcursor_theme *wlr_xcursor_theme_load_lazy(const char *name,
+	int size);
+
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme);
 
 /**
@@ -216,6 +216,11 @@ struct wlr_xwayland_surface {
 
 	struct wl_listener surface_destroy;
 
+	// private state
+
+	// In-flight X11 requests about this window
+	struct wl_list pending_replies; // xwm_pending_reply::surface_link
+
 	void *data;
 };
 
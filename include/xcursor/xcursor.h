@@ -60,6 +60,14 @@ XcursorLibraryLoadImages (const char *file, const char *theme, int size);
 void
 XcursorImagesDestroy (XcursorImages *images);
 
+XcursorImages *
+xcursor_load_file(const char *path, const char *name, int size);
+
+void
+xcursor_scan_theme(const char *theme,
+		   void (*file_callback)(const char *, const char *, void *),
+		   void *user_data);
+
 void
 xcursor_load_theme(const char *theme, int size,
 		    void (*load_callback)(XcursorImages *, void *),
@@ -86,6 +86,17 @@ enum atom_name {
 
 extern const char *const atom_map[ATOM_LAST];
 
+struct xwm_id_map_entry {
+	uint32_t key; // 0 if the slot is free
+	struct wlr_xwayland_surface *surface;
+};
+
+// Open-addressed map from a non-zero X11 or Wayland id to a surface
+struct xwm_id_map {
+	struct xwm_id_map_entry *entries;
+	size_t len, cap; // cap is zero or a power of two
+};
+
 struct wlr_xwm {
 	struct wlr_xwayland *xwayland;
 	struct wl_event_source *event_source;
@@ -112,6 +123,24 @@ struct wlr_xwm {
 	// Surfaces in bottom-to-top stacking order, for _NET_CLIENT_LIST_STACKING
 	struct wl_list surfaces_in_stack_order; // wlr_xwayland_surface::stack_link
 	struct wl_list unpaired_surfaces; // wlr_xwayland_surface::unpaired_link
+	// Mapped windows in map order, for _NET_CLIENT_LIST
+	xcb_window_t *client_list;
+	size_t client_list_len, client_list_cap;
+	// Number of leading client_list entries already written to the root
+	// window; the rest can be appended unless the property needs a rewrite
+	size_t client_list_written;
+	bool client_list_replace;
+	bool client_list_stacking_dirty;
+	xcb_window_t *client_list_stacking; // scratch buffer
+	size_t client_list_stacking_cap;
+	// Coalesces root window property updates to one per loop iteration
+	struct wl_event_source *client_list_idle;
+
+	// Indexes for X event dispatch and for pairing with wl_surfaces
+	struct xwm_id_map surfaces_by_window; // keyed by window_id
+	struct xwm_id_map unpaired_by_surface_id; // keyed by surface_id
+	// In-flight requests, in the order they were sent
+	struct wl_list pending_replies; // xwm_pending_reply::link
 
 	struct wlr_drag *drag;
 	struct wlr_xwayland_surface *drag_focus;
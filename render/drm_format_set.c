@@ -19,22 +19,59 @@ void wlr_drm_format_set_finish(struct wlr_drm_format_set *set) {
 	set->formats = NULL;
 }
 
-static struct wlr_drm_format **format_set_get_ref(struct wlr_drm_format_set *set,
-		uint32_t format) {
-	for (size_t i = 0; i < set->len; ++i) {
-		if (set->formats[i]->format == format) {
-			return &set->formats[i];
+/**
+ * Find the index of a format in the set, which is sorted by format. If the
+ * format isn't in the set, false is returned and `idx` is set to the index
+ * at which it should be inserted.
+ */
+static bool format_set_find(const struct wlr_drm_format_set *set,
+		uint32_t format, size_t *idx) {
+	size_t lo = 0, hi = set->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		uint32_t mid_format = set->formats[mid]->format;
+		if (mid_format == format) {
+			*idx = mid;
+			return true;
+		} else if (mid_format < format) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
+	*idx = lo;
+	return false;
+}
 
-	return NULL;
+/**
+ * Same as format_set_find(), but for a modifier in a format. Modifiers are
+ * sorted.
+ */
+static bool format_find_modifier(const struct wlr_drm_format *fmt,
+		uint64_t modifier, size_t *idx) {
+	size_t lo = 0, hi = fmt->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (fmt->modifiers[mid] == modifier) {
+			*idx = mid;
+			return true;
+		} else if (fmt->modifiers[mid] < modifier) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*idx = lo;
+	return false;
 }
 
 const struct wlr_drm_format *wlr_drm_format_set_get(
 		const struct wlr_drm_format_set *set, uint32_t format) {
-	struct wlr_drm_format **ptr =
-		format_set_get_ref((struct wlr_drm_format_set *)set, format);
-	return ptr ? *ptr : NULL;
+	size_t idx;
+	if (!format_set_find(set, format, &idx)) {
+		return NULL;
+	}
+	return set->formats[idx];
 }
 
 bool wlr_drm_format_set_has(const struct wlr_drm_format_set *set,
@@ -48,22 +85,40 @@ bool wlr_drm_format_set_has(const struct wlr_drm_format_set *set,
 		return true;
 	}
 
-	for (size_t i = 0; i < fmt->len; ++i) {
-		if (fmt->modifiers[i] == modifier) {
-			return true;
+	size_t idx;
+	return format_find_modifier(fmt, modifier, &idx);
+}
+
+static bool format_set_insert(struct wlr_drm_format_set *set, size_t idx,
+		struct wlr_drm_format *fmt) {
+	if (set->len == set->cap) {
+		size_t new = set->cap ? set->cap * 2 : 4;
+
+		struct wlr_drm_format **tmp = realloc(set->formats,
+			sizeof(set->formats[0]) * new);
+		if (!tmp) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return false;
 		}
+
+		set->cap = new;
+		set->formats = tmp;
 	}
 
-	return false;
+	memmove(&set->formats[idx + 1], &set->formats[idx],
+		sizeof(set->formats[0]) * (set->len - idx));
+	set->formats[idx] = fmt;
+	set->len++;
+	return true;
 }
 
 bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 		uint64_t modifier) {
 	assert(format != DRM_FORMAT_INVALID);
 
-	struct wlr_drm_format **ptr = format_set_get_ref(set, format);
-	if (ptr) {
-		return wlr_drm_format_add(ptr, modifier);
+	size_t idx;
+	if (format_set_find(set, format, &idx)) {
+		return wlr_drm_format_add(&set->formats[idx], modifier);
 	}
 
 	struct wlr_drm_format *fmt = wlr_drm_format_create(format);
@@ -71,26 +126,55 @@ bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 		return false;
 	}
 	if (!wlr_drm_format_add(&fmt, modifier)) {
+		free(fmt);
 		return false;
 	}
 
-	if (set->len == set->cap) {
-		size_t new = set->cap ? set->cap * 2 : 4;
+	if (!format_set_insert(set, idx, fmt)) {
+		free(fmt);
+		return false;
+	}
+	return true;
+}
 
-		struct wlr_drm_format **tmp = realloc(set->formats,
-			sizeof(*fmt) + sizeof(fmt->modifiers[0]) * new);
-		if (!tmp) {
+bool wlr_drm_format_set_intersect(struct wlr_drm_format_set *dst,
+		const struct wlr_drm_format_set *a, const struct wlr_drm_format_set *b) {
+	struct wlr_drm_format_set out = {0};
+	size_t cap = a->len < b->len ? a->len : b->len;
+	if (cap > 0) {
+		out.formats = calloc(cap, sizeof(out.formats[0]));
+		if (out.formats == NULL) {
 			wlr_log_errno(WLR_ERROR, "Allocation failed");
-			free(fmt);
 			return false;
 		}
+		out.cap = cap;
+	}
 
-		set->cap = new;
-		set->formats = tmp;
+	// Both sets are sorted by format: walk them in lockstep
+	size_t i = 0, j = 0;
+	while (i < a->len && j < b->len) {
+		const struct wlr_drm_format *fmt_a = a->formats[i];
+		const struct wlr_drm_format *fmt_b = b->formats[j];
+		if (fmt_a->format < fmt_b->format) {
+			i++;
+			continue;
+		} else if (fmt_a->format > fmt_b->format) {
+			j++;
+			continue;
+		}
+
+		struct wlr_drm_format *fmt = wlr_drm_format_intersect(fmt_a, fmt_b);
+		if (fmt != NULL) {
+			assert(out.len < out.cap);
+			out.formats[out.len++] = fmt;
+		}
+		i++;
+		j++;
 	}
 
-	set->formats[set->len++] = fmt;
-	return true;
+	wlr_drm_format_set_finish(dst);
+	*dst = out;
+	return out.len > 0;
 }
 
 struct wlr_drm_format *wlr_drm_format_create(uint32_t format) {
@@ -113,10 +197,9 @@ bool wlr_drm_format_add(struct wlr_drm_format **fmt_ptr, uint64_t modifier) {
 		return true;
 	}
 
-	for (size_t i = 0; i < fmt->len; ++i) {
-		if (fmt->modifiers[i] == modifier) {
-			return true;
-		}
+	size_t idx;
+	if (format_find_modifier(fmt, modifier, &idx)) {
+		return true;
 	}
 
 	if (fmt->len == fmt->cap) {
@@ -132,7 +215,10 @@ bool wlr_drm_format_add(struct wlr_drm_format **fmt_ptr, uint64_t modifier) {
 		*fmt_ptr = fmt;
 	}
 
-	fmt->modifiers[fmt->len++] = modifier;
+	memmove(&fmt->modifiers[idx + 1], &fmt->modifiers[idx],
+		sizeof(fmt->modifiers[0]) * (fmt->len - idx));
+	fmt->modifiers[idx] = modifier;
+	fmt->len++;
 	return true;
 }
 
@@ -173,14 +259,19 @@ struct wlr_drm_format *wlr_drm_format_intersect(
 	format->format = a->format;
 	format->cap = format_cap;
 
-	for (size_t i = 0; i < a->len; i++) {
-		for (size_t j = 0; j < b->len; j++) {
-			if (a->modifiers[i] == b->modifiers[j]) {
-				assert(format->len < format->cap);
-				format->modifiers[format->len] = a->modifiers[i];
-				format->len++;
-				break;
-			}
+	// Modifiers are sorted: merge both lists
+	size_t i = 0, j = 0;
+	while (i < a->len && j < b->len) {
+		if (a->modifiers[i] < b->modifiers[j]) {
+			i++;
+		} else if (a->modifiers[i] > b->modifiers[j]) {
+			j++;
+		} else {
+			assert(format->len < format->cap);
+			format->modifiers[format->len] = a->modifiers[i];
+			format->len++;
+			i++;
+			j++;
 		}
 	}
 
@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/render/egl.h>
+#include <wlr/render/interface.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+#include "render/pixel_format.h"
+
+static const struct wlr_readback_impl readback_impl;
+
+static struct wlr_gles2_readback *gles2_get_readback(
+		struct wlr_readback *wlr_readback) {
+	assert(wlr_readback->impl == &readback_impl);
+	return (struct wlr_gles2_readback *)wlr_readback;
+}
+
+static bool gles2_readback_is_ready(struct wlr_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	if (readback->sync == EGL_NO_SYNC_KHR) {
+		// No way to know, mapping the buffer will block until the copy is done
+		return true;
+	}
+
+	struct wlr_egl *egl = readback->renderer->egl;
+	EGLint ret = egl->procs.eglClientWaitSyncKHR(egl->display,
+		readback->sync, 0, 0);
+	if (ret == EGL_FALSE) {
+		wlr_log(WLR_ERROR, "eglClientWaitSyncKHR failed");
+		return true;
+	}
+	return ret == EGL_CONDITION_SATISFIED_KHR;
+}
+
+static int gles2_readback_get_fence_fd(struct wlr_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	return readback->fence_fd;
+}
+
+static bool gles2_readback_finish(struct wlr_readback *wlr_readback,
+		uint32_t *flags, uint32_t stride, uint32_t dst_x, uint32_t dst_y,
+		void *data) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	const struct wlr_pixel_format_info *drm_fmt =
+		drm_get_pixel_format_info(wlr_readback->format);
+	assert(drm_fmt);
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_save_context(&prev_ctx);
+	wlr_egl_make_current(renderer->egl);
+
+	push_gles2_debug(renderer);
+
+	size_t size = (size_t)readback->pbo_stride * wlr_readback->height;
+	glBindBuffer(PIXEL_PACK_BUFFER, readback->pbo);
+	const unsigned char *src = renderer->procs.glMapBufferRange(
+		PIXEL_PACK_BUFFER, 0, size, MAP_READ_BIT);
+	bool ok = src != NULL;
+	if (ok) {
+		unsigned char *dst = (unsigned char *)data + dst_y * stride +
+			dst_x * drm_fmt->bpp / 8;
+		uint32_t row_size = wlr_readback->width * drm_fmt->bpp / 8;
+		if (row_size == stride && row_size == readback->pbo_stride) {
+			memcpy(dst, src, size);
+		} else {
+			for (size_t i = 0; i < wlr_readback->height; i++) {
+				memcpy(dst + i * stride, src + i * readback->pbo_stride,
+					row_size);
+			}
+		}
+		renderer->procs.glUnmapBuffer(PIXEL_PACK_BUFFER);
+	} else {
+		wlr_log(WLR_ERROR, "Failed to map pixel buffer object");
+	}
+	glBindBuffer(PIXEL_PACK_BUFFER, 0);
+
+	pop_gles2_debug(renderer);
+
+	wlr_egl_restore_context(&prev_ctx);
+
+	if (flags != NULL) {
+		*flags = 0;
+	}
+
+	return ok;
+}
+
+static void gles2_readback_destroy(struct wlr_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_save_context(&prev_ctx);
+	wlr_egl_make_current(renderer->egl);
+
+	push_gles2_debug(renderer);
+
+	glDeleteBuffers(1, &readback->pbo);
+	if (readback->sync != EGL_NO_SYNC_KHR) {
+		renderer->egl->procs.eglDestroySyncKHR(renderer->egl->display,
+			readback->sync);
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+	}
+
+	pop_gles2_debug(renderer);
+
+	wlr_egl_restore_context(&prev_ctx);
+
+	free(readback);
+}
+
+static const struct wlr_readback_impl readback_impl = {
+	.is_ready = gles2_readback_is_ready,
+	.get_fence_fd = gles2_readback_get_fence_fd,
+	.finish = gles2_readback_finish,
+	.destroy = gles2_readback_destroy,
+};
+
+struct wlr_readback *gles2_read_pixels_async(struct wlr_renderer *wlr_renderer,
+		uint32_t drm_format, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	assert(wlr_egl_is_current(renderer->egl));
+
+	if (!renderer->exts.pixel_buffer_object) {
+		return NULL;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_gles2_format_from_drm(drm_format);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
+		return NULL;
+	}
+
+	if (fmt->gl_format == GL_BGRA_EXT && !renderer->exts.read_format_bgra_ext) {
+		wlr_log(WLR_ERROR,
+			"Cannot read pixels: missing GL_EXT_read_format_bgra extension");
+		return NULL;
+	}
+
+	const struct wlr_pixel_format_info *drm_fmt =
+		drm_get_pixel_format_info(fmt->drm_format);
+	assert(drm_fmt);
+
+	struct wlr_gles2_readback *readback = calloc(1, sizeof(*readback));
+	if (readback == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_readback_init(&readback->wlr_readback, &readback_impl,
+		fmt->drm_format, width, height);
+	readback->renderer = renderer;
+	readback->sync = EGL_NO_SYNC_KHR;
+	readback->fence_fd = -1;
+
+	// Rows are packed with the default 4-byte alignment
+	readback->pbo_stride = (width * drm_fmt->bpp / 8 + 3) & ~3u;
+
+	push_gles2_debug(renderer);
+
+	glGetError(); // Clear the error flag
+
+	glGenBuffers(1, &readback->pbo);
+	glBindBuffer(PIXEL_PACK_BUFFER, readback->pbo);
+	glBufferData(PIXEL_PACK_BUFFER, (GLsizeiptr)readback->pbo_stride * height,
+		NULL, renderer->pbo_usage);
+
+	// With a pixel pack buffer bound, the last argument is an offset into the
+	// buffer and glReadPixels returns without waiting for the GPU
+	glReadPixels(src_x, src_y, width, height, fmt->gl_format, fmt->gl_type,
+		NULL);
+	glBindBuffer(PIXEL_PACK_BUFFER, 0);
+
+	// A native fence can be exported as a sync_file and waited for in an
+	// event loop
+	struct wlr_egl *egl = renderer->egl;
+	bool native_fence = egl->exts.native_fence_sync_android;
+	if (native_fence) {
+		readback->sync = wlr_egl_create_sync(egl, -1);
+	} else if (egl->exts.fence_sync_khr) {
+		readback->sync = egl->procs.eglCreateSyncKHR(egl->display,
+			EGL_SYNC_FENCE_KHR, NULL);
+		if (readback->sync == EGL_NO_SYNC_KHR) {
+			wlr_log(WLR_DEBUG, "eglCreateSyncKHR failed");
+		}
+	}
+	// Make sure the copy and the fence are submitted to the GPU
+	glFlush();
+
+	if (native_fence && readback->sync != EGL_NO_SYNC_KHR) {
+		readback->fence_fd = wlr_egl_dup_fence_fd(egl, readback->sync);
+	}
+
+	pop_gles2_debug(renderer);
+
+	if (glGetError() != GL_NO_ERROR) {
+		wlr_log(WLR_ERROR, "Failed to start asynchronous read-back");
+		wlr_readback_destroy(&readback->wlr_readback);
+		return NULL;
+	}
+
+	return &readback->wlr_readback;
+}
@@ -3,6 +3,7 @@
 #include <gbm.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,6 +20,11 @@
 #include "render/pixel_format.h"
 #include "types/wlr_buffer.h"
 
+// GLES3 enum, not defined by the GLES2 headers
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+
 static const GLfloat verts[] = {
 	1, 0, // top right
 	0, 0, // top left
@@ -146,6 +152,38 @@ error_buffer:
 	return NULL;
 }
 
+bool gles2_wait_fence(struct wlr_gles2_renderer *renderer, int fence_fd) {
+	struct wlr_egl *egl = renderer->egl;
+	if (!egl->exts.native_fence_sync_android || !egl->exts.wait_sync_khr) {
+		close(fence_fd);
+		return false;
+	}
+
+	EGLSyncKHR sync = wlr_egl_create_sync(egl, fence_fd);
+	if (sync == EGL_NO_SYNC_KHR) {
+		close(fence_fd);
+		return false;
+	}
+	bool ok = wlr_egl_wait_sync(egl, sync);
+	wlr_egl_destroy_sync(egl, sync);
+	return ok;
+}
+
+/**
+ * Flush the rendering commands and export a fence signalled when they're
+ * done. Returns -1 if the renderer doesn't support explicit synchronization.
+ */
+static int flush_with_fence(struct wlr_gles2_renderer *renderer) {
+	EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, -1);
+	glFlush();
+	if (sync == EGL_NO_SYNC_KHR) {
+		return -1;
+	}
+	int fence_fd = wlr_egl_dup_fence_fd(renderer->egl, sync);
+	wlr_egl_destroy_sync(renderer->egl, sync);
+	return fence_fd;
+}
+
 static bool gles2_bind_buffer(struct wlr_renderer *wlr_renderer,
 		struct wlr_buffer *wlr_buffer) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
@@ -154,7 +192,11 @@ static bool gles2_bind_buffer(struct wlr_renderer *wlr_renderer,
 		assert(wlr_egl_is_current(renderer->egl));
 
 		push_gles2_debug(renderer);
-		glFlush();
+		// Consumers can wait on the fence instead of relying on implicit
+		// synchronization
+		int fence_fd = flush_with_fence(renderer);
+		wlr_buffer_set_acquire_fence(renderer->current_buffer->buffer,
+			fence_fd);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		pop_gles2_debug(renderer);
 
@@ -180,6 +222,12 @@ static bool gles2_bind_buffer(struct wlr_renderer *wlr_renderer,
 	wlr_buffer_lock(wlr_buffer);
 	renderer->current_buffer = buffer;
 
+	// Previous consumers might still be reading from the buffer
+	int release_fd = wlr_buffer_take_release_fence(wlr_buffer);
+	if (release_fd >= 0) {
+		gles2_wait_fence(renderer, release_fd);
+	}
+
 	push_gles2_debug(renderer);
 	glBindFramebuffer(GL_FRAMEBUFFER, renderer->current_buffer->fbo);
 	pop_gles2_debug(renderer);
@@ -209,12 +257,77 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 	// XXX: maybe we should save output projection and remove some of the need
 	// for users to sling matricies themselves
 
+	if (renderer->exts.disjoint_timer_query_ext) {
+		uint64_t seq = wlr_renderer->render_seq;
+		size_t i = seq % GLES2_TIMER_QUERIES_LEN;
+		renderer->timer_queries[i].render_seq = seq;
+		renderer->timer_queries[i].ended = false;
+		renderer->procs.glQueryCounterEXT(renderer->timer_queries[i].begin,
+			GL_TIMESTAMP_EXT);
+	}
+
 	pop_gles2_debug(renderer);
 }
 
 static void gles2_end(struct wlr_renderer *wlr_renderer) {
-	gles2_get_renderer_in_context(wlr_renderer);
-	// no-op
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	if (renderer->exts.disjoint_timer_query_ext) {
+		size_t i = wlr_renderer->render_seq % GLES2_TIMER_QUERIES_LEN;
+		push_gles2_debug(renderer);
+		renderer->procs.glQueryCounterEXT(renderer->timer_queries[i].end,
+			GL_TIMESTAMP_EXT);
+		pop_gles2_debug(renderer);
+		renderer->timer_queries[i].ended = true;
+	}
+}
+
+static bool gles2_get_render_time(struct wlr_renderer *wlr_renderer,
+		uint64_t render_seq, uint64_t *ns) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	if (!renderer->exts.disjoint_timer_query_ext || render_seq == 0) {
+		return false;
+	}
+
+	size_t i = render_seq % GLES2_TIMER_QUERIES_LEN;
+	if (renderer->timer_queries[i].render_seq != render_seq ||
+			!renderer->timer_queries[i].ended) {
+		return false;
+	}
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_save_context(&prev_ctx);
+	wlr_egl_make_current(renderer->egl);
+
+	push_gles2_debug(renderer);
+
+	bool ok = false;
+	GLuint available = GL_FALSE;
+	renderer->procs.glGetQueryObjectuivEXT(renderer->timer_queries[i].end,
+		GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+	if (available) {
+		// Reading GL_GPU_DISJOINT_EXT resets it, the timestamps are only
+		// meaningful if no disjoint operation happened in the meantime
+		GLint disjoint = GL_FALSE;
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+		GLuint64 begin = 0, end = 0;
+		renderer->procs.glGetQueryObjectui64vEXT(
+			renderer->timer_queries[i].begin, GL_QUERY_RESULT_EXT, &begin);
+		renderer->procs.glGetQueryObjectui64vEXT(
+			renderer->timer_queries[i].end, GL_QUERY_RESULT_EXT, &end);
+		if (!disjoint && end >= begin) {
+			*ns = end - begin;
+			ok = true;
+		}
+	}
+
+	pop_gles2_debug(renderer);
+
+	wlr_egl_restore_context(&prev_ctx);
+
+	return ok;
 }
 
 static void gles2_clear(struct wlr_renderer *wlr_renderer,
@@ -249,38 +362,42 @@ static const float flip_180[9] = {
 	0.0f, 0.0f, 1.0f,
 };
 
-static bool gles2_render_subtexture_with_matrix(
-		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
-		const struct wlr_fbox *box, const float matrix[static 9],
-		float alpha) {
-	struct wlr_gles2_renderer *renderer =
-		gles2_get_renderer_in_context(wlr_renderer);
-	struct wlr_gles2_texture *texture =
-		gles2_get_texture(wlr_texture);
-	assert(texture->renderer == renderer);
-
-	struct wlr_gles2_tex_shader *shader = NULL;
-
+static struct wlr_gles2_tex_shader *get_tex_shader(
+		struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_texture *texture) {
 	switch (texture->target) {
 	case GL_TEXTURE_2D:
 		if (texture->has_alpha) {
-			shader = &renderer->shaders.tex_rgba;
+			return &renderer->shaders.tex_rgba;
 		} else {
-			shader = &renderer->shaders.tex_rgbx;
+			return &renderer->shaders.tex_rgbx;
 		}
-		break;
 	case GL_TEXTURE_EXTERNAL_OES:
-		shader = &renderer->shaders.tex_ext;
-
 		if (!renderer->exts.egl_image_external_oes) {
 			wlr_log(WLR_ERROR, "Failed to render texture: "
 				"GL_TEXTURE_EXTERNAL_OES not supported");
-			return false;
+			return NULL;
 		}
-		break;
+		return &renderer->shaders.tex_ext;
 	default:
 		abort();
 	}
+}
+
+static bool gles2_render_subtexture_with_matrix(
+		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
+		const struct wlr_fbox *box, const float matrix[static 9],
+		float alpha) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	struct wlr_gles2_texture *texture =
+		gles2_get_texture(wlr_texture);
+	assert(texture->renderer == renderer);
+
+	struct wlr_gles2_tex_shader *shader = get_tex_shader(renderer, texture);
+	if (shader == NULL) {
+		return false;
+	}
 
 	float gl_matrix[9];
 	wlr_matrix_multiply(gl_matrix, renderer->projection, matrix);
@@ -292,6 +409,8 @@ static bool gles2_render_subtexture_with_matrix(
 
 	push_gles2_debug(renderer);
 
+	gles2_texture_wait_acquire_fence(texture);
+
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(texture->target, texture->tex);
 
@@ -332,6 +451,239 @@ static bool gles2_render_subtexture_with_matrix(
 	return true;
 }
 
+// Each vertex is made of a position in buffer coordinates and a texture
+// coordinate
+#define BATCH_VERTEX_LEN 4
+#define BATCH_QUAD_VERTS 6
+
+static bool batch_reserve(struct wlr_gles2_renderer *renderer, size_t n) {
+	if (renderer->batch.len + n <= renderer->batch.cap) {
+		return true;
+	}
+
+	size_t cap = renderer->batch.cap;
+	if (cap == 0) {
+		cap = 64 * BATCH_QUAD_VERTS;
+	}
+	while (renderer->batch.len + n > cap) {
+		cap *= 2;
+	}
+
+	GLfloat *verts = realloc(renderer->batch.verts,
+		cap * BATCH_VERTEX_LEN * sizeof(GLfloat));
+	if (verts == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	renderer->batch.verts = verts;
+	renderer->batch.cap = cap;
+	return true;
+}
+
+static void batch_add_vertex(struct wlr_gles2_renderer *renderer,
+		const struct wlr_render_texture_item *item, float u, float v) {
+	const float *mat = item->matrix;
+	const struct wlr_fbox *box = &item->src_box;
+
+	GLfloat *vert =
+		&renderer->batch.verts[renderer->batch.len * BATCH_VERTEX_LEN];
+	vert[0] = mat[0] * u + mat[1] * v + mat[2];
+	vert[1] = mat[3] * u + mat[4] * v + mat[5];
+	vert[2] = (box->x + u * box->width) / item->texture->width;
+	vert[3] = (box->y + v * box->height) / item->texture->height;
+	renderer->batch.len++;
+}
+
+/**
+ * Appends the part of the unit square between (u1, v1) and (u2, v2) as two
+ * triangles.
+ */
+static void batch_add_quad(struct wlr_gles2_renderer *renderer,
+		const struct wlr_render_texture_item *item,
+		float u1, float v1, float u2, float v2) {
+	batch_add_vertex(renderer, item, u2, v1);
+	batch_add_vertex(renderer, item, u1, v1);
+	batch_add_vertex(renderer, item, u2, v2);
+	batch_add_vertex(renderer, item, u2, v2);
+	batch_add_vertex(renderer, item, u1, v1);
+	batch_add_vertex(renderer, item, u1, v2);
+}
+
+/**
+ * Checks whether the matrix maps the unit square to an axis-aligned rectangle,
+ * in which case clipping can be done on the geometry instead of with the
+ * scissor test.
+ */
+static bool matrix_is_axis_aligned(const float mat[static 9]) {
+	if (mat[6] != 0 || mat[7] != 0 || mat[8] != 1) {
+		return false;
+	}
+	if (mat[0] * mat[4] - mat[1] * mat[3] == 0) {
+		return false;
+	}
+	return (mat[1] == 0 && mat[3] == 0) || (mat[0] == 0 && mat[4] == 0);
+}
+
+static bool batch_add_item(struct wlr_gles2_renderer *renderer,
+		const struct wlr_render_texture_item *item) {
+	if (item->clip_rects_len == 0) {
+		if (!batch_reserve(renderer, BATCH_QUAD_VERTS)) {
+			return false;
+		}
+		batch_add_quad(renderer, item, 0, 0, 1, 1);
+		return true;
+	}
+
+	if (!batch_reserve(renderer, item->clip_rects_len * BATCH_QUAD_VERTS)) {
+		return false;
+	}
+
+	const float *mat = item->matrix;
+	float det = mat[0] * mat[4] - mat[1] * mat[3];
+	for (size_t i = 0; i < item->clip_rects_len; i++) {
+		const struct wlr_box *clip = &item->clip_rects[i];
+
+		// Map the clip rectangle back to the unit square. Since the matrix is
+		// axis-aligned, the result is axis-aligned as well.
+		float dx1 = clip->x - mat[2], dy1 = clip->y - mat[5];
+		float dx2 = dx1 + clip->width, dy2 = dy1 + clip->height;
+		float ua = (mat[4] * dx1 - mat[1] * dy1) / det;
+		float va = (mat[0] * dy1 - mat[3] * dx1) / det;
+		float ub = (mat[4] * dx2 - mat[1] * dy2) / det;
+		float vb = (mat[0] * dy2 - mat[3] * dx2) / det;
+
+		float u1 = fmaxf(fminf(ua, ub), 0);
+		float v1 = fmaxf(fminf(va, vb), 0);
+		float u2 = fminf(fmaxf(ua, ub), 1);
+		float v2 = fminf(fmaxf(va, vb), 1);
+		if (u1 >= u2 || v1 >= v2) {
+			continue;
+		}
+
+		batch_add_quad(renderer, item, u1, v1, u2, v2);
+	}
+	return true;
+}
+
+/**
+ * Draws the vertices accumulated so far. They all belong to items sharing the
+ * same texture and alpha as `item`.
+ */
+static void batch_flush(struct wlr_gles2_renderer *renderer,
+		const struct wlr_render_texture_item *item,
+		const float gl_matrix[static 9]) {
+	if (renderer->batch.len == 0) {
+		return;
+	}
+
+	struct wlr_gles2_texture *texture = gles2_get_texture(item->texture);
+	struct wlr_gles2_tex_shader *shader = get_tex_shader(renderer, texture);
+	assert(shader != NULL);
+
+	glBindBuffer(GL_ARRAY_BUFFER, renderer->batch.vbo);
+	glBufferData(GL_ARRAY_BUFFER,
+		renderer->batch.len * BATCH_VERTEX_LEN * sizeof(GLfloat),
+		renderer->batch.verts, GL_STREAM_DRAW);
+
+	gles2_texture_wait_acquire_fence(texture);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(texture->target, texture->tex);
+
+	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+	glUseProgram(shader->program);
+
+	glUniformMatrix3fv(shader->proj, 1, GL_FALSE, gl_matrix);
+	glUniform1i(shader->invert_y, texture->inverted_y);
+	glUniform1i(shader->tex, 0);
+	glUniform1f(shader->alpha, item->alpha);
+
+	GLsizei stride = BATCH_VERTEX_LEN * sizeof(GLfloat);
+	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, stride,
+		(const void *)0);
+	glVertexAttribPointer(shader->tex_attrib, 2, GL_FLOAT, GL_FALSE, stride,
+		(const void *)(2 * sizeof(GLfloat)));
+
+	glEnableVertexAttribArray(shader->pos_attrib);
+	glEnableVertexAttribArray(shader->tex_attrib);
+
+	glDrawArrays(GL_TRIANGLES, 0, renderer->batch.len);
+
+	glDisableVertexAttribArray(shader->pos_attrib);
+	glDisableVertexAttribArray(shader->tex_attrib);
+
+	glBindTexture(texture->target, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	renderer->batch.len = 0;
+}
+
+static bool gles2_render_texture_batch(struct wlr_renderer *wlr_renderer,
+		const struct wlr_render_texture_item *items, size_t items_len) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	// Vertices are already in buffer coordinates, only the projection is left
+	float gl_matrix[9];
+	wlr_matrix_multiply(gl_matrix, flip_180, renderer->projection);
+	wlr_matrix_transpose(gl_matrix, gl_matrix);
+
+	push_gles2_debug(renderer);
+
+	glDisable(GL_SCISSOR_TEST);
+
+	bool ok = true;
+	const struct wlr_render_texture_item *pending = NULL;
+	for (size_t i = 0; i < items_len; i++) {
+		const struct wlr_render_texture_item *item = &items[i];
+		struct wlr_gles2_texture *texture = gles2_get_texture(item->texture);
+		assert(texture->renderer == renderer);
+
+		if (pending != NULL && (pending->texture != item->texture ||
+				pending->alpha != item->alpha)) {
+			batch_flush(renderer, pending, gl_matrix);
+			pending = NULL;
+		}
+
+		if (get_tex_shader(renderer, texture) == NULL) {
+			ok = false;
+			continue;
+		}
+
+		if (item->clip_rects_len > 0 && !matrix_is_axis_aligned(item->matrix)) {
+			// Rotated quads can't be clipped on the CPU, draw this one with
+			// the scissor test
+			if (pending != NULL) {
+				batch_flush(renderer, pending, gl_matrix);
+				pending = NULL;
+			}
+			for (size_t j = 0; j < item->clip_rects_len; j++) {
+				const struct wlr_box *clip = &item->clip_rects[j];
+				glScissor(clip->x, clip->y, clip->width, clip->height);
+				glEnable(GL_SCISSOR_TEST);
+				ok = gles2_render_subtexture_with_matrix(wlr_renderer,
+					item->texture, &item->src_box, item->matrix,
+					item->alpha) && ok;
+			}
+			glDisable(GL_SCISSOR_TEST);
+			continue;
+		}
+
+		if (!batch_add_item(renderer, item)) {
+			ok = false;
+			continue;
+		}
+		pending = item;
+	}
+	if (pending != NULL) {
+		batch_flush(renderer, pending, gl_matrix);
+	}
+
+	pop_gles2_debug(renderer);
+	return ok;
+}
+
 static void gles2_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
 		const float color[static 4], const float matrix[static 9]) {
 	struct wlr_gles2_renderer *renderer =
@@ -558,6 +910,18 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 	glDeleteProgram(renderer->shaders.tex_rgba.program);
 	glDeleteProgram(renderer->shaders.tex_rgbx.program);
 	glDeleteProgram(renderer->shaders.tex_ext.program);
+	glDeleteBuffers(1, &renderer->batch.vbo);
+	for (size_t i = 0; i < GLES2_UPLOAD_PBOS_LEN; i++) {
+		glDeleteBuffers(1, &renderer->upload_pbos[i].pbo);
+	}
+	if (renderer->exts.disjoint_timer_query_ext) {
+		for (size_t i = 0; i < GLES2_TIMER_QUERIES_LEN; i++) {
+			renderer->procs.glDeleteQueriesEXT(1,
+				&renderer->timer_queries[i].begin);
+			renderer->procs.glDeleteQueriesEXT(1,
+				&renderer->timer_queries[i].end);
+		}
+	}
 	pop_gles2_debug(renderer);
 
 	if (renderer->exts.debug_khr) {
@@ -568,6 +932,8 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 	wlr_egl_unset_current(renderer->egl);
 	wlr_egl_destroy(renderer->egl);
 
+	free(renderer->batch.verts);
+
 	if (renderer->drm_fd >= 0) {
 		close(renderer->drm_fd);
 	}
@@ -583,6 +949,7 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.clear = gles2_clear,
 	.scissor = gles2_scissor,
 	.render_subtexture_with_matrix = gles2_render_subtexture_with_matrix,
+	.render_texture_batch = gles2_render_texture_batch,
 	.render_quad_with_matrix = gles2_render_quad_with_matrix,
 	.get_shm_texture_formats = gles2_get_shm_texture_formats,
 	.resource_is_wl_drm_buffer = gles2_resource_is_wl_drm_buffer,
@@ -591,6 +958,8 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.get_render_formats = gles2_get_render_formats,
 	.preferred_read_format = gles2_preferred_read_format,
 	.read_pixels = gles2_read_pixels,
+	.read_pixels_async = gles2_read_pixels_async,
+	.get_render_time = gles2_get_render_time,
 	.texture_from_pixels = gles2_texture_from_pixels,
 	.texture_from_wl_drm = gles2_texture_from_wl_drm,
 	.texture_from_dmabuf = gles2_texture_from_dmabuf,
@@ -827,6 +1196,41 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 			"glEGLImageTargetRenderbufferStorageOES");
 	}
 
+	int gles_major = 0;
+	const char *version = (const char *)glGetString(GL_VERSION);
+	if (version != NULL) {
+		sscanf(version, "OpenGL ES %d", &gles_major);
+	}
+	if (gles_major >= 3) {
+		renderer->procs.glMapBufferRange =
+			(void *)eglGetProcAddress("glMapBufferRange");
+		renderer->procs.glUnmapBuffer =
+			(void *)eglGetProcAddress("glUnmapBuffer");
+		renderer->pbo_usage = GL_STREAM_READ;
+	} else if (check_gl_ext(exts_str, "GL_NV_pixel_buffer_object") &&
+			check_gl_ext(exts_str, "GL_EXT_map_buffer_range") &&
+			check_gl_ext(exts_str, "GL_OES_mapbuffer")) {
+		load_gl_proc(&renderer->procs.glMapBufferRange,
+			"glMapBufferRangeEXT");
+		load_gl_proc(&renderer->procs.glUnmapBuffer, "glUnmapBufferOES");
+		renderer->pbo_usage = GL_STREAM_DRAW;
+	}
+	renderer->exts.pixel_buffer_object =
+		renderer->procs.glMapBufferRange != NULL &&
+		renderer->procs.glUnmapBuffer != NULL;
+
+	if (check_gl_ext(exts_str, "GL_EXT_disjoint_timer_query")) {
+		renderer->exts.disjoint_timer_query_ext = true;
+		load_gl_proc(&renderer->procs.glGenQueriesEXT, "glGenQueriesEXT");
+		load_gl_proc(&renderer->procs.glDeleteQueriesEXT,
+			"glDeleteQueriesEXT");
+		load_gl_proc(&renderer->procs.glQueryCounterEXT, "glQueryCounterEXT");
+		load_gl_proc(&renderer->procs.glGetQueryObjectuivEXT,
+			"glGetQueryObjectuivEXT");
+		load_gl_proc(&renderer->procs.glGetQueryObjectui64vEXT,
+			"glGetQueryObjectui64vEXT");
+	}
+
 	if (renderer->exts.debug_khr) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -889,6 +1293,17 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 		renderer->shaders.tex_ext.tex_attrib = glGetAttribLocation(prog, "texcoord");
 	}
 
+	glGenBuffers(1, &renderer->batch.vbo);
+
+	if (renderer->exts.disjoint_timer_query_ext) {
+		for (size_t i = 0; i < GLES2_TIMER_QUERIES_LEN; i++) {
+			renderer->procs.glGenQueriesEXT(1,
+				&renderer->timer_queries[i].begin);
+			renderer->procs.glGenQueriesEXT(1,
+				&renderer->timer_queries[i].end);
+		}
+	}
+
 	pop_gles2_debug(renderer);
 
 	wlr_egl_unset_current(renderer->egl);
@@ -4,6 +4,7 @@
 #include <GLES2/gl2ext.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wayland-server-protocol.h>
 #include <wayland-util.h>
 #include <wlr/render/egl.h>
@@ -99,6 +100,152 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 	return true;
 }
 
+/**
+ * Copy the rectangles into a staging buffer, packed one after the other.
+ * Returns the PBO, or zero on error.
+ */
+static GLuint stage_upload(struct wlr_gles2_renderer *renderer,
+		uint32_t stride, size_t bytes_per_pixel, int rects_len,
+		const pixman_box32_t *rects, const unsigned char *data) {
+	size_t size = 0;
+	for (int i = 0; i < rects_len; i++) {
+		size += (size_t)(rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1) * bytes_per_pixel;
+	}
+
+	size_t i = renderer->upload_pbo_next;
+	renderer->upload_pbo_next = (i + 1) % GLES2_UPLOAD_PBOS_LEN;
+	if (renderer->upload_pbos[i].pbo == 0) {
+		glGenBuffers(1, &renderer->upload_pbos[i].pbo);
+	}
+	GLuint pbo = renderer->upload_pbos[i].pbo;
+
+	glBindBuffer(PIXEL_UNPACK_BUFFER, pbo);
+	if (renderer->upload_pbos[i].size < size) {
+		glBufferData(PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		renderer->upload_pbos[i].size = size;
+	}
+
+	// Invalidating lets the driver hand out fresh storage if the GPU is
+	// still reading the previous contents
+	unsigned char *dst = renderer->procs.glMapBufferRange(PIXEL_UNPACK_BUFFER,
+		0, size, MAP_WRITE_BIT | MAP_INVALIDATE_BUFFER_BIT);
+	if (dst == NULL) {
+		glBindBuffer(PIXEL_UNPACK_BUFFER, 0);
+		return 0;
+	}
+	for (int j = 0; j < rects_len; j++) {
+		const pixman_box32_t *r = &rects[j];
+		size_t row_size = (size_t)(r->x2 - r->x1) * bytes_per_pixel;
+		const unsigned char *src =
+			data + (size_t)r->y1 * stride + (size_t)r->x1 * bytes_per_pixel;
+		for (int y = r->y1; y < r->y2; y++) {
+			memcpy(dst, src, row_size);
+			dst += row_size;
+			src += stride;
+		}
+	}
+	renderer->procs.glUnmapBuffer(PIXEL_UNPACK_BUFFER);
+
+	return pbo;
+}
+
+static bool gles2_texture_write_pixels_region(struct wlr_texture *wlr_texture,
+		uint32_t stride, int rects_len, const pixman_box32_t *rects,
+		const void *data) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	struct wlr_gles2_renderer *renderer = texture->renderer;
+
+	if (texture->target != GL_TEXTURE_2D || texture->image != EGL_NO_IMAGE_KHR) {
+		wlr_log(WLR_ERROR, "Cannot write pixels to immutable texture");
+		return false;
+	}
+
+	if (rects_len == 0) {
+		// Mapping an empty staging buffer range is an error
+		return true;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_gles2_format_from_drm(texture->drm_format);
+	assert(fmt);
+
+	const struct wlr_pixel_format_info *drm_fmt =
+		drm_get_pixel_format_info(texture->drm_format);
+	assert(drm_fmt);
+	size_t bytes_per_pixel = drm_fmt->bpp / 8;
+
+	if (!check_stride(drm_fmt, stride, texture->wlr_texture.width)) {
+		return false;
+	}
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_save_context(&prev_ctx);
+	wlr_egl_make_current(renderer->egl);
+
+	push_gles2_debug(renderer);
+
+	glBindTexture(GL_TEXTURE_2D, texture->tex);
+
+	GLuint pbo = 0;
+	if (renderer->exts.pixel_buffer_object) {
+		pbo = stage_upload(renderer, stride, bytes_per_pixel, rects_len,
+			rects, data);
+	}
+
+	if (pbo != 0) {
+		// Rows are tightly packed in the staging buffer
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		uintptr_t offset = 0;
+		for (int i = 0; i < rects_len; i++) {
+			const pixman_box32_t *r = &rects[i];
+			int width = r->x2 - r->x1, height = r->y2 - r->y1;
+			glTexSubImage2D(GL_TEXTURE_2D, 0, r->x1, r->y1, width, height,
+				fmt->gl_format, fmt->gl_type, (const void *)offset);
+			offset += (uintptr_t)width * height * bytes_per_pixel;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(PIXEL_UNPACK_BUFFER, 0);
+	} else {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / bytes_per_pixel);
+		for (int i = 0; i < rects_len; i++) {
+			const pixman_box32_t *r = &rects[i];
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, r->x1);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, r->y1);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, r->x1, r->y1,
+				r->x2 - r->x1, r->y2 - r->y1,
+				fmt->gl_format, fmt->gl_type, data);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	pop_gles2_debug(renderer);
+
+	wlr_egl_restore_context(&prev_ctx);
+
+	return true;
+}
+
+void gles2_texture_wait_acquire_fence(struct wlr_gles2_texture *texture) {
+	struct wlr_buffer *buffer = texture->buffer;
+	if (buffer == NULL || buffer->acquire_fence_fd < 0 ||
+			texture->acquire_fence_seq == buffer->acquire_fence_seq) {
+		return;
+	}
+	texture->acquire_fence_seq = buffer->acquire_fence_seq;
+
+	int fence_fd = wlr_buffer_dup_acquire_fence(buffer);
+	if (fence_fd < 0) {
+		return;
+	}
+	// Without explicit synchronization support, rely on implicit sync
+	gles2_wait_fence(texture->renderer, fence_fd);
+}
+
 static bool gles2_texture_invalidate(struct wlr_gles2_texture *texture) {
 	if (texture->image == EGL_NO_IMAGE_KHR) {
 		return false;
@@ -160,6 +307,7 @@ static void gles2_texture_unref(struct wlr_texture *wlr_texture) {
 static const struct wlr_texture_impl texture_impl = {
 	.is_opaque = gles2_texture_is_opaque,
 	.write_pixels = gles2_texture_write_pixels,
+	.write_pixels_region = gles2_texture_write_pixels_region,
 	.destroy = gles2_texture_unref,
 };
 
@@ -365,21 +513,43 @@ static void texture_handle_buffer_destroy(struct wl_listener *listener,
 	gles2_texture_destroy(texture);
 }
 
+/**
+ * Find the texture previously imported from the buffer. The texture listens
+ * to the buffer's destroy event, so walk these listeners rather than the
+ * renderer's textures: a buffer only has a handful of them.
+ */
+static struct wlr_gles2_texture *get_buffer_texture(
+		struct wlr_gles2_renderer *renderer, struct wlr_buffer *buffer) {
+	struct wl_listener *listener;
+	wl_list_for_each(listener, &buffer->events.destroy.listener_list, link) {
+		if (listener->notify != texture_handle_buffer_destroy) {
+			continue;
+		}
+		struct wlr_gles2_texture *texture =
+			wl_container_of(listener, texture, buffer_destroy);
+		if (texture->renderer == renderer) {
+			return texture;
+		}
+	}
+	return NULL;
+}
+
 static struct wlr_texture *gles2_texture_from_dmabuf_buffer(
 		struct wlr_gles2_renderer *renderer, struct wlr_buffer *buffer,
 		struct wlr_dmabuf_attributes *dmabuf) {
-	struct wlr_gles2_texture *texture;
-	wl_list_for_each(texture, &renderer->textures, link) {
-		if (texture->buffer == buffer) {
-			if (!gles2_texture_invalidate(texture)) {
-				wlr_log(WLR_ERROR, "Failed to invalidate texture");
-				return false;
-			}
-			wlr_buffer_lock(texture->buffer);
-			return &texture->wlr_texture;
+	struct wlr_gles2_texture *texture = get_buffer_texture(renderer, buffer);
+	if (texture != NULL) {
+		if (!gles2_texture_invalidate(texture)) {
+			wlr_log(WLR_ERROR, "Failed to invalidate texture");
+			return false;
 		}
+		renderer->wlr_renderer.texture_cache.hits++;
+		wlr_buffer_lock(texture->buffer);
+		return &texture->wlr_texture;
 	}
 
+	renderer->wlr_renderer.texture_cache.misses++;
+
 	struct wlr_texture *wlr_texture =
 		gles2_texture_from_dmabuf(&renderer->wlr_renderer, dmabuf);
 	if (wlr_texture == NULL) {
@@ -406,6 +576,7 @@ struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
 	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
 		return gles2_texture_from_dmabuf_buffer(renderer, buffer, &dmabuf);
 	} else if (buffer_begin_data_ptr_access(buffer, &data, &format, &stride)) {
+		wlr_renderer->texture_cache.misses++;
 		struct wlr_texture *tex = gles2_texture_from_pixels(wlr_renderer,
 			format, stride, buffer->width, buffer->height, data);
 		buffer_end_data_ptr_access(buffer);
@@ -1,7 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <math.h>
 #include <pixman.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <wayland-server.h>
 #include <wlr/render/interface.h>
 #include <wlr/types/wlr_matrix.h>
@@ -47,11 +51,15 @@ static struct wlr_pixman_texture *get_texture(
 
 static bool texture_is_opaque(struct wlr_texture *wlr_texture) {
 	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
-	return texture->format_info->has_alpha;
+	return !texture->format_info->has_alpha;
 }
 
+static void flush_draws(struct wlr_pixman_renderer *renderer);
+
 static void texture_destroy(struct wlr_texture *wlr_texture) {
 	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+	// Deferred draws may still reference the texture data
+	flush_draws(texture->renderer);
 	wl_list_remove(&texture->link);
 	pixman_image_unref(texture->image);
 	wlr_buffer_unlock(texture->buffer);
@@ -161,27 +169,9 @@ static void pixman_end(struct wlr_renderer *wlr_renderer) {
 
 	assert(renderer->current_buffer != NULL);
 
-	buffer_end_data_ptr_access(renderer->current_buffer->buffer);
-}
-
-static void pixman_clear(struct wlr_renderer *wlr_renderer,
-		const float color[static 4]) {
-	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
-	struct wlr_pixman_buffer *buffer = renderer->current_buffer;
-
-	const struct pixman_color colour = {
-		.red = color[0] * 0xFFFF,
-		.green = color[1] * 0xFFFF,
-		.blue = color[2] * 0xFFFF,
-		.alpha = color[3] * 0xFFFF,
-	};
-
-	pixman_image_t *fill = pixman_image_create_solid_fill(&colour);
-
-	pixman_image_composite32(PIXMAN_OP_SRC, fill, NULL, buffer->image, 0, 0, 0,
-			0, 0, 0, renderer->width, renderer->height);
+	flush_draws(renderer);
 
-	pixman_image_unref(fill);
+	buffer_end_data_ptr_access(renderer->current_buffer->buffer);
 }
 
 static void pixman_scissor(struct wlr_renderer *wlr_renderer,
@@ -189,7 +179,10 @@ static void pixman_scissor(struct wlr_renderer *wlr_renderer,
 	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
 	struct wlr_pixman_buffer *buffer = renderer->current_buffer;
 
+	renderer->has_scissor = box != NULL;
 	if (box != NULL) {
+		renderer->scissor = *box;
+
 		struct pixman_region32 region = {0};
 		pixman_region32_init_rect(&region, box->x, box->y, box->width,
 				box->height);
@@ -216,112 +209,421 @@ static void matrix_to_pixman_transform(struct pixman_transform *transform,
 	pixman_transform_from_pixman_f_transform(transform, &ftr);
 }
 
-static bool pixman_render_subtexture_with_matrix(
-		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
-		const struct wlr_fbox *fbox, const float matrix[static 9],
-		float alpha) {
-	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
-	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
-	struct wlr_pixman_buffer *buffer = renderer->current_buffer;
+// Tolerance used to detect pixel-aligned draws
+#define PIXEL_EPSILON 1e-4
 
-	if (texture->buffer != NULL) {
-		void *data;
-		uint32_t drm_format;
-		size_t stride;
-		if (!buffer_begin_data_ptr_access(texture->buffer, &data, &drm_format,
-				&stride)) {
-			return false;
-		}
+static bool is_integer(float v) {
+	return fabs(v - round(v)) < PIXEL_EPSILON;
+}
 
-		// If the data pointer has changed, re-create the Pixman image. This can
-		// happen if it's a client buffer and the wl_shm_pool has been resized.
-		if (data != pixman_image_get_data(texture->image)) {
-			pixman_format_code_t format = get_pixman_format_from_drm(drm_format);
-			assert(format != 0);
+/**
+ * Checks whether the matrix maps pixels one-to-one, with an integer
+ * translation.
+ */
+static bool matrix_is_integer_translation(const float mat[static 9]) {
+	return fabs(mat[0] - 1) < PIXEL_EPSILON && fabs(mat[1]) < PIXEL_EPSILON &&
+		fabs(mat[3]) < PIXEL_EPSILON && fabs(mat[4] - 1) < PIXEL_EPSILON &&
+		is_integer(mat[2]) && is_integer(mat[5]);
+}
+
+/**
+ * Computes the bounding box of the unit square transformed by the matrix, in
+ * render target coordinates. If `exact` is set, the transformed square must be
+ * a pixel-aligned rectangle. Otherwise the box is padded so that it contains
+ * all pixels touched by the square.
+ *
+ * The box is clipped to the render target and the scissor box. Returns false
+ * if the result is empty.
+ */
+static bool get_draw_box(struct wlr_pixman_renderer *renderer,
+		const float mat[static 9], bool exact, struct wlr_box *box) {
+	const float xs[] = { mat[2], mat[0] + mat[2], mat[1] + mat[2],
+		mat[0] + mat[1] + mat[2] };
+	const float ys[] = { mat[5], mat[3] + mat[5], mat[4] + mat[5],
+		mat[3] + mat[4] + mat[5] };
+	float x1 = xs[0], x2 = xs[0], y1 = ys[0], y2 = ys[0];
+	for (size_t i = 1; i < 4; i++) {
+		x1 = fmin(x1, xs[i]);
+		x2 = fmax(x2, xs[i]);
+		y1 = fmin(y1, ys[i]);
+		y2 = fmax(y2, ys[i]);
+	}
+
+	struct wlr_box bounds;
+	if (exact) {
+		bounds.x = round(x1);
+		bounds.y = round(y1);
+		bounds.width = round(x2) - bounds.x;
+		bounds.height = round(y2) - bounds.y;
+	} else {
+		bounds.x = floor(x1) - 1;
+		bounds.y = floor(y1) - 1;
+		bounds.width = ceil(x2) + 1 - bounds.x;
+		bounds.height = ceil(y2) + 1 - bounds.y;
+	}
 
-			pixman_image_unref(texture->image);
-			texture->image = pixman_image_create_bits_no_clear(format,
-				texture->wlr_texture.width, texture->wlr_texture.height,
-				data, stride);
+	struct wlr_box target = {
+		.width = renderer->width,
+		.height = renderer->height,
+	};
+	if (!wlr_box_intersection(box, &bounds, &target)) {
+		return false;
+	}
+	if (renderer->has_scissor &&
+			!wlr_box_intersection(box, box, &renderer->scissor)) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Execute a draw operation on the part of the render target inside `clip`.
+ */
+static void execute_draw(const struct wlr_pixman_draw *draw,
+		pixman_image_t *dst, const struct wlr_box *clip) {
+	struct wlr_box box;
+	if (!wlr_box_intersection(&box, &draw->box, clip)) {
+		return;
+	}
+
+	if (draw->type == WLR_PIXMAN_DRAW_FILL) {
+		pixman_rectangle16_t rect = {
+			.x = box.x,
+			.y = box.y,
+			.width = box.width,
+			.height = box.height,
+		};
+		pixman_image_fill_rectangles(draw->op, dst, &draw->color, 1, &rect);
+		return;
+	}
+
+	pixman_image_t *src = NULL, *mask = NULL;
+	int src_x = draw->src_x + box.x - draw->box.x;
+	int src_y = draw->src_y + box.y - draw->box.y;
+	if (draw->type == WLR_PIXMAN_DRAW_IMAGE) {
+		src = pixman_image_create_bits_no_clear(draw->format, draw->width,
+			draw->height, draw->data, draw->stride);
+		if (draw->mask_alpha != 0xFFFF) {
+			struct pixman_color mask_colour = { .alpha = draw->mask_alpha };
+			mask = pixman_image_create_solid_fill(&mask_colour);
+		}
+	} else {
+		// Rotated rectangle: draw an image covering the rectangle, so that its
+		// edges are antialiased by the transform like textures
+		src = pixman_image_create_bits(PIXMAN_a8r8g8b8, draw->width,
+			draw->height, NULL, 0);
+		if (src != NULL) {
+			pixman_rectangle16_t rect = {
+				.width = draw->width,
+				.height = draw->height,
+			};
+			pixman_image_fill_rectangles(PIXMAN_OP_SRC, src, &draw->color, 1,
+				&rect);
 		}
 	}
+	if (src == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate pixman image");
+		return;
+	}
+	if (draw->has_transform) {
+		pixman_image_set_transform(src, &draw->transform);
+	}
 
-	// TODO: don't create a mask if alpha == 1.0
-	struct pixman_color mask_colour = {0};
-	mask_colour.alpha = 0xFFFF * alpha;
-	pixman_image_t *mask = pixman_image_create_solid_fill(&mask_colour);
+	if (draw->shm_buffer != NULL) {
+		wl_shm_buffer_begin_access(draw->shm_buffer);
+	}
+	pixman_image_composite32(draw->op, src, mask, dst, src_x, src_y, 0, 0,
+		box.x, box.y, box.width, box.height);
+	if (draw->shm_buffer != NULL) {
+		wl_shm_buffer_end_access(draw->shm_buffer);
+	}
 
-	float m[9];
-	memcpy(m, matrix, sizeof(m));
-	wlr_matrix_scale(m, 1.0 / fbox->width, 1.0 / fbox->height);
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+	pixman_image_unref(src);
+}
 
-	struct pixman_transform transform = {0};
-	matrix_to_pixman_transform(&transform, m);
-	pixman_transform_invert(&transform, &transform);
+static void render_tile(void *data, size_t index) {
+	struct wlr_pixman_renderer *renderer = data;
+	pixman_image_t *target = renderer->current_buffer->image;
 
-	pixman_image_set_transform(texture->image, &transform);
+	// Each thread needs its own images: pixman images aren't thread-safe
+	pixman_image_t *dst = pixman_image_create_bits_no_clear(
+		pixman_image_get_format(target), pixman_image_get_width(target),
+		pixman_image_get_height(target), pixman_image_get_data(target),
+		pixman_image_get_stride(target));
+	if (dst == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		return;
+	}
 
-	// TODO clip properly with src_x and src_y
-	pixman_image_composite32(PIXMAN_OP_OVER, texture->image, mask,
-			buffer->image, 0, 0, 0, 0, 0, 0, renderer->width,
-			renderer->height);
+	struct wlr_box clip = {
+		.x = 0,
+		.y = index * renderer->tile_height,
+		.width = renderer->width,
+		.height = renderer->tile_height,
+	};
+	for (size_t i = 0; i < renderer->draws_len; i++) {
+		execute_draw(&renderer->draws[i], dst, &clip);
+	}
 
-	if (texture->buffer != NULL) {
-		buffer_end_data_ptr_access(texture->buffer);
+	pixman_image_unref(dst);
+}
+
+// Number of tiles per rendering thread, to balance the load between threads
+#define TILES_PER_THREAD 4
+// Minimum height of a tile, in pixels
+#define MIN_TILE_HEIGHT 16
+
+/**
+ * Execute the deferred draws, splitting the render target into horizontal
+ * tiles rendered in parallel.
+ */
+static void flush_draws(struct wlr_pixman_renderer *renderer) {
+	if (renderer->draws_len == 0) {
+		return;
+	}
+
+	// Workers can't access the render target safely if it's a client buffer
+	size_t tiles_len = 1;
+	renderer->tile_height = renderer->height;
+	if (buffer_get_wl_shm_buffer(renderer->current_buffer->buffer) == NULL) {
+		size_t max_tiles = (renderer->workers->threads_len + 1) *
+			TILES_PER_THREAD;
+		int tile_height = (renderer->height + max_tiles - 1) / max_tiles;
+		if (tile_height < MIN_TILE_HEIGHT) {
+			tile_height = MIN_TILE_HEIGHT;
+		}
+		renderer->tile_height = tile_height;
+		tiles_len = (renderer->height + tile_height - 1) / tile_height;
 	}
 
-	pixman_image_unref(mask);
+	if (tiles_len > 1) {
+		pixman_worker_pool_run(renderer->workers, render_tile, renderer,
+			tiles_len);
+	} else {
+		render_tile(renderer, 0);
+	}
 
-	return true;
+	// All workers are done with the source buffers
+	for (size_t i = 0; i < renderer->draws_len; i++) {
+		struct wlr_pixman_draw *draw = &renderer->draws[i];
+		if (draw->end_access) {
+			buffer_end_data_ptr_access(draw->buffer);
+		}
+		wlr_buffer_unlock(draw->buffer);
+	}
+	renderer->draws_len = 0;
 }
 
-static void pixman_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
-		const float color[static 4], const float matrix[static 9]) {
+static void submit_draw(struct wlr_pixman_renderer *renderer,
+		const struct wlr_pixman_draw *draw) {
+	struct wlr_box target = {
+		.width = renderer->width,
+		.height = renderer->height,
+	};
+	if (renderer->workers == NULL) {
+		execute_draw(draw, renderer->current_buffer->image, &target);
+		if (draw->end_access) {
+			buffer_end_data_ptr_access(draw->buffer);
+		}
+		return;
+	}
+
+	if (renderer->draws_len == renderer->draws_cap) {
+		size_t cap = renderer->draws_cap == 0 ? 32 : 2 * renderer->draws_cap;
+		struct wlr_pixman_draw *draws =
+			realloc(renderer->draws, cap * sizeof(draws[0]));
+		if (draws == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			// Preserve the draw order
+			flush_draws(renderer);
+			execute_draw(draw, renderer->current_buffer->image, &target);
+			if (draw->end_access) {
+				buffer_end_data_ptr_access(draw->buffer);
+			}
+			return;
+		}
+		renderer->draws = draws;
+		renderer->draws_cap = cap;
+	}
+
+	struct wlr_pixman_draw *dst = &renderer->draws[renderer->draws_len++];
+	*dst = *draw;
+	if (dst->buffer != NULL) {
+		wlr_buffer_lock(dst->buffer);
+	}
+}
+
+static void pixman_clear(struct wlr_renderer *wlr_renderer,
+		const float color[static 4]) {
 	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
-	struct wlr_pixman_buffer *buffer = renderer->current_buffer;
 
-	struct pixman_color colour = {
-		.red = color[0] * 0xFFFF,
-		.green = color[1] * 0xFFFF,
-		.blue = color[2] * 0xFFFF,
-		.alpha = color[3] * 0xFFFF,
+	struct wlr_pixman_draw draw = {
+		.type = WLR_PIXMAN_DRAW_FILL,
+		.op = PIXMAN_OP_SRC,
+		.box = {
+			.width = renderer->width,
+			.height = renderer->height,
+		},
+		.color = {
+			.red = color[0] * 0xFFFF,
+			.green = color[1] * 0xFFFF,
+			.blue = color[2] * 0xFFFF,
+			.alpha = color[3] * 0xFFFF,
+		},
 	};
+	if (renderer->has_scissor &&
+			!wlr_box_intersection(&draw.box, &draw.box, &renderer->scissor)) {
+		return;
+	}
+
+	submit_draw(renderer, &draw);
+}
 
-	pixman_image_t *fill = pixman_image_create_solid_fill(&colour);
+static bool pixman_render_subtexture_with_matrix(
+		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
+		const struct wlr_fbox *fbox, const float matrix[static 9],
+		float alpha) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
 
+	// Maps texture coordinates to render target coordinates
 	float m[9];
 	memcpy(m, matrix, sizeof(m));
+	wlr_matrix_scale(m, 1.0 / fbox->width, 1.0 / fbox->height);
+	wlr_matrix_translate(m, -fbox->x, -fbox->y);
+
+	// Pixel-aligned draws don't need to go through a transform, which allows
+	// pixman to use its fast paths
+	bool translation = matrix_is_integer_translation(m) &&
+		is_integer(fbox->x) && is_integer(fbox->y) &&
+		is_integer(fbox->width) && is_integer(fbox->height);
+
+	struct wlr_pixman_draw draw = {
+		.type = WLR_PIXMAN_DRAW_IMAGE,
+		.op = PIXMAN_OP_OVER,
+		.mask_alpha = alpha < 1.0 ? 0xFFFF * alpha : 0xFFFF,
+	};
+	if (!get_draw_box(renderer, matrix, translation, &draw.box)) {
+		return true;
+	}
 
-	// TODO get the width/height from the caller instead of extracting them
-	float width, height;
-	if (matrix[1] == 0.0 && matrix[3] == 0.0) {
-		width = fabs(matrix[0]);
-		height = fabs(matrix[4]);
+	if (texture->buffer != NULL) {
+		// The access lasts until the draw has been executed. If an earlier
+		// deferred draw of this frame already holds it, the image is
+		// up-to-date.
+		if (!texture->buffer->accessing_data_ptr) {
+			void *data;
+			uint32_t drm_format;
+			size_t stride;
+			if (!buffer_begin_data_ptr_access(texture->buffer, &data,
+					&drm_format, &stride)) {
+				return false;
+			}
+			draw.end_access = true;
+
+			// If the data pointer has changed, re-create the Pixman image.
+			// This can happen if it's a client buffer and the wl_shm_pool
+			// has been resized.
+			if (data != pixman_image_get_data(texture->image)) {
+				pixman_format_code_t format =
+					get_pixman_format_from_drm(drm_format);
+				assert(format != 0);
+
+				pixman_image_unref(texture->image);
+				texture->image = pixman_image_create_bits_no_clear(format,
+					texture->wlr_texture.width, texture->wlr_texture.height,
+					data, stride);
+			}
+		}
+
+		draw.buffer = texture->buffer;
+		draw.shm_buffer = buffer_get_wl_shm_buffer(texture->buffer);
+	}
+
+	draw.format = pixman_image_get_format(texture->image);
+	draw.data = pixman_image_get_data(texture->image);
+	draw.stride = pixman_image_get_stride(texture->image);
+	draw.width = texture->wlr_texture.width;
+	draw.height = texture->wlr_texture.height;
+
+	draw.src_x = draw.box.x;
+	draw.src_y = draw.box.y;
+	if (translation) {
+		draw.src_x -= round(m[2]);
+		draw.src_y -= round(m[5]);
+
+		// The draw box is fully covered by the texture
+		if (draw.mask_alpha == 0xFFFF && !texture->format_info->has_alpha) {
+			draw.op = PIXMAN_OP_SRC;
+		}
 	} else {
-		width = sqrt(matrix[0] * matrix[0] + matrix[1] * matrix[1]);
-		height = sqrt(matrix[3] * matrix[3] + matrix[4] * matrix[4]);
+		draw.has_transform = true;
+		matrix_to_pixman_transform(&draw.transform, m);
+		pixman_transform_invert(&draw.transform, &draw.transform);
 	}
 
-	wlr_matrix_scale(m, 1.0 / width, 1.0 / height);
+	submit_draw(renderer, &draw);
+	return true;
+}
 
-	pixman_image_t *image = pixman_image_create_bits(PIXMAN_a8r8g8b8, width,
-			height, NULL, 0);
+static void pixman_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
+		const float color[static 4], const float matrix[static 9]) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
 
-	// TODO find a way to fill the image without allocating 2 images
-	pixman_image_composite32(PIXMAN_OP_SRC, fill, NULL, image,
-		0, 0, 0, 0, 0, 0, width, height);
-	pixman_image_unref(fill);
+	struct wlr_pixman_draw draw = {
+		.type = WLR_PIXMAN_DRAW_FILL,
+		.op = color[3] == 1.0 ? PIXMAN_OP_SRC : PIXMAN_OP_OVER,
+		.color = {
+			.red = color[0] * 0xFFFF,
+			.green = color[1] * 0xFFFF,
+			.blue = color[2] * 0xFFFF,
+			.alpha = color[3] * 0xFFFF,
+		},
+	};
 
-	struct pixman_transform transform = {0};
-	matrix_to_pixman_transform(&transform, m);
-	pixman_transform_invert(&transform, &transform);
+	if (matrix[1] == 0.0 && matrix[3] == 0.0) {
+		// Axis-aligned rectangle: fill the pixels whose center is covered
+		float x1 = fmin(matrix[2], matrix[0] + matrix[2]);
+		float x2 = fmax(matrix[2], matrix[0] + matrix[2]);
+		float y1 = fmin(matrix[5], matrix[4] + matrix[5]);
+		float y2 = fmax(matrix[5], matrix[4] + matrix[5]);
+		const float rect[9] = {
+			round(x2) - round(x1), 0, round(x1),
+			0, round(y2) - round(y1), round(y1),
+			0, 0, 1,
+		};
+
+		if (get_draw_box(renderer, rect, true, &draw.box)) {
+			submit_draw(renderer, &draw);
+		}
+		return;
+	}
 
-	pixman_image_set_transform(image, &transform);
+	if (!get_draw_box(renderer, matrix, false, &draw.box)) {
+		return;
+	}
 
-	pixman_image_composite32(PIXMAN_OP_OVER, image, NULL, buffer->image,
-			0, 0, 0, 0, 0, 0, renderer->width, renderer->height);
+	float width = sqrt(matrix[0] * matrix[0] + matrix[1] * matrix[1]);
+	float height = sqrt(matrix[3] * matrix[3] + matrix[4] * matrix[4]);
 
-	pixman_image_unref(image);
+	float m[9];
+	memcpy(m, matrix, sizeof(m));
+	wlr_matrix_scale(m, 1.0 / width, 1.0 / height);
+
+	draw.type = WLR_PIXMAN_DRAW_QUAD;
+	draw.op = PIXMAN_OP_OVER;
+	draw.width = width;
+	draw.height = height;
+	draw.src_x = draw.box.x;
+	draw.src_y = draw.box.y;
+	draw.has_transform = true;
+	matrix_to_pixman_transform(&draw.transform, m);
+	pixman_transform_invert(&draw.transform, &draw.transform);
+
+	submit_draw(renderer, &draw);
 }
 
 static const uint32_t *pixman_get_shm_texture_formats(
@@ -414,6 +716,9 @@ static struct wlr_texture *pixman_texture_from_buffer(
 	}
 	buffer_end_data_ptr_access(buffer);
 
+	// Textures only wrap the buffer data, there is nothing worth caching
+	wlr_renderer->texture_cache.misses++;
+
 	struct wlr_pixman_texture *texture = pixman_texture_create(renderer,
 		drm_format, buffer->width, buffer->height);
 	if (texture == NULL) {
@@ -476,6 +781,8 @@ static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
 
 	wlr_drm_format_set_finish(&renderer->drm_formats);
 
+	pixman_worker_pool_destroy(renderer->workers);
+	free(renderer->draws);
 	free(renderer);
 }
 
@@ -497,6 +804,8 @@ static bool pixman_read_pixels(struct wlr_renderer *wlr_renderer,
 	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
 	struct wlr_pixman_buffer *buffer = renderer->current_buffer;
 
+	flush_draws(renderer);
+
 	pixman_format_code_t fmt = get_pixman_format_from_drm(drm_format);
 	if (fmt == 0) {
 		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
@@ -560,6 +869,26 @@ struct wlr_renderer *wlr_pixman_renderer_create(void) {
 				DRM_FORMAT_MOD_LINEAR);
 	}
 
+	const char *threads_str = getenv("WLR_PIXMAN_THREADS");
+	if (threads_str != NULL) {
+		char *end;
+		long threads = strtol(threads_str, &end, 10);
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		if (*end != '\0' || threads < 0) {
+			wlr_log(WLR_ERROR, "Invalid WLR_PIXMAN_THREADS value: %s",
+				threads_str);
+		} else if (cpus > 0 && threads > cpus) {
+			wlr_log(WLR_INFO, "WLR_PIXMAN_THREADS is larger than the number "
+				"of online CPUs, using %ld threads", cpus);
+			threads = cpus;
+		}
+		if (*end == '\0' && threads > 1) {
+			wlr_log(WLR_INFO, "Rendering with %ld threads", threads);
+			// The compositor thread renders too
+			renderer->workers = pixman_worker_pool_create(threads - 1);
+		}
+	}
+
 	return &renderer->wlr_renderer;
 }
 
@@ -572,5 +901,6 @@ pixman_image_t *wlr_pixman_renderer_get_current_image(
 		struct wlr_renderer *wlr_renderer) {
 	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
 	assert(renderer->current_buffer);
+	flush_draws(renderer);
 	return renderer->current_buffer->image;
 }
@@ -0,0 +1,115 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+static void *worker_run(void *data) {
+	struct wlr_pixman_worker_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (true) {
+		while (!pool->stop && pool->next >= pool->count) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		}
+		if (pool->stop) {
+			break;
+		}
+
+		size_t index = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+		pool->func(pool->data, index);
+		pthread_mutex_lock(&pool->mutex);
+
+		pool->done++;
+		if (pool->done == pool->count) {
+			pthread_cond_signal(&pool->done_cond);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+struct wlr_pixman_worker_pool *pixman_worker_pool_create(size_t threads_len) {
+	struct wlr_pixman_worker_pool *pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	pool->threads = calloc(threads_len, sizeof(pool->threads[0]));
+	if (pool->threads == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	for (size_t i = 0; i < threads_len; i++) {
+		int ret = pthread_create(&pool->threads[i], NULL, worker_run, pool);
+		if (ret != 0) {
+			wlr_log(WLR_ERROR, "Failed to create worker thread: %s",
+				strerror(ret));
+			pixman_worker_pool_destroy(pool);
+			return NULL;
+		}
+		pool->threads_len++;
+	}
+
+	return pool;
+}
+
+void pixman_worker_pool_destroy(struct wlr_pixman_worker_pool *pool) {
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < pool->threads_len; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+void pixman_worker_pool_run(struct wlr_pixman_worker_pool *pool,
+		void (*func)(void *data, size_t index), void *data, size_t count) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->func = func;
+	pool->data = data;
+	pool->next = 0;
+	pool->done = 0;
+	pool->count = count;
+	pthread_cond_broadcast(&pool->work_cond);
+
+	// The calling thread processes tasks too
+	while (pool->next < pool->count) {
+		size_t index = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+		func(data, index);
+		pthread_mutex_lock(&pool->mutex);
+		pool->done++;
+	}
+
+	while (pool->done < pool->count) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+
+	pool->func = NULL;
+	pool->data = NULL;
+	pool->next = pool->count = pool->done = 0;
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -60,6 +60,7 @@ bool renderer_bind_buffer(struct wlr_renderer *r, struct wlr_buffer *buffer) {
 void wlr_renderer_begin(struct wlr_renderer *r, uint32_t width, uint32_t height) {
 	assert(!r->rendering);
 
+	r->render_seq++;
 	r->impl->begin(r, width, height);
 
 	r->rendering = true;
@@ -136,6 +137,33 @@ bool wlr_render_subtexture_with_matrix(struct wlr_renderer *r,
 		box, matrix, alpha);
 }
 
+bool wlr_render_texture_batch(struct wlr_renderer *r,
+		const struct wlr_render_texture_item *items, size_t items_len) {
+	assert(r->rendering);
+	if (r->impl->render_texture_batch) {
+		return r->impl->render_texture_batch(r, items, items_len);
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < items_len; i++) {
+		const struct wlr_render_texture_item *item = &items[i];
+		if (item->clip_rects_len == 0) {
+			r->impl->scissor(r, NULL);
+			ok = r->impl->render_subtexture_with_matrix(r, item->texture,
+				&item->src_box, item->matrix, item->alpha) && ok;
+			continue;
+		}
+		for (size_t j = 0; j < item->clip_rects_len; j++) {
+			struct wlr_box box = item->clip_rects[j];
+			r->impl->scissor(r, &box);
+			ok = r->impl->render_subtexture_with_matrix(r, item->texture,
+				&item->src_box, item->matrix, item->alpha) && ok;
+		}
+	}
+	r->impl->scissor(r, NULL);
+	return ok;
+}
+
 void wlr_render_rect(struct wlr_renderer *r, const struct wlr_box *box,
 		const float color[static 4], const float projection[static 9]) {
 	if (box->width == 0 || box->height == 0) {
@@ -207,6 +235,59 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, uint32_t fmt,
 		src_x, src_y, dst_x, dst_y, data);
 }
 
+struct wlr_readback *wlr_renderer_read_pixels_async(struct wlr_renderer *r,
+		uint32_t fmt, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y) {
+	if (!r->impl->read_pixels_async) {
+		return NULL;
+	}
+	return r->impl->read_pixels_async(r, fmt, width, height, src_x, src_y);
+}
+
+void wlr_readback_init(struct wlr_readback *readback,
+		const struct wlr_readback_impl *impl, uint32_t format,
+		uint32_t width, uint32_t height) {
+	assert(impl->finish && impl->destroy);
+	readback->impl = impl;
+	readback->format = format;
+	readback->width = width;
+	readback->height = height;
+}
+
+bool wlr_readback_is_ready(struct wlr_readback *readback) {
+	if (!readback->impl->is_ready) {
+		return true;
+	}
+	return readback->impl->is_ready(readback);
+}
+
+int wlr_readback_get_fence_fd(struct wlr_readback *readback) {
+	if (!readback->impl->get_fence_fd) {
+		return -1;
+	}
+	return readback->impl->get_fence_fd(readback);
+}
+
+bool wlr_readback_finish(struct wlr_readback *readback, uint32_t *flags,
+		uint32_t stride, uint32_t dst_x, uint32_t dst_y, void *data) {
+	return readback->impl->finish(readback, flags, stride, dst_x, dst_y, data);
+}
+
+void wlr_readback_destroy(struct wlr_readback *readback) {
+	if (readback == NULL) {
+		return;
+	}
+	readback->impl->destroy(readback);
+}
+
+bool wlr_renderer_get_render_time(struct wlr_renderer *r, uint64_t render_seq,
+		uint64_t *ns) {
+	if (!r->impl->get_render_time) {
+		return false;
+	}
+	return r->impl->get_render_time(r, render_seq, ns);
+}
+
 bool wlr_renderer_init_wl_display(struct wlr_renderer *r,
 		struct wl_display *wl_display) {
 	if (wl_display_init_shm(wl_display)) {
@@ -73,3 +73,63 @@ bool wlr_texture_write_pixels(struct wlr_texture *texture,
 	return texture->impl->write_pixels(texture, stride, width, height,
 		src_x, src_y, dst_x, dst_y, data);
 }
+
+// Maximum number of rectangles uploaded separately
+#define WRITE_REGION_MAX_RECTS 16
+// Upload the region extents instead of the rectangles if they're no larger
+// than this many times the region area
+#define WRITE_REGION_EXTENTS_RATIO 2
+
+bool wlr_texture_write_pixels_region(struct wlr_texture *texture,
+		uint32_t stride, const pixman_region32_t *region, const void *data) {
+	if (!texture->impl->write_pixels) {
+		return false;
+	}
+
+	pixman_region32_t clipped;
+	pixman_region32_init(&clipped);
+	pixman_region32_intersect_rect(&clipped,
+		(pixman_region32_t *)region, 0, 0, texture->width, texture->height);
+	if (!pixman_region32_not_empty(&clipped)) {
+		pixman_region32_fini(&clipped);
+		return true;
+	}
+
+	int rects_len;
+	const pixman_box32_t *rects =
+		pixman_region32_rectangles(&clipped, &rects_len);
+
+	// Each upload has a fixed cost: merge fragmented damage into its
+	// extents, unless that uploads a lot of undamaged pixels
+	const pixman_box32_t *extents = pixman_region32_extents(&clipped);
+	if (rects_len > 1) {
+		uint64_t area = 0;
+		for (int i = 0; i < rects_len; i++) {
+			area += (uint64_t)(rects[i].x2 - rects[i].x1) *
+				(rects[i].y2 - rects[i].y1);
+		}
+		uint64_t extents_area = (uint64_t)(extents->x2 - extents->x1) *
+			(extents->y2 - extents->y1);
+		if (rects_len > WRITE_REGION_MAX_RECTS ||
+				extents_area <= WRITE_REGION_EXTENTS_RATIO * area) {
+			rects = extents;
+			rects_len = 1;
+		}
+	}
+
+	bool ok = true;
+	if (texture->impl->write_pixels_region) {
+		ok = texture->impl->write_pixels_region(texture, stride,
+			rects_len, rects, data);
+	} else {
+		for (int i = 0; i < rects_len && ok; i++) {
+			const pixman_box32_t *r = &rects[i];
+			ok = texture->impl->write_pixels(texture, stride,
+				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1, r->x1, r->y1,
+				data);
+		}
+	}
+
+	pixman_region32_fini(&clipped);
+	return ok;
+}
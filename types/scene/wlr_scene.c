@@ -0,0 +1,1163 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/backend.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "render/wlr_texture.h"
+#include "util/signal.h"
+
+static struct wlr_scene *scene_root_from_node(struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_ROOT);
+	return (struct wlr_scene *)node;
+}
+
+static struct wlr_scene_tree *scene_tree_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_TREE);
+	return (struct wlr_scene_tree *)node;
+}
+
+struct wlr_scene_surface *wlr_scene_surface_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_SURFACE);
+	return (struct wlr_scene_surface *)node;
+}
+
+static struct wlr_scene_rect *scene_rect_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_RECT);
+	return (struct wlr_scene_rect *)node;
+}
+
+static struct wlr_scene_buffer *scene_buffer_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_BUFFER);
+	return (struct wlr_scene_buffer *)node;
+}
+
+static struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node) {
+	while (node->parent != NULL) {
+		node = node->parent;
+	}
+	return scene_root_from_node(node);
+}
+
+static void scene_node_state_init(struct wlr_scene_node_state *state) {
+	wl_list_init(&state->children);
+	wl_list_init(&state->link);
+	state->enabled = true;
+}
+
+static void scene_node_state_finish(struct wlr_scene_node_state *state) {
+	wl_list_remove(&state->link);
+}
+
+static void scene_node_init(struct wlr_scene_node *node,
+		enum wlr_scene_node_type type, struct wlr_scene_node *parent) {
+	assert(type == WLR_SCENE_NODE_ROOT || parent != NULL);
+
+	memset(node, 0, sizeof(*node));
+	node->type = type;
+	node->parent = parent;
+	scene_node_state_init(&node->state);
+	wl_signal_init(&node->events.destroy);
+
+	if (parent != NULL) {
+		wl_list_insert(parent->state.children.prev, &node->state.link);
+	}
+}
+
+static void scene_node_damage_whole(struct wlr_scene_node *node);
+
+static void scene_node_finish(struct wlr_scene_node *node) {
+	wlr_signal_emit_safe(&node->events.destroy, NULL);
+
+	struct wlr_scene_node *child, *child_tmp;
+	wl_list_for_each_safe(child, child_tmp,
+			&node->state.children, state.link) {
+		scene_node_finish(child);
+	}
+
+	scene_node_state_finish(&node->state);
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:;
+		struct wlr_scene *scene = scene_root_from_node(node);
+		struct wlr_scene_output *scene_output, *scene_output_tmp;
+		wl_list_for_each_safe(scene_output, scene_output_tmp,
+				&scene->outputs, link) {
+			wlr_scene_output_destroy(scene_output);
+		}
+		free(scene);
+		break;
+	case WLR_SCENE_NODE_TREE:;
+		struct wlr_scene_tree *tree = scene_tree_from_node(node);
+		free(tree);
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		wl_list_remove(&scene_surface->surface_commit.link);
+		wl_list_remove(&scene_surface->surface_destroy.link);
+		free(scene_surface);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = scene_rect_from_node(node);
+		free(scene_rect);
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *scene_buffer = scene_buffer_from_node(node);
+		wlr_texture_destroy(scene_buffer->texture);
+		wlr_buffer_unlock(scene_buffer->buffer);
+		pixman_region32_fini(&scene_buffer->opaque_region);
+		free(scene_buffer);
+		break;
+	}
+}
+
+void wlr_scene_node_destroy(struct wlr_scene_node *node) {
+	if (node == NULL) {
+		return;
+	}
+
+	// The whole sub-tree is damaged at once, children don't need to damage
+	// themselves while being destroyed
+	scene_node_damage_whole(node);
+	scene_node_finish(node);
+}
+
+struct wlr_scene *wlr_scene_create(void) {
+	struct wlr_scene *scene = calloc(1, sizeof(struct wlr_scene));
+	if (scene == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene->node, WLR_SCENE_NODE_ROOT, NULL);
+	wl_list_init(&scene->outputs);
+	return scene;
+}
+
+struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_node *parent) {
+	struct wlr_scene_tree *tree = calloc(1, sizeof(struct wlr_scene_tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+	scene_node_init(&tree->node, WLR_SCENE_NODE_TREE, parent);
+	return tree;
+}
+
+static void scene_surface_handle_surface_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wl_container_of(listener, scene_surface, surface_destroy);
+	wlr_scene_node_destroy(&scene_surface->node);
+}
+
+static void scene_surface_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wl_container_of(listener, scene_surface, surface_commit);
+	struct wlr_surface *surface = scene_surface->surface;
+
+	struct wlr_scene *scene = scene_node_get_root(&scene_surface->node);
+	int lx, ly;
+	if (!wlr_scene_node_coords(&scene_surface->node, &lx, &ly) ||
+			wl_list_empty(&scene->outputs)) {
+		return;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_surface_get_effective_damage(surface, &damage);
+
+	pixman_region32_t output_damage;
+	pixman_region32_init(&output_damage);
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		pixman_region32_copy(&output_damage, &damage);
+		pixman_region32_translate(&output_damage,
+			lx - scene_output->x, ly - scene_output->y);
+		wlr_region_scale(&output_damage, &output_damage,
+			scene_output->output->scale);
+		wlr_output_damage_add(scene_output->damage, &output_damage);
+	}
+	pixman_region32_fini(&output_damage);
+
+	pixman_region32_fini(&damage);
+}
+
+struct wlr_scene_surface *wlr_scene_surface_create(struct wlr_scene_node *parent,
+		struct wlr_surface *surface) {
+	struct wlr_scene_surface *scene_surface =
+		calloc(1, sizeof(struct wlr_scene_surface));
+	if (scene_surface == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_surface->node, WLR_SCENE_NODE_SURFACE, parent);
+
+	scene_surface->surface = surface;
+
+	scene_surface->surface_destroy.notify = scene_surface_handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &scene_surface->surface_destroy);
+
+	scene_surface->surface_commit.notify = scene_surface_handle_surface_commit;
+	wl_signal_add(&surface->events.commit, &scene_surface->surface_commit);
+
+	scene_node_damage_whole(&scene_surface->node);
+
+	return scene_surface;
+}
+
+struct wlr_scene_rect *wlr_scene_rect_create(struct wlr_scene_node *parent,
+		int width, int height, const float color[static 4]) {
+	struct wlr_scene_rect *scene_rect =
+		calloc(1, sizeof(struct wlr_scene_rect));
+	if (scene_rect == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_rect->node, WLR_SCENE_NODE_RECT, parent);
+
+	scene_rect->width = width;
+	scene_rect->height = height;
+	memcpy(scene_rect->color, color, sizeof(scene_rect->color));
+
+	scene_node_damage_whole(&scene_rect->node);
+
+	return scene_rect;
+}
+
+void wlr_scene_rect_set_size(struct wlr_scene_rect *rect, int width, int height) {
+	if (rect->width == width && rect->height == height) {
+		return;
+	}
+
+	scene_node_damage_whole(&rect->node);
+	rect->width = width;
+	rect->height = height;
+	scene_node_damage_whole(&rect->node);
+}
+
+void wlr_scene_rect_set_color(struct wlr_scene_rect *rect,
+		const float color[static 4]) {
+	if (memcmp(rect->color, color, sizeof(rect->color)) == 0) {
+		return;
+	}
+
+	memcpy(rect->color, color, sizeof(rect->color));
+	scene_node_damage_whole(&rect->node);
+}
+
+struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_node *parent,
+		struct wlr_buffer *buffer) {
+	struct wlr_scene_buffer *scene_buffer =
+		calloc(1, sizeof(struct wlr_scene_buffer));
+	if (scene_buffer == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_buffer->node, WLR_SCENE_NODE_BUFFER, parent);
+
+	scene_buffer->buffer = wlr_buffer_lock(buffer);
+	pixman_region32_init(&scene_buffer->opaque_region);
+
+	scene_node_damage_whole(&scene_buffer->node);
+
+	return scene_buffer;
+}
+
+void wlr_scene_buffer_set_source_box(struct wlr_scene_buffer *scene_buffer,
+		const struct wlr_fbox *box) {
+	struct wlr_fbox *cur = &scene_buffer->src_box;
+	if ((box == NULL && cur->width <= 0 && cur->height <= 0) ||
+			(box != NULL && memcmp(cur, box, sizeof(*box)) == 0)) {
+		return;
+	}
+
+	if (box != NULL) {
+		memcpy(cur, box, sizeof(*box));
+	} else {
+		memset(cur, 0, sizeof(*cur));
+	}
+
+	scene_node_damage_whole(&scene_buffer->node);
+}
+
+void wlr_scene_buffer_set_dest_size(struct wlr_scene_buffer *scene_buffer,
+		int width, int height) {
+	if (scene_buffer->dst_width == width && scene_buffer->dst_height == height) {
+		return;
+	}
+
+	scene_node_damage_whole(&scene_buffer->node);
+	scene_buffer->dst_width = width;
+	scene_buffer->dst_height = height;
+	scene_node_damage_whole(&scene_buffer->node);
+}
+
+void wlr_scene_buffer_set_transform(struct wlr_scene_buffer *scene_buffer,
+		enum wl_output_transform transform) {
+	if (scene_buffer->transform == transform) {
+		return;
+	}
+
+	scene_node_damage_whole(&scene_buffer->node);
+	scene_buffer->transform = transform;
+	scene_node_damage_whole(&scene_buffer->node);
+}
+
+void wlr_scene_buffer_set_opaque_region(struct wlr_scene_buffer *scene_buffer,
+		pixman_region32_t *region) {
+	if (pixman_region32_equal(&scene_buffer->opaque_region, region)) {
+		return;
+	}
+	pixman_region32_copy(&scene_buffer->opaque_region, region);
+	// Nodes below may have been culled under the old opaque region
+	scene_node_damage_whole(&scene_buffer->node);
+}
+
+static struct wlr_texture *scene_buffer_get_texture(
+		struct wlr_scene_buffer *scene_buffer, struct wlr_renderer *renderer) {
+	if (scene_buffer->texture == NULL) {
+		scene_buffer->texture =
+			wlr_texture_from_buffer(renderer, scene_buffer->buffer);
+	}
+	return scene_buffer->texture;
+}
+
+static void scene_node_get_size(struct wlr_scene_node *node,
+		int *width, int *height) {
+	*width = 0;
+	*height = 0;
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		return;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		*width = scene_surface->surface->current.width;
+		*height = scene_surface->surface->current.height;
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = scene_rect_from_node(node);
+		*width = scene_rect->width;
+		*height = scene_rect->height;
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *scene_buffer = scene_buffer_from_node(node);
+		if (scene_buffer->dst_width > 0 && scene_buffer->dst_height > 0) {
+			*width = scene_buffer->dst_width;
+			*height = scene_buffer->dst_height;
+		} else if (scene_buffer->transform & WL_OUTPUT_TRANSFORM_90) {
+			*height = scene_buffer->buffer->width;
+			*width = scene_buffer->buffer->height;
+		} else {
+			*width = scene_buffer->buffer->width;
+			*height = scene_buffer->buffer->height;
+		}
+		break;
+	}
+}
+
+static int scale_length(int length, int offset, float scale) {
+	return round((offset + length) * scale) - round(offset * scale);
+}
+
+static void scale_box(struct wlr_box *box, float scale) {
+	box->width = scale_length(box->width, box->x, scale);
+	box->height = scale_length(box->height, box->y, scale);
+	box->x = round(box->x * scale);
+	box->y = round(box->y * scale);
+}
+
+static void _scene_node_damage_whole(struct wlr_scene_node *node,
+		struct wlr_scene *scene, int lx, int ly) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		_scene_node_damage_whole(child, scene,
+			lx + child->state.x, ly + child->state.y);
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		struct wlr_box box = {
+			.x = lx - scene_output->x,
+			.y = ly - scene_output->y,
+			.width = width,
+			.height = height,
+		};
+
+		scale_box(&box, scene_output->output->scale);
+
+		wlr_output_damage_add_box(scene_output->damage, &box);
+	}
+}
+
+static void scene_node_damage_whole(struct wlr_scene_node *node) {
+	struct wlr_scene *scene = scene_node_get_root(node);
+	if (wl_list_empty(&scene->outputs)) {
+		return;
+	}
+
+	int lx, ly;
+	if (!wlr_scene_node_coords(node, &lx, &ly)) {
+		return;
+	}
+
+	_scene_node_damage_whole(node, scene, lx, ly);
+}
+
+void wlr_scene_node_set_enabled(struct wlr_scene_node *node, bool enabled) {
+	if (node->state.enabled == enabled) {
+		return;
+	}
+
+	// One of these damage_whole() calls will short-circuit and be a no-op
+	scene_node_damage_whole(node);
+	node->state.enabled = enabled;
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_set_position(struct wlr_scene_node *node, int x, int y) {
+	if (node->state.x == x && node->state.y == y) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	node->state.x = x;
+	node->state.y = y;
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_place_above(struct wlr_scene_node *node,
+		struct wlr_scene_node *sibling) {
+	assert(node != sibling);
+	assert(node->parent == sibling->parent);
+
+	if (node->state.link.prev == &sibling->state.link) {
+		return;
+	}
+
+	wl_list_remove(&node->state.link);
+	wl_list_insert(&sibling->state.link, &node->state.link);
+
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_place_below(struct wlr_scene_node *node,
+		struct wlr_scene_node *sibling) {
+	assert(node != sibling);
+	assert(node->parent == sibling->parent);
+
+	if (node->state.link.next == &sibling->state.link) {
+		return;
+	}
+
+	wl_list_remove(&node->state.link);
+	wl_list_insert(sibling->state.link.prev, &node->state.link);
+
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_raise_to_top(struct wlr_scene_node *node) {
+	struct wlr_scene_node *current_top = wl_container_of(
+		node->parent->state.children.prev, current_top, state.link);
+	if (node == current_top) {
+		return;
+	}
+	wlr_scene_node_place_above(node, current_top);
+}
+
+void wlr_scene_node_lower_to_bottom(struct wlr_scene_node *node) {
+	struct wlr_scene_node *current_bottom = wl_container_of(
+		node->parent->state.children.next, current_bottom, state.link);
+	if (node == current_bottom) {
+		return;
+	}
+	wlr_scene_node_place_below(node, current_bottom);
+}
+
+void wlr_scene_node_reparent(struct wlr_scene_node *node,
+		struct wlr_scene_node *new_parent) {
+	assert(node->type != WLR_SCENE_NODE_ROOT && new_parent != NULL);
+
+	if (node->parent == new_parent) {
+		return;
+	}
+
+	/* Ensure that a node cannot become its own ancestor */
+	for (struct wlr_scene_node *ancestor = new_parent; ancestor != NULL;
+			ancestor = ancestor->parent) {
+		assert(ancestor != node);
+	}
+
+	scene_node_damage_whole(node);
+
+	wl_list_remove(&node->state.link);
+	node->parent = new_parent;
+	wl_list_insert(new_parent->state.children.prev, &node->state.link);
+
+	scene_node_damage_whole(node);
+}
+
+bool wlr_scene_node_coords(struct wlr_scene_node *node,
+		int *lx_ptr, int *ly_ptr) {
+	int lx = 0, ly = 0;
+	bool enabled = true;
+	while (node != NULL) {
+		lx += node->state.x;
+		ly += node->state.y;
+		enabled = enabled && node->state.enabled;
+		node = node->parent;
+	}
+
+	*lx_ptr = lx;
+	*ly_ptr = ly;
+	return enabled;
+}
+
+static void scene_node_for_each_surface(struct wlr_scene_node *node,
+		int lx, int ly, wlr_surface_iterator_func_t user_iterator,
+		void *user_data) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	if (node->type == WLR_SCENE_NODE_SURFACE) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		user_iterator(scene_surface->surface, lx, ly, user_data);
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_node_for_each_surface(child, lx, ly, user_iterator, user_data);
+	}
+}
+
+void wlr_scene_node_for_each_surface(struct wlr_scene_node *node,
+		wlr_surface_iterator_func_t user_iterator, void *user_data) {
+	int lx = 0, ly = 0;
+	if (node->parent != NULL) {
+		wlr_scene_node_coords(node->parent, &lx, &ly);
+	}
+	scene_node_for_each_surface(node, lx, ly, user_iterator, user_data);
+}
+
+static struct wlr_scene_node *scene_node_at(struct wlr_scene_node *node,
+		double lx, double ly, double *nx, double *ny) {
+	if (!node->state.enabled) {
+		return NULL;
+	}
+
+	// TODO: optimize by storing a bounding box in each node?
+	lx -= node->state.x;
+	ly -= node->state.y;
+
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &node->state.children, state.link) {
+		struct wlr_scene_node *found =
+			scene_node_at(child, lx, ly, nx, ny);
+		if (found != NULL) {
+			return found;
+		}
+	}
+
+	bool intersects = false;
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		intersects =
+			wlr_surface_point_accepts_input(scene_surface->surface, lx, ly);
+		break;
+	case WLR_SCENE_NODE_RECT:
+	case WLR_SCENE_NODE_BUFFER:;
+		int width, height;
+		scene_node_get_size(node, &width, &height);
+		intersects = lx >= 0 && lx < width && ly >= 0 && ly < height;
+		break;
+	}
+
+	if (!intersects) {
+		return NULL;
+	}
+
+	if (nx != NULL) {
+		*nx = lx;
+	}
+	if (ny != NULL) {
+		*ny = ly;
+	}
+	return node;
+}
+
+struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
+		double lx, double ly, double *nx, double *ny) {
+	if (node->parent != NULL) {
+		int parent_lx, parent_ly;
+		wlr_scene_node_coords(node->parent, &parent_lx, &parent_ly);
+		lx -= parent_lx;
+		ly -= parent_ly;
+	}
+	return scene_node_at(node, lx, ly, nx, ny);
+}
+
+/**
+ * A node which needs to be painted on an output during the current frame.
+ */
+struct render_entry {
+	struct wlr_scene_node *node;
+	int x, y; // output-local coordinates, before scaling
+	struct wlr_box box; // output-local coordinates, after scaling
+	pixman_region32_t visible; // part of the damage not occluded
+};
+
+struct render_list {
+	struct wlr_output *output;
+	struct wlr_renderer *renderer;
+	pixman_region32_t *damage;
+
+	struct wl_array entries; // struct render_entry
+	// Damaged region not covered by any opaque node
+	pixman_region32_t background;
+};
+
+static void output_rect_to_buffer_box(struct wlr_output *output,
+		const pixman_box32_t *rect, struct wlr_box *box) {
+	*box = (struct wlr_box){
+		.x = rect->x1,
+		.y = rect->y1,
+		.width = rect->x2 - rect->x1,
+		.height = rect->y2 - rect->y1,
+	};
+
+	int ow, oh;
+	wlr_output_transformed_resolution(output, &ow, &oh);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_box_transform(box, box, transform, ow, oh);
+}
+
+static void scissor_output(struct wlr_output *output,
+		struct wlr_renderer *renderer, pixman_box32_t *rect) {
+	struct wlr_box box;
+	output_rect_to_buffer_box(output, rect, &box);
+	wlr_renderer_scissor(renderer, &box);
+}
+
+/**
+ * Scale a node-local opaque region to output-local coordinates. Partially
+ * covered pixels are excluded, so that the resulting region never contains
+ * translucent content.
+ */
+static void scene_opaque_region_scale(pixman_region32_t *dst,
+		pixman_region32_t *src, int x, int y, float scale) {
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(src, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		int x1 = ceil((x + rects[i].x1) * scale);
+		int y1 = ceil((y + rects[i].y1) * scale);
+		int x2 = floor((x + rects[i].x2) * scale);
+		int y2 = floor((y + rects[i].y2) * scale);
+		if (x2 > x1 && y2 > y1) {
+			pixman_region32_union_rect(dst, dst, x1, y1, x2 - x1, y2 - y1);
+		}
+	}
+}
+
+static void scene_node_get_opaque_region(struct wlr_scene_node *node,
+		struct render_entry *entry, float scale, pixman_region32_t *opaque) {
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		scene_opaque_region_scale(opaque,
+			&scene_surface->surface->opaque_region, entry->x, entry->y, scale);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = scene_rect_from_node(node);
+		if (scene_rect->color[3] >= 1.0) {
+			pixman_region32_union_rect(opaque, opaque, entry->box.x,
+				entry->box.y, entry->box.width, entry->box.height);
+		}
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *scene_buffer = scene_buffer_from_node(node);
+		scene_opaque_region_scale(opaque,
+			&scene_buffer->opaque_region, entry->x, entry->y, scale);
+		break;
+	}
+}
+
+static void render_list_add_node(struct render_list *list,
+		struct wlr_scene_node *node, int x, int y) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	x += node->state.x;
+	y += node->state.y;
+
+	bool paintable = false;
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		paintable = wlr_surface_get_texture(scene_surface->surface) != NULL;
+		break;
+	case WLR_SCENE_NODE_RECT:
+		paintable = true;
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *scene_buffer = scene_buffer_from_node(node);
+		paintable = scene_buffer_get_texture(scene_buffer,
+			list->renderer) != NULL;
+		break;
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	struct wlr_box box = {
+		.x = x,
+		.y = y,
+		.width = width,
+		.height = height,
+	};
+	scale_box(&box, list->output->scale);
+
+	pixman_box32_t extents = {
+		.x1 = box.x,
+		.y1 = box.y,
+		.x2 = box.x + box.width,
+		.y2 = box.y + box.height,
+	};
+	if (paintable && !wlr_box_empty(&box) &&
+			pixman_region32_contains_rectangle(list->damage, &extents) !=
+			PIXMAN_REGION_OUT) {
+		struct render_entry *entry =
+			wl_array_add(&list->entries, sizeof(*entry));
+		if (entry == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed");
+			return;
+		}
+		entry->node = node;
+		entry->x = x;
+		entry->y = y;
+		entry->box = box;
+		pixman_region32_init(&entry->visible);
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		render_list_add_node(list, child, x, y);
+	}
+}
+
+/**
+ * Collect the nodes intersecting the damage, then walk them from top to bottom
+ * to compute which damaged parts of each node aren't hidden by an opaque node
+ * above it.
+ */
+static void render_list_init(struct render_list *list, struct wlr_scene *scene,
+		struct wlr_output *output, struct wlr_renderer *renderer,
+		int lx, int ly, pixman_region32_t *damage) {
+	list->output = output;
+	list->renderer = renderer;
+	list->damage = damage;
+	wl_array_init(&list->entries);
+
+	render_list_add_node(list, &scene->node, -lx, -ly);
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+
+	struct render_entry *entries = list->entries.data;
+	size_t len = list->entries.size / sizeof(*entries);
+	for (size_t i = len; i-- > 0;) {
+		struct render_entry *entry = &entries[i];
+
+		pixman_region32_union_rect(&entry->visible, &entry->visible,
+			entry->box.x, entry->box.y, entry->box.width, entry->box.height);
+		pixman_region32_intersect(&entry->visible, &entry->visible, damage);
+		pixman_region32_subtract(&entry->visible, &entry->visible, &opaque);
+		if (!pixman_region32_not_empty(&entry->visible)) {
+			continue;
+		}
+
+		scene_node_get_opaque_region(entry->node, entry, output->scale,
+			&opaque);
+	}
+
+	pixman_region32_init(&list->background);
+	pixman_region32_subtract(&list->background, damage, &opaque);
+
+	pixman_region32_fini(&opaque);
+}
+
+static void render_list_finish(struct render_list *list) {
+	struct render_entry *entry;
+	wl_array_for_each(entry, &list->entries) {
+		pixman_region32_fini(&entry->visible);
+	}
+	wl_array_release(&list->entries);
+	pixman_region32_fini(&list->background);
+}
+
+static void render_texture(struct wlr_output *output,
+		struct wlr_renderer *renderer, pixman_region32_t *visible,
+		struct wlr_texture *texture, const struct wlr_fbox *src_box,
+		const float matrix[static 9]) {
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(visible, &nrects);
+	struct wlr_box *clip_rects = calloc(nrects, sizeof(*clip_rects));
+	if (clip_rects == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	for (int i = 0; i < nrects; ++i) {
+		output_rect_to_buffer_box(output, &rects[i], &clip_rects[i]);
+	}
+
+	// Submit all visible rectangles at once, so that the renderer can draw
+	// them with a single call
+	struct wlr_render_texture_item item = {
+		.texture = texture,
+		.src_box = *src_box,
+		.alpha = 1.0,
+		.clip_rects = clip_rects,
+		.clip_rects_len = nrects,
+	};
+	memcpy(item.matrix, matrix, sizeof(item.matrix));
+	wlr_render_texture_batch(renderer, &item, 1);
+
+	free(clip_rects);
+}
+
+static void render_entry(struct render_list *list, struct render_entry *entry) {
+	struct wlr_output *output = list->output;
+	struct wlr_renderer *renderer = list->renderer;
+	struct wlr_scene_node *node = entry->node;
+
+	struct wlr_texture *texture;
+	struct wlr_fbox src_box = {0};
+	enum wl_output_transform transform;
+	float matrix[9];
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		/* Root or tree node has nothing to render itself */
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		struct wlr_surface *surface = scene_surface->surface;
+
+		texture = wlr_surface_get_texture(surface);
+		wlr_surface_get_buffer_source_box(surface, &src_box);
+
+		transform = wlr_output_transform_invert(surface->current.transform);
+		wlr_matrix_project_box(matrix, &entry->box, transform, 0.0,
+			output->transform_matrix);
+
+		render_texture(output, renderer, &entry->visible, texture, &src_box,
+			matrix);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = scene_rect_from_node(node);
+
+		int nrects;
+		pixman_box32_t *rects =
+			pixman_region32_rectangles(&entry->visible, &nrects);
+		for (int i = 0; i < nrects; ++i) {
+			scissor_output(output, renderer, &rects[i]);
+			wlr_render_rect(renderer, &entry->box, scene_rect->color,
+				output->transform_matrix);
+		}
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *scene_buffer = scene_buffer_from_node(node);
+
+		texture = scene_buffer->texture;
+		src_box = scene_buffer->src_box;
+		if (src_box.width <= 0 || src_box.height <= 0) {
+			src_box.x = src_box.y = 0;
+			src_box.width = texture->width;
+			src_box.height = texture->height;
+		}
+
+		transform = wlr_output_transform_invert(scene_buffer->transform);
+		wlr_matrix_project_box(matrix, &entry->box, transform, 0.0,
+			output->transform_matrix);
+
+		render_texture(output, renderer, &entry->visible, texture, &src_box,
+			matrix);
+		break;
+	}
+}
+
+static void render_list_render(struct render_list *list) {
+	struct wlr_output *output = list->output;
+	struct wlr_renderer *renderer = list->renderer;
+
+	int nrects;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&list->background, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(output, renderer, &rects[i]);
+		wlr_renderer_clear(renderer, (float[4]){ 0.0, 0.0, 0.0, 1.0 });
+	}
+
+	struct render_entry *entry;
+	wl_array_for_each(entry, &list->entries) {
+		if (!pixman_region32_not_empty(&entry->visible)) {
+			continue;
+		}
+		render_entry(list, entry);
+	}
+
+	wlr_renderer_scissor(renderer, NULL);
+}
+
+void wlr_scene_render_output(struct wlr_scene *scene, struct wlr_output *output,
+		int lx, int ly, pixman_region32_t *damage) {
+	struct wlr_renderer *renderer =
+		wlr_backend_get_renderer(output->backend);
+	assert(renderer != NULL);
+
+	pixman_region32_t full_region;
+	int width, height;
+	wlr_output_transformed_resolution(output, &width, &height);
+	pixman_region32_init_rect(&full_region, 0, 0, width, height);
+	if (damage == NULL) {
+		damage = &full_region;
+	}
+
+	struct render_list list;
+	render_list_init(&list, scene, output, renderer, lx, ly, damage);
+	render_list_render(&list);
+	render_list_finish(&list);
+
+	pixman_region32_fini(&full_region);
+}
+
+static void scene_output_handle_damage_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_output *scene_output =
+		wl_container_of(listener, scene_output, damage_destroy);
+	// The wlr_output_damage is being destroyed, don't destroy it twice
+	wl_list_remove(&scene_output->damage_destroy.link);
+	wl_list_init(&scene_output->damage_destroy.link);
+	scene_output->damage = NULL;
+	wlr_scene_output_destroy(scene_output);
+}
+
+struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
+		struct wlr_output *output) {
+	assert(wlr_scene_get_scene_output(scene, output) == NULL);
+
+	struct wlr_scene_output *scene_output = calloc(1, sizeof(*scene_output));
+	if (scene_output == NULL) {
+		return NULL;
+	}
+
+	scene_output->damage = wlr_output_damage_create(output);
+	if (scene_output->damage == NULL) {
+		free(scene_output);
+		return NULL;
+	}
+
+	scene_output->output = output;
+	scene_output->scene = scene;
+	wl_list_insert(&scene->outputs, &scene_output->link);
+
+	scene_output->damage_destroy.notify = scene_output_handle_damage_destroy;
+	wl_signal_add(&scene_output->damage->events.destroy,
+		&scene_output->damage_destroy);
+
+	wlr_output_damage_add_whole(scene_output->damage);
+
+	return scene_output;
+}
+
+void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
+	if (scene_output == NULL) {
+		return;
+	}
+	wl_list_remove(&scene_output->link);
+	wl_list_remove(&scene_output->damage_destroy.link);
+	wlr_output_damage_destroy(scene_output->damage);
+	free(scene_output);
+}
+
+struct wlr_scene_output *wlr_scene_get_scene_output(struct wlr_scene *scene,
+		struct wlr_output *output) {
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		if (scene_output->output == output) {
+			return scene_output;
+		}
+	}
+	return NULL;
+}
+
+void wlr_scene_output_set_position(struct wlr_scene_output *scene_output,
+		int lx, int ly) {
+	if (scene_output->x == lx && scene_output->y == ly) {
+		return;
+	}
+
+	scene_output->x = lx;
+	scene_output->y = ly;
+	wlr_output_damage_add_whole(scene_output->damage);
+}
+
+struct scene_output_iterator_data {
+	struct wlr_scene_output *scene_output;
+	wlr_surface_iterator_func_t user_iterator;
+	void *user_data;
+};
+
+static void scene_output_for_each_surface_iterator(struct wlr_surface *surface,
+		int lx, int ly, void *_data) {
+	struct scene_output_iterator_data *data = _data;
+	struct wlr_scene_output *scene_output = data->scene_output;
+
+	struct wlr_box output_box = {
+		.x = scene_output->x,
+		.y = scene_output->y,
+	};
+	wlr_output_effective_resolution(scene_output->output,
+		&output_box.width, &output_box.height);
+
+	struct wlr_box surface_box = {
+		.x = lx,
+		.y = ly,
+		.width = surface->current.width,
+		.height = surface->current.height,
+	};
+
+	struct wlr_box intersection;
+	if (!wlr_box_intersection(&intersection, &output_box, &surface_box)) {
+		return;
+	}
+
+	data->user_iterator(surface, lx, ly, data->user_data);
+}
+
+void wlr_scene_output_for_each_surface(struct wlr_scene_output *scene_output,
+		wlr_surface_iterator_func_t iterator, void *user_data) {
+	struct scene_output_iterator_data data = {
+		.scene_output = scene_output,
+		.user_iterator = iterator,
+		.user_data = user_data,
+	};
+	wlr_scene_node_for_each_surface(&scene_output->scene->node,
+		scene_output_for_each_surface_iterator, &data);
+}
+
+static void scene_output_send_frame_done_iterator(struct wlr_surface *surface,
+		int lx, int ly, void *data) {
+	struct timespec *now = data;
+	wlr_surface_send_frame_done(surface, now);
+}
+
+void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
+		struct timespec *now) {
+	wlr_scene_output_for_each_surface(scene_output,
+		scene_output_send_frame_done_iterator, now);
+}
+
+static void scene_node_upload_buffers(struct wlr_scene_node *node,
+		struct wlr_renderer *renderer) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		scene_buffer_get_texture(scene_buffer_from_node(node), renderer);
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_node_upload_buffers(child, renderer);
+	}
+}
+
+bool wlr_scene_output_commit(struct wlr_scene_output *scene_output) {
+	struct wlr_output *output = scene_output->output;
+
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer != NULL);
+
+	// Textures can't be created while the output's buffer is attached
+	scene_node_upload_buffers(&scene_output->scene->node, renderer);
+
+	bool needs_frame;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_attach_render(scene_output->damage,
+			&needs_frame, &damage)) {
+		pixman_region32_fini(&damage);
+		return false;
+	}
+
+	if (!needs_frame) {
+		pixman_region32_fini(&damage);
+		wlr_output_rollback(output);
+		return true;
+	}
+
+	wlr_renderer_begin(renderer, output->width, output->height);
+	wlr_scene_render_output(scene_output->scene, output,
+		scene_output->x, scene_output->y, &damage);
+	wlr_output_render_software_cursors(output, &damage);
+	wlr_renderer_end(renderer);
+
+	pixman_region32_fini(&damage);
+
+	int tr_width, tr_height;
+	wlr_output_transformed_resolution(output, &tr_width, &tr_height);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+
+	pixman_region32_t frame_damage;
+	pixman_region32_init(&frame_damage);
+	wlr_region_transform(&frame_damage, &scene_output->damage->current,
+		transform, tr_width, tr_height);
+	wlr_output_set_damage(output, &frame_damage);
+	pixman_region32_fini(&frame_damage);
+
+	return wlr_output_commit(output);
+}
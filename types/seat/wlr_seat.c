@@ -160,6 +160,7 @@ void wlr_seat_destroy(struct wlr_seat *seat) {
 	}
 
 	wlr_seat_pointer_clear_focus(seat);
+	wlr_seat_pointer_coalesce_motion(seat, NULL);
 	wlr_seat_keyboard_clear_focus(seat);
 
 	struct wlr_touch_point *point;
@@ -227,6 +228,9 @@ struct wlr_seat *wlr_seat_create(struct wl_display *display, const char *name) {
 	seat->pointer_state.grab = pointer_grab;
 
 	wl_signal_init(&seat->pointer_state.events.focus_change);
+	wl_signal_init(&seat->pointer_state.events.motion_flush);
+	wl_list_init(&seat->pointer_state.coalesce_output_frame.link);
+	wl_list_init(&seat->pointer_state.coalesce_output_destroy.link);
 
 	// keyboard state
 	struct wlr_seat_keyboard_grab *keyboard_grab =
@@ -155,6 +155,9 @@ void wlr_seat_pointer_enter(struct wlr_seat *wlr_seat,
 		return;
 	}
 
+	// deferred motion belongs to the previously entered surface
+	seat_pointer_flush_motion(wlr_seat);
+
 	struct wlr_seat_client *client = NULL;
 	if (surface) {
 		struct wl_client *wl_client = wl_resource_get_client(surface->resource);
@@ -223,6 +226,91 @@ void wlr_seat_pointer_warp(struct wlr_seat *wlr_seat, double sx, double sy) {
 	wlr_seat->pointer_state.sy = sy;
 }
 
+static void pointer_send_motion(struct wlr_seat_client *client, uint32_t time,
+		double sx, double sy) {
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &client->pointers) {
+		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
+			continue;
+		}
+
+		wl_pointer_send_motion(resource, time, wl_fixed_from_double(sx),
+			wl_fixed_from_double(sy));
+	}
+}
+
+void seat_pointer_defer_motion(struct wlr_seat *wlr_seat) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	assert(state->coalesce_output != NULL);
+	if (!state->motion_deferred) {
+		state->motion_deferred = true;
+		// Make sure we get a frame event even if nothing is rendered
+		wlr_output_schedule_frame(state->coalesce_output);
+	}
+}
+
+void seat_pointer_flush_motion(struct wlr_seat *wlr_seat) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (!state->motion_deferred) {
+		return;
+	}
+	state->motion_deferred = false;
+
+	struct wlr_seat_client *client = state->focused_client;
+	if (client != NULL && state->motion_pending) {
+		pointer_send_motion(client, state->motion_time, state->motion_sx,
+			state->motion_sy);
+	}
+	state->motion_pending = false;
+
+	wlr_signal_emit_safe(&state->events.motion_flush, wlr_seat);
+
+	if (state->frame_deferred) {
+		state->frame_deferred = false;
+		wlr_seat_pointer_send_frame(wlr_seat);
+	}
+}
+
+static void seat_pointer_handle_coalesce_output_frame(
+		struct wl_listener *listener, void *data) {
+	struct wlr_seat_pointer_state *state =
+		wl_container_of(listener, state, coalesce_output_frame);
+	seat_pointer_flush_motion(state->seat);
+}
+
+static void seat_pointer_handle_coalesce_output_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_seat_pointer_state *state =
+		wl_container_of(listener, state, coalesce_output_destroy);
+	wlr_seat_pointer_coalesce_motion(state->seat, NULL);
+}
+
+void wlr_seat_pointer_coalesce_motion(struct wlr_seat *wlr_seat,
+		struct wlr_output *output) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (state->coalesce_output == output) {
+		return;
+	}
+
+	seat_pointer_flush_motion(wlr_seat);
+
+	wl_list_remove(&state->coalesce_output_frame.link);
+	wl_list_init(&state->coalesce_output_frame.link);
+	wl_list_remove(&state->coalesce_output_destroy.link);
+	wl_list_init(&state->coalesce_output_destroy.link);
+
+	state->coalesce_output = output;
+	if (output != NULL) {
+		state->coalesce_output_frame.notify =
+			seat_pointer_handle_coalesce_output_frame;
+		wl_signal_add(&output->events.frame, &state->coalesce_output_frame);
+		state->coalesce_output_destroy.notify =
+			seat_pointer_handle_coalesce_output_destroy;
+		wl_signal_add(&output->events.destroy,
+			&state->coalesce_output_destroy);
+	}
+}
+
 void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
 		double sx, double sy) {
 	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
@@ -234,14 +322,15 @@ void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &client->pointers) {
-		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
-			continue;
-		}
-
-		wl_pointer_send_motion(resource, time, wl_fixed_from_double(sx),
-			wl_fixed_from_double(sy));
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (state->coalesce_output != NULL) {
+		state->motion_pending = true;
+		state->motion_time = time;
+		state->motion_sx = sx;
+		state->motion_sy = sy;
+		seat_pointer_defer_motion(wlr_seat);
+	} else {
+		pointer_send_motion(client, time, sx, sy);
 	}
 
 	wlr_seat_pointer_warp(wlr_seat, sx, sy);
@@ -254,6 +343,8 @@ uint32_t wlr_seat_pointer_send_button(struct wlr_seat *wlr_seat, uint32_t time,
 		return 0;
 	}
 
+	seat_pointer_flush_motion(wlr_seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(client);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
@@ -274,6 +365,8 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 		return;
 	}
 
+	seat_pointer_flush_motion(wlr_seat);
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
 		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
@@ -306,6 +399,12 @@ void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat) {
 		return;
 	}
 
+	// the frame is sent along with the deferred motion events
+	if (wlr_seat->pointer_state.motion_deferred) {
+		wlr_seat->pointer_state.frame_deferred = true;
+		return;
+	}
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
 		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
@@ -1,5 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sync_file.h>
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
@@ -20,6 +29,8 @@ void wlr_buffer_init(struct wlr_buffer *buffer,
 	buffer->height = height;
 	wl_signal_init(&buffer->events.destroy);
 	wl_signal_init(&buffer->events.release);
+	buffer->acquire_fence_fd = -1;
+	buffer->release_fence_fd = -1;
 }
 
 static void buffer_consider_destroy(struct wlr_buffer *buffer) {
@@ -31,6 +42,13 @@ static void buffer_consider_destroy(struct wlr_buffer *buffer) {
 
 	wlr_signal_emit_safe(&buffer->events.destroy, NULL);
 
+	if (buffer->acquire_fence_fd >= 0) {
+		close(buffer->acquire_fence_fd);
+	}
+	if (buffer->release_fence_fd >= 0) {
+		close(buffer->release_fence_fd);
+	}
+
 	buffer->impl->destroy(buffer);
 }
 
@@ -99,6 +117,76 @@ bool wlr_buffer_get_shm(struct wlr_buffer *buffer,
 	return buffer->impl->get_shm(buffer, attribs);
 }
 
+void wlr_buffer_set_acquire_fence(struct wlr_buffer *buffer, int fence_fd) {
+	if (buffer->acquire_fence_fd >= 0) {
+		close(buffer->acquire_fence_fd);
+	}
+	buffer->acquire_fence_fd = fence_fd;
+	buffer->acquire_fence_seq++;
+}
+
+int wlr_buffer_dup_acquire_fence(struct wlr_buffer *buffer) {
+	if (buffer->acquire_fence_fd < 0) {
+		return -1;
+	}
+	int fd = fcntl(buffer->acquire_fence_fd, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to duplicate acquire fence");
+	}
+	return fd;
+}
+
+static int sync_file_merge(int fd1, int fd2) {
+	struct sync_merge_data data = { .fd2 = fd2 };
+	snprintf(data.name, sizeof(data.name), "wlroots release fence");
+	if (ioctl(fd1, SYNC_IOC_MERGE, &data) != 0) {
+		return -1;
+	}
+	return data.fence;
+}
+
+static bool sync_file_wait(int fd) {
+	struct pollfd pollfd = { .fd = fd, .events = POLLIN };
+	while (true) {
+		int ret = poll(&pollfd, 1, -1);
+		if (ret > 0) {
+			return !(pollfd.revents & (POLLERR | POLLNVAL));
+		} else if (ret < 0 && errno != EINTR && errno != EAGAIN) {
+			return false;
+		}
+	}
+}
+
+bool wlr_buffer_add_release_fence(struct wlr_buffer *buffer, int fence_fd) {
+	if (buffer->release_fence_fd < 0) {
+		buffer->release_fence_fd = fence_fd;
+		return true;
+	}
+
+	int merged_fd = sync_file_merge(buffer->release_fence_fd, fence_fd);
+	if (merged_fd < 0) {
+		// Never drop a fence: wait for the old one so that only the new one
+		// needs to be kept
+		wlr_log_errno(WLR_ERROR, "Failed to merge release fences, "
+			"waiting for the previous one");
+		if (!sync_file_wait(buffer->release_fence_fd)) {
+			wlr_log_errno(WLR_ERROR, "Failed to wait for release fence");
+		}
+		merged_fd = fence_fd;
+	} else {
+		close(fence_fd);
+	}
+	close(buffer->release_fence_fd);
+	buffer->release_fence_fd = merged_fd;
+	return true;
+}
+
+int wlr_buffer_take_release_fence(struct wlr_buffer *buffer) {
+	int fd = buffer->release_fence_fd;
+	buffer->release_fence_fd = -1;
+	return fd;
+}
+
 bool wlr_resource_is_buffer(struct wl_resource *resource) {
 	return strcmp(wl_resource_get_class(resource), wl_buffer_interface.name) == 0;
 }
@@ -295,6 +383,11 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 		return NULL;
 	}
 
+	if (buffer->resource == NULL) {
+		// The previous wl_buffer has been destroyed, its format is unknown
+		return NULL;
+	}
+
 	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
 	struct wl_shm_buffer *old_shm_buf = wl_shm_buffer_get(buffer->resource);
 	if (shm_buf == NULL || old_shm_buf == NULL) {
@@ -322,19 +415,12 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 	wl_shm_buffer_begin_access(shm_buf);
 	void *data = wl_shm_buffer_get_data(shm_buf);
 
-	int n;
-	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n);
-	for (int i = 0; i < n; ++i) {
-		pixman_box32_t *r = &rects[i];
-		if (!wlr_texture_write_pixels(buffer->texture, stride,
-				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
-				r->x1, r->y1, data)) {
-			wl_shm_buffer_end_access(shm_buf);
-			return NULL;
-		}
-	}
-
+	bool ok = wlr_texture_write_pixels_region(buffer->texture, stride,
+		damage, data);
 	wl_shm_buffer_end_access(shm_buf);
+	if (!ok) {
+		return NULL;
+	}
 
 	// We have uploaded the data, we don't need to access the wl_buffer
 	// anymore
@@ -391,6 +477,13 @@ static void shm_client_buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer)
 	}
 }
 
+struct wl_shm_buffer *buffer_get_wl_shm_buffer(struct wlr_buffer *buffer) {
+	if (buffer->impl != &shm_client_buffer_impl) {
+		return NULL;
+	}
+	return shm_client_buffer_from_buffer(buffer)->shm_buffer;
+}
+
 static const struct wlr_buffer_impl shm_client_buffer_impl = {
 	.destroy = shm_client_buffer_destroy,
 	.begin_data_ptr_access = shm_client_buffer_begin_data_ptr_access,
@@ -1,11 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_idle.h>
 #include <wlr/util/log.h>
 #include "idle-protocol.h"
 #include "util/signal.h"
+#include "util/time.h"
 
 static const struct org_kde_kwin_idle_timeout_interface idle_timeout_impl;
 
@@ -16,10 +19,97 @@ static struct wlr_idle_timeout *idle_timeout_from_resource(
 	return wl_resource_get_user_data(resource);
 }
 
-static int idle_notify(void *data) {
-	struct wlr_idle_timeout *timer = data;
+static int64_t get_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_msec(&now);
+}
+
+static void heap_swap(struct wlr_idle *idle, size_t i, size_t j) {
+	struct wlr_idle_timeout *tmp = idle->heap[i];
+	idle->heap[i] = idle->heap[j];
+	idle->heap[j] = tmp;
+	idle->heap[i]->heap_index = i;
+	idle->heap[j]->heap_index = j;
+}
+
+static void heap_sift_up(struct wlr_idle *idle, size_t i) {
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+		if (idle->heap[parent]->deadline <= idle->heap[i]->deadline) {
+			break;
+		}
+		heap_swap(idle, i, parent);
+		i = parent;
+	}
+}
+
+static void heap_sift_down(struct wlr_idle *idle, size_t i) {
+	while (true) {
+		size_t min = i;
+		size_t left = 2 * i + 1, right = 2 * i + 2;
+		if (left < idle->heap_len &&
+				idle->heap[left]->deadline < idle->heap[min]->deadline) {
+			min = left;
+		}
+		if (right < idle->heap_len &&
+				idle->heap[right]->deadline < idle->heap[min]->deadline) {
+			min = right;
+		}
+		if (min == i) {
+			break;
+		}
+		heap_swap(idle, i, min);
+		i = min;
+	}
+}
+
+static void heap_remove(struct wlr_idle *idle, struct wlr_idle_timeout *timer) {
+	if (!timer->in_heap) {
+		return;
+	}
+	size_t i = timer->heap_index;
+	idle->heap_len--;
+	if (i != idle->heap_len) {
+		idle->heap[i] = idle->heap[idle->heap_len];
+		idle->heap[i]->heap_index = i;
+		heap_sift_down(idle, i);
+		heap_sift_up(idle, i);
+	}
+	timer->in_heap = false;
+}
+
+/**
+ * Arm the shared timer for the earliest deadline. The timer is left alone if
+ * it would fire before that: spurious wake-ups are cheaper than a syscall on
+ * each timeout removal.
+ */
+static void update_timer(struct wlr_idle *idle, int64_t now) {
+	if (idle->heap_len == 0) {
+		if (idle->timer_deadline != 0) {
+			wl_event_source_timer_update(idle->timer_source, 0);
+			idle->timer_deadline = 0;
+		}
+		return;
+	}
+
+	int64_t deadline = idle->heap[0]->deadline;
+	if (idle->timer_deadline != 0 && idle->timer_deadline <= deadline) {
+		return;
+	}
+
+	// A zero delay would disarm the timer
+	int64_t delay = deadline - now;
+	if (delay < 1) {
+		delay = 1;
+	}
+	wl_event_source_timer_update(idle->timer_source, delay);
+	idle->timer_deadline = deadline;
+}
+
+static void idle_notify(struct wlr_idle_timeout *timer) {
 	if (timer->idle_state) {
-		return 0;
+		return;
 	}
 	timer->idle_state = true;
 	wlr_signal_emit_safe(&timer->events.idle, timer);
@@ -27,10 +117,68 @@ static int idle_notify(void *data) {
 	if (timer->resource) {
 		org_kde_kwin_idle_timeout_send_idle(timer->resource);
 	}
-	return 1;
 }
 
-static void handle_activity(struct wlr_idle_timeout *timer) {
+/**
+ * Start counting down from now for an enabled timeout.
+ */
+static void timer_arm(struct wlr_idle_timeout *timer, int64_t now) {
+	timer->last_activity = now;
+	if (timer->timeout == 0) {
+		idle_notify(timer);
+		return;
+	}
+	if (timer->in_heap) {
+		// The deadline will be pushed back when it expires
+		return;
+	}
+
+	struct wlr_idle *idle = timer->idle;
+	if (idle->heap_len == idle->heap_cap) {
+		size_t cap = idle->heap_cap == 0 ? 8 : 2 * idle->heap_cap;
+		struct wlr_idle_timeout **heap =
+			realloc(idle->heap, cap * sizeof(heap[0]));
+		if (heap == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return;
+		}
+		idle->heap = heap;
+		idle->heap_cap = cap;
+	}
+
+	timer->deadline = now + timer->timeout;
+	timer->heap_index = idle->heap_len;
+	timer->in_heap = true;
+	idle->heap[idle->heap_len++] = timer;
+	heap_sift_up(idle, timer->heap_index);
+
+	update_timer(idle, now);
+}
+
+static int handle_timer(void *data) {
+	struct wlr_idle *idle = data;
+	idle->timer_deadline = 0;
+
+	int64_t now = get_time_msec();
+	while (idle->heap_len > 0 && idle->heap[0]->deadline <= now) {
+		struct wlr_idle_timeout *timer = idle->heap[0];
+		int64_t deadline = timer->last_activity + timer->timeout;
+		if (deadline > now) {
+			// There was some activity since the timer was armed
+			timer->deadline = deadline;
+			heap_sift_down(idle, 0);
+			continue;
+		}
+
+		heap_remove(idle, timer);
+		idle_notify(timer);
+	}
+
+	update_timer(idle, now);
+	return 0;
+}
+
+static void handle_activity(struct wlr_idle_timeout *timer, int64_t now) {
 	if (!timer->enabled) {
 		return;
 	}
@@ -45,11 +193,7 @@ static void handle_activity(struct wlr_idle_timeout *timer) {
 		}
 	}
 
-	// rearm the timer
-	wl_event_source_timer_update(timer->idle_source, timer->timeout);
-	if (timer->timeout == 0) {
-		idle_notify(timer);
-	}
+	timer_arm(timer, now);
 }
 
 static void handle_timer_resource_destroy(struct wl_resource *timer_resource) {
@@ -74,7 +218,7 @@ static void release_idle_timeout(struct wl_client *client,
 static void simulate_activity(struct wl_client *client,
 		struct wl_resource *resource){
 	struct wlr_idle_timeout *timer = idle_timeout_from_resource(resource);
-	handle_activity(timer);
+	handle_activity(timer, get_time_msec());
 }
 
 static const struct org_kde_kwin_idle_timeout_interface idle_timeout_impl = {
@@ -96,7 +240,7 @@ static void handle_input_notification(struct wl_listener *listener, void *data)
 		wl_container_of(listener, timer, input_listener);
 	struct wlr_seat *seat = data;
 	if (timer->seat == seat) {
-		handle_activity(timer);
+		handle_activity(timer, timer->idle->activity_time);
 	}
 }
 
@@ -108,6 +252,7 @@ static struct wlr_idle_timeout *create_timer(struct wlr_idle *idle,
 		return NULL;
 	}
 
+	timer->idle = idle;
 	timer->seat = seat;
 	timer->timeout = timeout;
 	timer->idle_state = false;
@@ -123,16 +268,6 @@ static struct wlr_idle_timeout *create_timer(struct wlr_idle *idle,
 
 	timer->input_listener.notify = handle_input_notification;
 	wl_signal_add(&idle->events.activity_notify, &timer->input_listener);
-	// create the timer
-	timer->idle_source =
-		wl_event_loop_add_timer(idle->event_loop, idle_notify, timer);
-	if (timer->idle_source == NULL) {
-		wl_list_remove(&timer->link);
-		wl_list_remove(&timer->input_listener.link);
-		wl_list_remove(&timer->seat_destroy.link);
-		free(timer);
-		return NULL;
-	}
 
 	if (resource) {
 		timer->resource = resource;
@@ -140,11 +275,7 @@ static struct wlr_idle_timeout *create_timer(struct wlr_idle *idle,
 	}
 
 	if (timer->enabled) {
-		// arm the timer
-		wl_event_source_timer_update(timer->idle_source, timer->timeout);
-		if (timer->timeout == 0) {
-			idle_notify(timer);
-		}
+		timer_arm(timer, get_time_msec());
 	}
 
 	return timer;
@@ -185,14 +316,20 @@ void wlr_idle_set_enabled(struct wlr_idle *idle, struct wlr_seat *seat,
 		enabled ? "Enabling" : "Disabling",
 		seat ? seat->name : "all seats");
 	idle->enabled = enabled;
+	int64_t now = get_time_msec();
 	struct wlr_idle_timeout *timer;
 	wl_list_for_each(timer, &idle->idle_timers, link) {
 		if (seat != NULL && timer->seat != seat) {
 			continue;
 		}
-		int timeout = enabled ? timer->timeout : 0;
-		wl_event_source_timer_update(timer->idle_source, timeout);
 		timer->enabled = enabled;
+		if (enabled) {
+			if (!timer->idle_state) {
+				timer_arm(timer, now);
+			}
+		} else {
+			heap_remove(idle, timer);
+		}
 	}
 }
 
@@ -214,7 +351,13 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_idle *idle = wl_container_of(listener, idle, display_destroy);
 	wlr_signal_emit_safe(&idle->events.destroy, idle);
 	wl_list_remove(&idle->display_destroy.link);
+	struct wlr_idle_timeout *timer;
+	wl_list_for_each(timer, &idle->idle_timers, link) {
+		timer->in_heap = false;
+	}
+	wl_event_source_remove(idle->timer_source);
 	wl_global_destroy(idle->global);
+	free(idle->heap);
 	free(idle);
 }
 
@@ -234,21 +377,30 @@ struct wlr_idle *wlr_idle_create(struct wl_display *display) {
 		return NULL;
 	}
 
-	idle->display_destroy.notify = handle_display_destroy;
-	wl_display_add_destroy_listener(display, &idle->display_destroy);
+	idle->timer_source =
+		wl_event_loop_add_timer(idle->event_loop, handle_timer, idle);
+	if (idle->timer_source == NULL) {
+		free(idle);
+		return NULL;
+	}
 
 	idle->global = wl_global_create(display, &org_kde_kwin_idle_interface,
 		1, idle, idle_bind);
 	if (idle->global == NULL) {
-		wl_list_remove(&idle->display_destroy.link);
+		wl_event_source_remove(idle->timer_source);
 		free(idle);
 		return NULL;
 	}
+
+	idle->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &idle->display_destroy);
 	wlr_log(WLR_DEBUG, "idle manager created");
 	return idle;
 }
 
 void wlr_idle_notify_activity(struct wlr_idle *idle, struct wlr_seat *seat) {
+	// Only record the activity time here, timers are re-armed lazily
+	idle->activity_time = get_time_msec();
 	wlr_signal_emit_safe(&idle->events.activity_notify, seat);
 }
 
@@ -262,7 +414,7 @@ void wlr_idle_timeout_destroy(struct wlr_idle_timeout *timer) {
 
 	wl_list_remove(&timer->input_listener.link);
 	wl_list_remove(&timer->seat_destroy.link);
-	wl_event_source_remove(timer->idle_source);
+	heap_remove(timer->idle, timer);
 	wl_list_remove(&timer->link);
 
 	if (timer->resource) {
@@ -9,6 +9,7 @@
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/util/log.h>
 #include "linux-dmabuf-unstable-v1-protocol.h"
+#include "render/wlr_texture.h"
 #include "util/signal.h"
 
 #define LINUX_DMABUF_VERSION 3
@@ -150,15 +151,33 @@ static void buffer_handle_resource_destroy(struct wl_resource *buffer_resource)
 }
 
 static bool check_import_dmabuf(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
-		struct wlr_dmabuf_attributes *attribs) {
+		struct wlr_dmabuf_v1_buffer *buffer) {
+	struct wlr_dmabuf_attributes *attribs = &buffer->attributes;
+	// Reject unsupported formats and modifiers early, without going through
+	// the renderer's import path. LINEAR is accepted even if the renderer
+	// doesn't advertise it, since it's sometimes used to signal modifier
+	// unawareness.
+	const struct wlr_drm_format_set *formats =
+		wlr_renderer_get_dmabuf_texture_formats(linux_dmabuf->renderer);
+	if (formats != NULL) {
+		uint64_t modifier = attribs->modifier;
+		if (modifier == DRM_FORMAT_MOD_LINEAR) {
+			modifier = DRM_FORMAT_MOD_INVALID;
+		}
+		if (!wlr_drm_format_set_has(formats, attribs->format, modifier)) {
+			return false;
+		}
+	}
+
+	// Import through the buffer, so that the renderer can keep the imported
+	// texture around and re-use it when wlr_surface imports the buffer on
+	// commit
 	struct wlr_texture *texture =
-		wlr_texture_from_dmabuf(linux_dmabuf->renderer, attribs);
+		wlr_texture_from_buffer(linux_dmabuf->renderer, &buffer->base);
 	if (texture == NULL) {
 		return false;
 	}
 
-	// We can import the image, good. No need to keep it since wlr_surface will
-	// import it again on commit.
 	wlr_texture_destroy(texture);
 	return true;
 }
@@ -273,31 +292,35 @@ static void params_create_common(struct wl_resource *params_resource,
 		goto err_out;
 	}
 
-	/* Check if dmabuf is usable */
-	if (!check_import_dmabuf(linux_dmabuf, &attribs)) {
-		goto err_failed;
-	}
-
 	struct wlr_dmabuf_v1_buffer *buffer = calloc(1, sizeof(*buffer));
 	if (!buffer) {
 		wl_resource_post_no_memory(params_resource);
 		goto err_failed;
 	}
 	wlr_buffer_init(&buffer->base, &buffer_impl, attribs.width, attribs.height);
+	wl_list_init(&buffer->release.link);
+
+	// The buffer owns the DMA-BUF FDs from now on
+	buffer->attributes = attribs;
+	attribs.n_planes = 0;
+
+	/* Check if dmabuf is usable */
+	if (!check_import_dmabuf(linux_dmabuf, buffer)) {
+		wlr_buffer_drop(&buffer->base);
+		goto err_failed;
+	}
 
 	struct wl_client *client = wl_resource_get_client(params_resource);
 	buffer->resource = wl_resource_create(client, &wl_buffer_interface,
 		1, buffer_id);
 	if (!buffer->resource) {
 		wl_resource_post_no_memory(params_resource);
-		free(buffer);
+		wlr_buffer_drop(&buffer->base);
 		goto err_failed;
 	}
 	wl_resource_set_implementation(buffer->resource,
 		&wl_buffer_impl, buffer, buffer_handle_resource_destroy);
 
-	buffer->attributes = attribs;
-
 	buffer->release.notify = buffer_handle_release;
 	wl_signal_add(&buffer->base.events.release, &buffer->release);
 
@@ -12,6 +12,7 @@
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_surface.h>
 #include <wlr/util/log.h>
@@ -19,12 +20,16 @@
 #include "backend/backend.h"
 #include "render/allocator.h"
 #include "render/drm_format_set.h"
+#include "render/pixel_format.h"
 #include "render/swapchain.h"
 #include "render/wlr_renderer.h"
+#include "types/wlr_buffer.h"
+#include "types/wlr_output.h"
 #include "util/global.h"
 #include "util/signal.h"
 
 #define OUTPUT_VERSION 3
+#define OUTPUT_CURSOR_CACHE_CAP 8
 
 static void send_geometry(struct wl_resource *resource) {
 	struct wlr_output *output = wlr_output_from_resource(resource);
@@ -358,6 +363,8 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	output->scale = 1;
 	output->commit_seq = 0;
 	wl_list_init(&output->cursors);
+	wl_list_init(&output->cursor_buffer_cache);
+	wl_list_init(&output->layers);
 	wl_list_init(&output->resources);
 	wl_signal_init(&output->events.frame);
 	wl_signal_init(&output->events.damage);
@@ -385,6 +392,8 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 
 static void output_clear_back_buffer(struct wlr_output *output);
 
+static void output_clear_cursor_cache(struct wlr_output *output);
+
 void wlr_output_destroy(struct wlr_output *output) {
 	if (!output) {
 		return;
@@ -403,6 +412,12 @@ void wlr_output_destroy(struct wlr_output *output) {
 		wlr_output_cursor_destroy(cursor);
 	}
 
+	struct wlr_output_layer *layer, *tmp_layer;
+	wl_list_for_each_safe(layer, tmp_layer, &output->layers, link) {
+		wlr_output_layer_destroy(layer);
+	}
+
+	output_clear_cursor_cache(output);
 	wlr_swapchain_destroy(output->cursor_swapchain);
 	wlr_buffer_unlock(output->cursor_front_buffer);
 
@@ -557,6 +572,10 @@ static void output_clear_back_buffer(struct wlr_output *output) {
 }
 
 bool wlr_output_attach_render(struct wlr_output *output, int *buffer_age) {
+	if (output->timing != NULL) {
+		output_timing_handle_attach_render(output->timing);
+	}
+
 	if (output->impl->attach_render) {
 		if (!output->impl->attach_render(output, buffer_age)) {
 			return false;
@@ -619,6 +638,8 @@ static void output_state_clear(struct wlr_output_state *state) {
 	output_state_clear_buffer(state);
 	output_state_clear_gamma_lut(state);
 	pixman_region32_clear(&state->damage);
+	state->layers = NULL;
+	state->layers_len = 0;
 	state->committed = 0;
 }
 
@@ -680,6 +701,27 @@ static bool output_basic_test(struct wlr_output *output) {
 		}
 	}
 
+	if (output->pending.committed & WLR_OUTPUT_STATE_LAYERS) {
+		if (!(output->pending.committed & WLR_OUTPUT_STATE_BUFFER)) {
+			wlr_log(WLR_DEBUG, "Tried to commit layers without a buffer");
+			return false;
+		}
+
+		for (size_t i = 0; i < output->pending.layers_len; i++) {
+			struct wlr_output_layer *layer = output->pending.layers[i].layer;
+			if (layer->output != output) {
+				wlr_log(WLR_DEBUG, "Tried to commit a layer of another output");
+				return false;
+			}
+			for (size_t j = 0; j < i; j++) {
+				if (output->pending.layers[j].layer == layer) {
+					wlr_log(WLR_DEBUG, "Tried to commit a layer twice");
+					return false;
+				}
+			}
+		}
+	}
+
 	bool enabled = output->enabled;
 	if (output->pending.committed & WLR_OUTPUT_STATE_ENABLED) {
 		enabled = output->pending.enabled;
@@ -779,6 +821,19 @@ bool wlr_output_commit(struct wlr_output *output) {
 		wlr_output_schedule_done(output);
 	}
 
+	struct wlr_buffer *buffer = NULL;
+	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+		if (output->pending.buffer_type == WLR_OUTPUT_STATE_BUFFER_SCANOUT) {
+			buffer = wlr_buffer_lock(output->pending.buffer);
+		} else if (output->impl->get_render_buffer) {
+			struct wlr_buffer *render_buffer =
+				output->impl->get_render_buffer(output);
+			if (render_buffer != NULL) {
+				buffer = wlr_buffer_lock(render_buffer);
+			}
+		}
+	}
+
 	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
 		output->frame_pending = true;
 		output->needs_frame = false;
@@ -797,9 +852,12 @@ bool wlr_output_commit(struct wlr_output *output) {
 		.output = output,
 		.committed = committed,
 		.when = &now,
+		.buffer = buffer,
 	};
 	wlr_signal_emit_safe(&output->events.commit, &event);
 
+	wlr_buffer_unlock(buffer);
+
 	return true;
 }
 
@@ -822,8 +880,110 @@ void wlr_output_attach_buffer(struct wlr_output *output,
 	output->pending.buffer = wlr_buffer_lock(buffer);
 }
 
+static bool surface_covers_output(struct wlr_output *output,
+		struct wlr_surface *surface) {
+	enum wl_output_transform transform = output->transform;
+	if (output->pending.committed & WLR_OUTPUT_STATE_TRANSFORM) {
+		transform = output->pending.transform;
+	}
+	float scale = output->scale;
+	if (output->pending.committed & WLR_OUTPUT_STATE_SCALE) {
+		scale = output->pending.scale;
+	}
+
+	if (surface->current.transform != transform) {
+		return false;
+	}
+
+	int width, height;
+	output_pending_resolution(output, &width, &height);
+	struct wlr_buffer *buffer = &surface->buffer->base;
+	if (buffer->width != width || buffer->height != height) {
+		return false;
+	}
+
+	struct wlr_fbox src_box;
+	wlr_surface_get_buffer_source_box(surface, &src_box);
+	if (src_box.x != 0 || src_box.y != 0 ||
+			src_box.width != width || src_box.height != height) {
+		return false;
+	}
+
+	if (transform % 2 != 0) {
+		int tmp = width;
+		width = height;
+		height = tmp;
+	}
+	return round(surface->current.width * scale) == width &&
+		round(surface->current.height * scale) == height;
+}
+
+/**
+ * Check whether a primary plane with the given formats can scan out the
+ * buffer. Like the DRM backend, accept buffers whose alpha channel can be
+ * dropped to get a supported opaque format.
+ */
+static bool scanout_format_supported(const struct wlr_drm_format_set *formats,
+		const struct wlr_dmabuf_attributes *attribs) {
+	if (wlr_drm_format_set_has(formats, attribs->format, attribs->modifier)) {
+		return true;
+	}
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(attribs->format);
+	return info != NULL && info->opaque_substitute != DRM_FORMAT_INVALID &&
+		wlr_drm_format_set_has(formats, info->opaque_substitute,
+			attribs->modifier);
+}
+
+bool wlr_output_try_scanout_surface(struct wlr_output *output,
+		struct wlr_surface *surface) {
+	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+		wlr_log(WLR_ERROR, "Tried to scan out a surface while a buffer is "
+			"already attached");
+		return false;
+	}
+
+	struct wlr_output_scanout_stats *stats = &output->scanout_stats;
+	stats->attempts++;
+
+	struct wlr_dmabuf_attributes attribs;
+	if (surface->buffer == NULL ||
+			!wlr_buffer_get_dmabuf(&surface->buffer->base, &attribs)) {
+		stats->no_dmabuf++;
+		return false;
+	}
+
+	if (!surface_covers_output(output, surface)) {
+		stats->geometry_mismatch++;
+		return false;
+	}
+
+	if (output->impl->get_primary_formats) {
+		const struct wlr_drm_format_set *formats =
+			output->impl->get_primary_formats(output, WLR_BUFFER_CAP_DMABUF);
+		if (formats == NULL ||
+				!scanout_format_supported(formats, &attribs)) {
+			stats->unsupported_format++;
+			return false;
+		}
+	}
+
+	wlr_output_attach_buffer(output, &surface->buffer->base);
+	if (!wlr_output_test(output)) {
+		output_state_clear_buffer(&output->pending);
+		stats->test_failed++;
+		return false;
+	}
+
+	stats->successes++;
+	return true;
+}
+
 void wlr_output_send_frame(struct wlr_output *output) {
 	output->frame_pending = false;
+	if (output->timing != NULL) {
+		output_timing_handle_frame(output->timing);
+	}
 	wlr_signal_emit_safe(&output->events.frame, output);
 }
 
@@ -877,6 +1037,13 @@ void wlr_output_send_present(struct wlr_output *output,
 	wlr_signal_emit_safe(&output->events.present, event);
 }
 
+void wlr_output_record_commit_time(struct wlr_output *output,
+		const struct timespec *start, const struct timespec *end) {
+	if (output->timing != NULL) {
+		output_timing_record_commit(output->timing, start, end);
+	}
+}
+
 void wlr_output_set_gamma(struct wlr_output *output, size_t size,
 		const uint16_t *r, const uint16_t *g, const uint16_t *b) {
 	output_state_clear_gamma_lut(&output->pending);
@@ -1000,16 +1167,39 @@ static void output_scissor(struct wlr_output *output, pixman_box32_t *rect) {
 static void output_cursor_get_box(struct wlr_output_cursor *cursor,
 	struct wlr_box *box);
 
+/**
+ * Get the texture to draw for the cursor. The texture of an image set with
+ * wlr_output_cursor_set_image is only uploaded when it's first needed, so that
+ * cursors displayed from the hardware cursor buffer cache never upload it.
+ */
+static struct wlr_texture *output_cursor_get_texture(
+		struct wlr_output_cursor *cursor) {
+	if (cursor->surface != NULL) {
+		return wlr_surface_get_texture(cursor->surface);
+	}
+	if (cursor->texture == NULL && cursor->image_pixels != NULL) {
+		struct wlr_renderer *renderer =
+			wlr_backend_get_renderer(cursor->output->backend);
+		if (renderer == NULL) {
+			return NULL;
+		}
+		cursor->texture = wlr_texture_from_pixels(renderer,
+			DRM_FORMAT_ARGB8888, cursor->image_width * 4,
+			cursor->image_width, cursor->image_height, cursor->image_pixels);
+		if (cursor->texture == NULL) {
+			wlr_log(WLR_ERROR, "Failed to upload cursor texture");
+		}
+	}
+	return cursor->texture;
+}
+
 static void output_cursor_render(struct wlr_output_cursor *cursor,
 		pixman_region32_t *damage) {
 	struct wlr_renderer *renderer =
 		wlr_backend_get_renderer(cursor->output->backend);
 	assert(renderer);
 
-	struct wlr_texture *texture = cursor->texture;
-	if (cursor->surface != NULL) {
-		texture = wlr_surface_get_texture(cursor->surface);
-	}
+	struct wlr_texture *texture = output_cursor_get_texture(cursor);
 	if (texture == NULL) {
 		return;
 	}
@@ -1182,6 +1372,111 @@ static struct wlr_drm_format *output_pick_format(struct wlr_output *output,
 	return format;
 }
 
+struct output_cursor_image {
+	const uint8_t *pixels;
+	int32_t stride;
+	uint32_t width, height;
+	uint32_t hash;
+};
+
+struct output_cursor_cache_entry {
+	struct wl_list link; // wlr_output::cursor_buffer_cache
+	uint32_t width, height, hash;
+	uint8_t *pixels; // packed copy of the image, to rule out hash collisions
+	float scale;
+	enum wl_output_transform transform;
+	struct wlr_buffer *buffer;
+};
+
+static uint32_t cursor_image_hash(const uint8_t *pixels, int32_t stride,
+		uint32_t width, uint32_t height) {
+	// FNV-1a over whole ARGB8888 pixels
+	uint32_t hash = 2166136261u;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels + (size_t)y * stride;
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t px;
+			memcpy(&px, row + x * 4, sizeof(px));
+			hash = (hash ^ px) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+static bool cursor_cache_entry_matches(struct output_cursor_cache_entry *entry,
+		struct wlr_output *output, const struct output_cursor_image *image,
+		int buffer_width, int buffer_height) {
+	if (entry->hash != image->hash || entry->width != image->width ||
+			entry->height != image->height || entry->scale != output->scale ||
+			entry->transform != output->transform ||
+			entry->buffer->width != buffer_width ||
+			entry->buffer->height != buffer_height) {
+		return false;
+	}
+	size_t row_len = image->width * 4;
+	for (uint32_t y = 0; y < image->height; y++) {
+		if (memcmp(entry->pixels + y * row_len,
+				image->pixels + (size_t)y * image->stride, row_len) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void cursor_cache_entry_destroy(struct output_cursor_cache_entry *entry) {
+	wl_list_remove(&entry->link);
+	wlr_buffer_drop(entry->buffer);
+	free(entry->pixels);
+	free(entry);
+}
+
+static void output_clear_cursor_cache(struct wlr_output *output) {
+	struct output_cursor_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &output->cursor_buffer_cache, link) {
+		cursor_cache_entry_destroy(entry);
+	}
+}
+
+/**
+ * Adds a rendered cursor buffer to the cache, which takes ownership of the
+ * buffer and evicts the least recently used entry if it's full.
+ */
+static void output_add_cursor_cache_entry(struct wlr_output *output,
+		const struct output_cursor_image *image, struct wlr_buffer *buffer) {
+	struct output_cursor_cache_entry *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		wlr_buffer_drop(buffer);
+		return;
+	}
+	size_t row_len = image->width * 4;
+	entry->pixels = malloc(row_len * image->height);
+	if (entry->pixels == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(entry);
+		wlr_buffer_drop(buffer);
+		return;
+	}
+	for (uint32_t y = 0; y < image->height; y++) {
+		memcpy(entry->pixels + y * row_len,
+			image->pixels + (size_t)y * image->stride, row_len);
+	}
+	entry->width = image->width;
+	entry->height = image->height;
+	entry->hash = image->hash;
+	entry->scale = output->scale;
+	entry->transform = output->transform;
+	entry->buffer = buffer;
+	wl_list_insert(&output->cursor_buffer_cache, &entry->link);
+
+	if (wl_list_length(&output->cursor_buffer_cache) >
+			OUTPUT_CURSOR_CACHE_CAP) {
+		struct output_cursor_cache_entry *last = wl_container_of(
+			output->cursor_buffer_cache.prev, last, link);
+		cursor_cache_entry_destroy(last);
+	}
+}
+
 static struct wlr_drm_format *output_pick_cursor_format(struct wlr_output *output) {
 	struct wlr_allocator *allocator = backend_get_allocator(output->backend);
 	assert(allocator != NULL);
@@ -1199,18 +1494,33 @@ static struct wlr_drm_format *output_pick_cursor_format(struct wlr_output *outpu
 	return output_pick_format(output, display_formats);
 }
 
-static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor) {
+/**
+ * Renders the cursor into a buffer suitable for the cursor plane. If `image`
+ * is non-NULL, the result is looked up in and added to the output's cursor
+ * buffer cache.
+ */
+static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor,
+		struct output_cursor_image *image) {
 	struct wlr_output *output = cursor->output;
 
 	float scale = output->scale;
 	enum wl_output_transform transform = WL_OUTPUT_TRANSFORM_NORMAL;
-	struct wlr_texture *texture = cursor->texture;
+	struct wlr_texture *texture = NULL;
+	int src_width, src_height;
 	if (cursor->surface != NULL) {
 		texture = wlr_surface_get_texture(cursor->surface);
+		if (texture == NULL) {
+			return NULL;
+		}
 		scale = cursor->surface->current.scale;
 		transform = cursor->surface->current.transform;
-	}
-	if (texture == NULL) {
+		src_width = texture->width;
+		src_height = texture->height;
+	} else if (image != NULL) {
+		// The texture is only needed on a cache miss
+		src_width = image->width;
+		src_height = image->height;
+	} else {
 		return NULL;
 	}
 
@@ -1226,15 +1536,15 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 		return NULL;
 	}
 
-	int width = texture->width;
-	int height = texture->height;
+	int width = src_width;
+	int height = src_height;
 	if (output->impl->get_cursor_size) {
 		// Apply hardware limitations on buffer size
 		output->impl->get_cursor_size(cursor->output, &width, &height);
-		if ((int)texture->width > width || (int)texture->height > height) {
+		if (src_width > width || src_height > height) {
 			wlr_log(WLR_DEBUG, "Cursor texture too large (%dx%d), "
-				"exceeds hardware limitations (%dx%d)", texture->width,
-				texture->height, width, height);
+				"exceeds hardware limitations (%dx%d)", src_width,
+				src_height, width, height);
 			return NULL;
 		}
 	}
@@ -1249,6 +1559,8 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 			return NULL;
 		}
 
+		// Cached buffers have the size and format of the old swapchain
+		output_clear_cursor_cache(output);
 		wlr_swapchain_destroy(output->cursor_swapchain);
 		output->cursor_swapchain = wlr_swapchain_create(allocator,
 			width, height, format);
@@ -1258,15 +1570,53 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 		}
 	}
 
-	struct wlr_buffer *buffer =
-		wlr_swapchain_acquire(output->cursor_swapchain, NULL);
+	struct wlr_buffer *buffer = NULL;
+	if (image != NULL) {
+		image->hash = cursor_image_hash(image->pixels, image->stride,
+			image->width, image->height);
+		struct output_cursor_cache_entry *entry;
+		wl_list_for_each(entry, &output->cursor_buffer_cache, link) {
+			if (cursor_cache_entry_matches(entry, output, image,
+					width, height)) {
+				wl_list_remove(&entry->link);
+				wl_list_insert(&output->cursor_buffer_cache, &entry->link);
+				return wlr_buffer_lock(entry->buffer);
+			}
+		}
+
+		// Cached buffers are kept alive for a long time, so they can't come
+		// from the swapchain
+		buffer = wlr_allocator_create_buffer(allocator, width, height,
+			output->cursor_swapchain->format);
+		if (buffer == NULL) {
+			wlr_log(WLR_DEBUG, "Failed to allocate cursor buffer, "
+				"not caching it");
+			image = NULL;
+		} else {
+			wlr_buffer_lock(buffer);
+		}
+	}
 	if (buffer == NULL) {
-		return NULL;
+		buffer = wlr_swapchain_acquire(output->cursor_swapchain, NULL);
+		if (buffer == NULL) {
+			return NULL;
+		}
+	}
+
+	if (texture == NULL) {
+		texture = output_cursor_get_texture(cursor);
+		if (texture == NULL) {
+			wlr_buffer_unlock(buffer);
+			if (image != NULL) {
+				wlr_buffer_drop(buffer);
+			}
+			return NULL;
+		}
 	}
 
 	struct wlr_box cursor_box = {
-		.width = texture->width * output->scale / scale,
-		.height = texture->height * output->scale / scale,
+		.width = src_width * output->scale / scale,
+		.height = src_height * output->scale / scale,
 	};
 
 	float output_matrix[9];
@@ -1290,6 +1640,9 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 
 	if (!wlr_renderer_begin_with_buffer(renderer, buffer)) {
 		wlr_buffer_unlock(buffer);
+		if (image != NULL) {
+			wlr_buffer_drop(buffer);
+		}
 		return NULL;
 	}
 
@@ -1298,10 +1651,15 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 
 	wlr_renderer_end(renderer);
 
+	if (image != NULL) {
+		output_add_cursor_cache_entry(output, image, buffer);
+	}
+
 	return buffer;
 }
 
-static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
+static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor,
+		struct output_cursor_image *image) {
 	struct wlr_output *output = cursor->output;
 
 	if (!output->impl->set_cursor ||
@@ -1314,10 +1672,11 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 		return false;
 	}
 
-	struct wlr_texture *texture = cursor->texture;
+	// The image texture isn't uploaded here: it's only needed on a cache miss
+	bool has_image = cursor->image_pixels != NULL;
 	if (cursor->surface != NULL) {
 		// TODO: try using the surface buffer directly
-		texture = wlr_surface_get_texture(cursor->surface);
+		has_image = wlr_surface_get_texture(cursor->surface) != NULL;
 	}
 
 	// If the cursor was hidden or was a software cursor, the hardware
@@ -1326,8 +1685,8 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 		(int)cursor->x, (int)cursor->y);
 
 	struct wlr_buffer *buffer = NULL;
-	if (texture != NULL) {
-		buffer = render_cursor_buffer(cursor);
+	if (has_image) {
+		buffer = render_cursor_buffer(cursor, image);
 		if (buffer == NULL) {
 			wlr_log(WLR_ERROR, "Failed to render cursor buffer");
 			return false;
@@ -1377,16 +1736,39 @@ bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 	cursor->texture = NULL;
 
 	cursor->enabled = false;
+	struct output_cursor_image image = {0};
 	if (pixels != NULL) {
-		cursor->texture = wlr_texture_from_pixels(renderer,
-			DRM_FORMAT_ARGB8888, stride, width, height, pixels);
-		if (cursor->texture == NULL) {
+		// Keep a copy of the pixels: the texture is created lazily, when the
+		// cursor is drawn in software or the hardware cursor cache misses
+		size_t packed_stride = (size_t)width * 4;
+		uint8_t *image_pixels = realloc(cursor->image_pixels,
+			packed_stride * height);
+		if (image_pixels == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
 			return false;
 		}
+		for (uint32_t y = 0; y < height; y++) {
+			memcpy(image_pixels + y * packed_stride,
+				pixels + (size_t)y * stride, packed_stride);
+		}
+		cursor->image_pixels = image_pixels;
+		cursor->image_width = width;
+		cursor->image_height = height;
 		cursor->enabled = true;
+
+		image = (struct output_cursor_image){
+			.pixels = image_pixels,
+			.stride = packed_stride,
+			.width = width,
+			.height = height,
+		};
+	} else {
+		free(cursor->image_pixels);
+		cursor->image_pixels = NULL;
 	}
 
-	if (output_cursor_attempt_hardware(cursor)) {
+	if (output_cursor_attempt_hardware(cursor,
+			pixels != NULL ? &image : NULL)) {
 		return true;
 	}
 
@@ -1415,7 +1797,7 @@ static void output_cursor_commit(struct wlr_output_cursor *cursor,
 		cursor->hotspot_y -= surface->current.dy * cursor->output->scale;
 	}
 
-	if (output_cursor_attempt_hardware(cursor)) {
+	if (output_cursor_attempt_hardware(cursor, NULL)) {
 		return;
 	}
 
@@ -1556,6 +1938,7 @@ void wlr_output_cursor_destroy(struct wlr_output_cursor *cursor) {
 		cursor->output->hardware_cursor = NULL;
 	}
 	wlr_texture_destroy(cursor->texture);
+	free(cursor->image_pixels);
 	wl_list_remove(&cursor->link);
 	free(cursor);
 }
@@ -0,0 +1,37 @@
+#include <stdlib.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layer.h>
+#include <wlr/util/log.h>
+
+struct wlr_output_layer *wlr_output_layer_create(struct wlr_output *output) {
+	struct wlr_output_layer *layer = calloc(1, sizeof(*layer));
+	if (layer == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	layer->output = output;
+	wl_list_insert(output->layers.prev, &layer->link);
+
+	return layer;
+}
+
+void wlr_output_layer_destroy(struct wlr_output_layer *layer) {
+	if (layer == NULL) {
+		return;
+	}
+
+	wl_list_remove(&layer->link);
+	free(layer);
+}
+
+void wlr_output_set_layers(struct wlr_output *output,
+		struct wlr_output_layer_state *layers, size_t layers_len) {
+	for (size_t i = 0; i < layers_len; i++) {
+		layers[i].accepted = false;
+	}
+
+	output->pending.committed |= WLR_OUTPUT_STATE_LAYERS;
+	output->pending.layers = layers;
+	output->pending.layers_len = layers_len;
+}
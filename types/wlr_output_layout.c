@@ -2,14 +2,35 @@
 #include <float.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <sys/types.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
 #include "util/signal.h"
 
+/**
+ * The layout is indexed with a grid built from the edges of the output boxes.
+ * Each cell is covered by at most one output (the first one in the outputs
+ * list, if outputs overlap), so point queries are two binary searches.
+ */
+struct wlr_output_layout_index {
+	bool dirty;
+
+	struct wlr_output_layout_output **outputs; // in outputs list order
+	struct wlr_box *boxes;
+	size_t outputs_len, outputs_cap;
+
+	int *xs, *ys; // sorted, unique edges of the non-empty boxes
+	size_t xs_len, ys_len;
+	struct wlr_output_layout_output **cells; // (xs_len - 1) * (ys_len - 1)
+
+	struct wlr_box extents;
+};
+
 struct wlr_output_layout_state {
 	struct wlr_box _box; // should never be read directly, use the getter
+	struct wlr_output_layout_index index;
 };
 
 struct wlr_output_layout_output_state {
@@ -44,9 +65,18 @@ struct wlr_output_layout *wlr_output_layout_create(void) {
 	return layout;
 }
 
+static void output_layout_index_finish(struct wlr_output_layout_index *index) {
+	free(index->outputs);
+	free(index->boxes);
+	free(index->xs);
+	free(index->ys);
+	free(index->cells);
+}
+
 static void output_layout_output_destroy(
 		struct wlr_output_layout_output *l_output) {
 	wlr_signal_emit_safe(&l_output->events.destroy, l_output);
+	l_output->state->layout->state->index.dirty = true;
 	wlr_output_destroy_global(l_output->output);
 	wl_list_remove(&l_output->state->mode.link);
 	wl_list_remove(&l_output->state->commit.link);
@@ -68,6 +98,7 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 		output_layout_output_destroy(l_output);
 	}
 
+	output_layout_index_finish(&layout->state->index);
 	free(layout->state);
 	free(layout);
 }
@@ -83,6 +114,178 @@ static struct wlr_box *output_layout_output_get_box(
 	return &l_output->state->_box;
 }
 
+static int compare_int(const void *a, const void *b) {
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static size_t sort_unique(int *values, size_t len) {
+	if (len == 0) {
+		return 0;
+	}
+	qsort(values, len, sizeof(values[0]), compare_int);
+	size_t j = 1;
+	for (size_t i = 1; i < len; i++) {
+		if (values[i] != values[j - 1]) {
+			values[j++] = values[i];
+		}
+	}
+	return j;
+}
+
+/**
+ * Returns the index of the interval [edges[i], edges[i + 1]) containing v, or
+ * -1 if there is no such interval.
+ */
+static ssize_t find_interval(const int *edges, size_t len, double v) {
+	if (len < 2 || !(v >= edges[0]) || v >= edges[len - 1]) {
+		return -1;
+	}
+	size_t lo = 0, hi = len - 1;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (v >= edges[mid]) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static size_t find_edge(const int *edges, size_t len, int v) {
+	const int *edge = bsearch(&v, edges, len, sizeof(edges[0]), compare_int);
+	assert(edge != NULL);
+	return edge - edges;
+}
+
+static bool output_layout_index_build(struct wlr_output_layout_index *index,
+		struct wlr_output_layout *layout) {
+	size_t len = wl_list_length(&layout->outputs);
+	if (len > index->outputs_cap) {
+		struct wlr_output_layout_output **outputs =
+			realloc(index->outputs, len * sizeof(outputs[0]));
+		if (outputs == NULL) {
+			return false;
+		}
+		index->outputs = outputs;
+		struct wlr_box *boxes = realloc(index->boxes, len * sizeof(boxes[0]));
+		if (boxes == NULL) {
+			return false;
+		}
+		index->boxes = boxes;
+		int *xs = realloc(index->xs, 2 * len * sizeof(xs[0]));
+		if (xs == NULL) {
+			return false;
+		}
+		index->xs = xs;
+		int *ys = realloc(index->ys, 2 * len * sizeof(ys[0]));
+		if (ys == NULL) {
+			return false;
+		}
+		index->ys = ys;
+		index->outputs_cap = len;
+	}
+
+	int min_x = INT_MAX, min_y = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
+	size_t i = 0, edges_len = 0;
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_box *box = output_layout_output_get_box(l_output);
+		index->outputs[i] = l_output;
+		index->boxes[i] = *box;
+		i++;
+
+		if (box->x < min_x) {
+			min_x = box->x;
+		}
+		if (box->y < min_y) {
+			min_y = box->y;
+		}
+		if (box->x + box->width > max_x) {
+			max_x = box->x + box->width;
+		}
+		if (box->y + box->height > max_y) {
+			max_y = box->y + box->height;
+		}
+
+		if (wlr_box_empty(box)) {
+			continue;
+		}
+		index->xs[edges_len] = box->x;
+		index->xs[edges_len + 1] = box->x + box->width;
+		index->ys[edges_len] = box->y;
+		index->ys[edges_len + 1] = box->y + box->height;
+		edges_len += 2;
+	}
+	index->outputs_len = len;
+
+	if (len == 0) {
+		min_x = max_x = min_y = max_y = 0;
+	}
+	index->extents.x = min_x;
+	index->extents.y = min_y;
+	index->extents.width = max_x - min_x;
+	index->extents.height = max_y - min_y;
+
+	index->xs_len = sort_unique(index->xs, edges_len);
+	index->ys_len = sort_unique(index->ys, edges_len);
+
+	free(index->cells);
+	index->cells = NULL;
+	if (edges_len > 0) {
+		size_t cols = index->xs_len - 1, rows = index->ys_len - 1;
+		index->cells = calloc(cols * rows, sizeof(index->cells[0]));
+		if (index->cells == NULL) {
+			index->outputs_len = 0;
+			return false;
+		}
+
+		// Fill in reverse order, so that the first output wins on overlap
+		for (size_t j = len; j-- > 0;) {
+			const struct wlr_box *box = &index->boxes[j];
+			if (wlr_box_empty(box)) {
+				continue;
+			}
+			size_t x1 = find_edge(index->xs, index->xs_len, box->x);
+			size_t x2 = find_edge(index->xs, index->xs_len,
+				box->x + box->width);
+			size_t y1 = find_edge(index->ys, index->ys_len, box->y);
+			size_t y2 = find_edge(index->ys, index->ys_len,
+				box->y + box->height);
+			for (size_t y = y1; y < y2; y++) {
+				for (size_t x = x1; x < x2; x++) {
+					index->cells[y * cols + x] = index->outputs[j];
+				}
+			}
+		}
+	}
+
+	index->dirty = false;
+	return true;
+}
+
+static struct wlr_output_layout_index *output_layout_get_index(
+		struct wlr_output_layout *layout) {
+	struct wlr_output_layout_index *index = &layout->state->index;
+	if (index->dirty && !output_layout_index_build(index, layout)) {
+		wlr_log_errno(WLR_ERROR, "Failed to build output layout index");
+		// The index is empty, retry on next use
+		index->outputs_len = index->xs_len = index->ys_len = 0;
+	}
+	return index;
+}
+
+static struct wlr_output_layout_output *output_layout_index_output_at(
+		struct wlr_output_layout_index *index, double lx, double ly) {
+	ssize_t x = find_interval(index->xs, index->xs_len, lx);
+	ssize_t y = find_interval(index->ys, index->ys_len, ly);
+	if (x < 0 || y < 0) {
+		return NULL;
+	}
+	return index->cells[y * (index->xs_len - 1) + x];
+}
+
 /**
  * This must be called whenever the layout changes to reconfigure the auto
  * configured outputs and emit the `changed` event.
@@ -125,6 +328,9 @@ static void output_layout_reconfigure(struct wlr_output_layout *layout) {
 		max_x += box->width;
 	}
 
+	layout->state->index.dirty = true;
+	output_layout_get_index(layout);
+
 	wlr_signal_emit_safe(&layout->events.change, layout);
 }
 
@@ -179,6 +385,7 @@ static struct wlr_output_layout_output *output_layout_output_create(
 	l_output->output = output;
 	wl_signal_init(&l_output->events.destroy);
 	wl_list_insert(&layout->outputs, &l_output->link);
+	layout->state->index.dirty = true;
 
 	wl_signal_add(&output->events.mode, &l_output->state->mode);
 	l_output->state->mode.notify = handle_output_mode;
@@ -242,11 +449,10 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	struct wlr_box out_box;
 
 	if (reference == NULL) {
-		struct wlr_output_layout_output *l_output;
-		wl_list_for_each(l_output, &layout->outputs, link) {
-			struct wlr_box *output_box =
-				output_layout_output_get_box(l_output);
-			if (wlr_box_intersection(&out_box, output_box, target_lbox)) {
+		struct wlr_output_layout_index *index = output_layout_get_index(layout);
+		for (size_t i = 0; i < index->outputs_len; i++) {
+			if (wlr_box_intersection(&out_box, &index->boxes[i],
+					target_lbox)) {
 				return true;
 			}
 		}
@@ -265,14 +471,9 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 
 struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
 		double lx, double ly) {
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		struct wlr_box *box = output_layout_output_get_box(l_output);
-		if (wlr_box_contains_point(box, lx, ly)) {
-			return l_output->output;
-		}
-	}
-	return NULL;
+	struct wlr_output_layout_output *l_output = output_layout_index_output_at(
+		output_layout_get_index(layout), lx, ly);
+	return l_output != NULL ? l_output->output : NULL;
 }
 
 void wlr_output_layout_move(struct wlr_output_layout *layout,
@@ -315,6 +516,19 @@ void wlr_output_layout_output_coords(struct wlr_output_layout *layout,
 	}
 }
 
+static double output_layout_box_closest_point(const struct wlr_box *box,
+		double lx, double ly, double *dest_lx, double *dest_ly) {
+	wlr_box_closest_point(box, lx, ly, dest_lx, dest_ly);
+
+	// calculate squared distance suitable for comparison
+	double distance = (lx - *dest_lx) * (lx - *dest_lx) +
+		(ly - *dest_ly) * (ly - *dest_ly);
+	if (!isfinite(distance)) {
+		distance = DBL_MAX;
+	}
+	return distance;
+}
+
 void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		struct wlr_output *reference, double lx, double ly, double *dest_lx,
 		double *dest_ly) {
@@ -322,29 +536,29 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		return;
 	}
 
-	double min_x = 0, min_y = 0, min_distance = DBL_MAX;
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		if (reference != NULL && reference != l_output->output) {
-			continue;
-		}
-
-		double output_x, output_y, output_distance;
-		struct wlr_box *box = output_layout_output_get_box(l_output);
-		wlr_box_closest_point(box, lx, ly, &output_x, &output_y);
-
-		// calculate squared distance suitable for comparison
-		output_distance =
-			(lx - output_x) * (lx - output_x) + (ly - output_y) * (ly - output_y);
+	struct wlr_output_layout_index *index = output_layout_get_index(layout);
 
-		if (!isfinite(output_distance)) {
-			output_distance = DBL_MAX;
-		}
+	double min_x = 0, min_y = 0, min_distance = DBL_MAX;
+	if (reference == NULL &&
+			output_layout_index_output_at(index, lx, ly) != NULL) {
+		// the point is already in the layout
+		min_x = lx;
+		min_y = ly;
+	} else {
+		for (size_t i = 0; i < index->outputs_len; i++) {
+			if (reference != NULL &&
+					reference != index->outputs[i]->output) {
+				continue;
+			}
 
-		if (output_distance < min_distance) {
-			min_x = output_x;
-			min_y = output_y;
-			min_distance = output_distance;
+			double output_x, output_y;
+			double output_distance = output_layout_box_closest_point(
+				&index->boxes[i], lx, ly, &output_x, &output_y);
+			if (output_distance < min_distance) {
+				min_x = output_x;
+				min_y = output_y;
+				min_distance = output_distance;
+			}
 		}
 	}
 
@@ -370,32 +584,7 @@ struct wlr_box *wlr_output_layout_get_box(
 		}
 	} else {
 		// layout extents
-		int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
-		if (!wl_list_empty(&layout->outputs)) {
-			min_x = min_y = INT_MAX;
-			max_x = max_y = INT_MIN;
-			wl_list_for_each(l_output, &layout->outputs, link) {
-				struct wlr_box *box = output_layout_output_get_box(l_output);
-				if (box->x < min_x) {
-					min_x = box->x;
-				}
-				if (box->y < min_y) {
-					min_y = box->y;
-				}
-				if (box->x + box->width > max_x) {
-					max_x = box->x + box->width;
-				}
-				if (box->y + box->height > max_y) {
-					max_y = box->y + box->height;
-				}
-			}
-		}
-
-		layout->state->_box.x = min_x;
-		layout->state->_box.y = min_y;
-		layout->state->_box.width = max_x - min_x;
-		layout->state->_box.height = max_y - min_y;
-
+		layout->state->_box = output_layout_get_index(layout)->extents;
 		return &layout->state->_box;
 	}
 
@@ -453,15 +642,24 @@ static struct wlr_output *wlr_output_layout_output_in_direction(
 	assert(reference);
 
 	struct wlr_box *ref_box = wlr_output_layout_get_box(layout, reference);
+	if (ref_box == NULL) {
+		return NULL;
+	}
+
+	struct wlr_output_layout_index *index = output_layout_get_index(layout);
 
 	double min_distance = (distance_method == NEAREST) ? DBL_MAX : DBL_MIN;
 	struct wlr_output *closest_output = NULL;
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
+	for (size_t i = 0; i < index->outputs_len; i++) {
+		struct wlr_output_layout_output *l_output = index->outputs[i];
 		if (reference != NULL && reference == l_output->output) {
 			continue;
 		}
-		struct wlr_box *box = output_layout_output_get_box(l_output);
+		const struct wlr_box *box = &index->boxes[i];
+		if (wlr_box_empty(box)) {
+			// disabled outputs can't be reached
+			continue;
+		}
 
 		bool match = false;
 		// test to make sure this output is in the given direction
@@ -483,10 +681,8 @@ static struct wlr_output *wlr_output_layout_output_in_direction(
 
 		// calculate distance from the given reference point
 		double x, y;
-		wlr_output_layout_closest_point(layout, l_output->output,
+		double distance = output_layout_box_closest_point(box,
 			ref_lx, ref_ly, &x, &y);
-		double distance =
-			(x - ref_lx) * (x - ref_lx) + (y - ref_ly) * (y - ref_ly);
 
 		if ((distance_method == NEAREST)
 				? distance < min_distance
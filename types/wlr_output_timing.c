@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/backend.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_timing.h>
+#include <wlr/util/log.h>
+#include "types/wlr_output.h"
+#include "util/signal.h"
+
+// Number of recent frames for which pending GPU render times are fetched
+#define GPU_RENDER_TIME_LOOKBACK 8
+
+static bool timespec_is_set(const struct timespec *ts) {
+	return ts->tv_sec != 0 || ts->tv_nsec != 0;
+}
+
+static struct wlr_renderer *timing_get_renderer(
+		struct wlr_output_timing *timing) {
+	return wlr_backend_get_renderer(timing->output->backend);
+}
+
+void output_timing_handle_frame(struct wlr_output_timing *timing) {
+	clock_gettime(CLOCK_MONOTONIC, &timing->pending.frame);
+}
+
+void output_timing_handle_attach_render(struct wlr_output_timing *timing) {
+	clock_gettime(CLOCK_MONOTONIC, &timing->pending.render_begin);
+
+	struct wlr_renderer *renderer = timing_get_renderer(timing);
+	if (renderer != NULL) {
+		timing->render_seq_start = renderer->render_seq;
+	}
+}
+
+void output_timing_record_commit(struct wlr_output_timing *timing,
+		const struct timespec *start, const struct timespec *end) {
+	timing->pending.commit_begin = *start;
+	timing->pending.commit_end = *end;
+}
+
+static void handle_output_precommit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output_timing *timing =
+		wl_container_of(listener, timing, output_precommit);
+	const struct wlr_output_event_precommit *event = data;
+
+	if (!(timing->output->pending.committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	timing->pending.render_end = *event->when;
+
+	// The frame was rendered by us if a render pass was started after
+	// wlr_output_attach_render()
+	struct wlr_renderer *renderer = timing_get_renderer(timing);
+	if (renderer != NULL &&
+			timespec_is_set(&timing->pending.render_begin) &&
+			renderer->render_seq != timing->render_seq_start) {
+		timing->pending.render_seq = renderer->render_seq;
+	}
+}
+
+static void handle_output_commit(struct wl_listener *listener, void *data) {
+	struct wlr_output_timing *timing =
+		wl_container_of(listener, timing, output_commit);
+	const struct wlr_output_event_commit *event = data;
+
+	if (!(event->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	struct wlr_output_frame_timing *frame =
+		&timing->history[timing->history_next];
+	*frame = timing->pending;
+	frame->commit_seq = timing->output->commit_seq;
+
+	timing->history_next =
+		(timing->history_next + 1) % WLR_OUTPUT_TIMING_HISTORY_LEN;
+	if (timing->history_len < WLR_OUTPUT_TIMING_HISTORY_LEN) {
+		timing->history_len++;
+	}
+
+	memset(&timing->pending, 0, sizeof(timing->pending));
+}
+
+static struct wlr_output_frame_timing *get_frame(
+		struct wlr_output_timing *timing, size_t age) {
+	if (age >= timing->history_len) {
+		return NULL;
+	}
+	size_t i = (timing->history_next + WLR_OUTPUT_TIMING_HISTORY_LEN - 1 -
+		age) % WLR_OUTPUT_TIMING_HISTORY_LEN;
+	return &timing->history[i];
+}
+
+/**
+ * Fetch the GPU render times which have become available. Only the most
+ * recent frames are checked, older render passes are discarded by the
+ * renderer anyways.
+ */
+static void update_gpu_render_times(struct wlr_output_timing *timing) {
+	struct wlr_renderer *renderer = timing_get_renderer(timing);
+	if (renderer == NULL) {
+		return;
+	}
+
+	for (size_t age = 0; age < GPU_RENDER_TIME_LOOKBACK; age++) {
+		struct wlr_output_frame_timing *frame = get_frame(timing, age);
+		if (frame == NULL) {
+			break;
+		}
+		if (frame->render_seq == 0 || frame->has_gpu_render_time) {
+			continue;
+		}
+		frame->has_gpu_render_time = wlr_renderer_get_render_time(renderer,
+			frame->render_seq, &frame->gpu_render_ns);
+	}
+}
+
+static void handle_output_present(struct wl_listener *listener, void *data) {
+	struct wlr_output_timing *timing =
+		wl_container_of(listener, timing, output_present);
+	const struct wlr_output_event_present *event = data;
+
+	for (size_t age = 0; age < timing->history_len; age++) {
+		struct wlr_output_frame_timing *frame = get_frame(timing, age);
+		if (frame->commit_seq == event->commit_seq) {
+			frame->present = *event->when;
+			break;
+		}
+	}
+
+	update_gpu_render_times(timing);
+}
+
+static void handle_output_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_output_timing *timing =
+		wl_container_of(listener, timing, output_destroy);
+	wlr_output_timing_destroy(timing);
+}
+
+struct wlr_output_timing *wlr_output_timing_create(struct wlr_output *output) {
+	if (output->timing != NULL) {
+		wlr_log(WLR_ERROR, "Output %s already has frame timing enabled",
+			output->name);
+		return NULL;
+	}
+
+	struct wlr_output_timing *timing = calloc(1, sizeof(*timing));
+	if (timing == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	timing->output = output;
+
+	wl_signal_init(&timing->events.destroy);
+
+	timing->output_precommit.notify = handle_output_precommit;
+	wl_signal_add(&output->events.precommit, &timing->output_precommit);
+	timing->output_commit.notify = handle_output_commit;
+	wl_signal_add(&output->events.commit, &timing->output_commit);
+	timing->output_present.notify = handle_output_present;
+	wl_signal_add(&output->events.present, &timing->output_present);
+	timing->output_destroy.notify = handle_output_destroy;
+	wl_signal_add(&output->events.destroy, &timing->output_destroy);
+
+	output->timing = timing;
+
+	return timing;
+}
+
+void wlr_output_timing_destroy(struct wlr_output_timing *timing) {
+	if (timing == NULL) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&timing->events.destroy, timing);
+
+	assert(timing->output->timing == timing);
+	timing->output->timing = NULL;
+
+	wl_list_remove(&timing->output_precommit.link);
+	wl_list_remove(&timing->output_commit.link);
+	wl_list_remove(&timing->output_present.link);
+	wl_list_remove(&timing->output_destroy.link);
+	free(timing);
+}
+
+const struct wlr_output_frame_timing *wlr_output_timing_get_frame(
+		struct wlr_output_timing *timing, size_t age) {
+	update_gpu_render_times(timing);
+	return get_frame(timing, age);
+}
+
+static double timespec_to_usec(const struct timespec *ts) {
+	return (double)ts->tv_sec * 1000000 + (double)ts->tv_nsec / 1000;
+}
+
+static bool write_span(FILE *f, const char *name,
+		const struct timespec *begin, const struct timespec *end,
+		const struct wlr_output_frame_timing *frame) {
+	if (!timespec_is_set(begin) || !timespec_is_set(end)) {
+		return false;
+	}
+	double ts = timespec_to_usec(begin);
+	double dur = timespec_to_usec(end) - ts;
+	if (dur < 0) {
+		return false;
+	}
+
+	// The args object is left open, so that the caller can add to it
+	fprintf(f, ",\n\t\t{\"name\": \"%s\", \"cat\": \"frame\", \"ph\": \"X\", "
+		"\"pid\": 0, \"tid\": 0, \"ts\": %.3f, \"dur\": %.3f, "
+		"\"args\": {\"commit_seq\": %"PRIu32,
+		name, ts, dur, frame->commit_seq);
+	return true;
+}
+
+static void write_instant(FILE *f, const char *name,
+		const struct timespec *when,
+		const struct wlr_output_frame_timing *frame) {
+	if (!timespec_is_set(when)) {
+		return;
+	}
+
+	fprintf(f, ",\n\t\t{\"name\": \"%s\", \"cat\": \"frame\", \"ph\": \"i\", "
+		"\"s\": \"t\", \"pid\": 0, \"tid\": 0, \"ts\": %.3f, "
+		"\"args\": {\"commit_seq\": %"PRIu32"}}",
+		name, timespec_to_usec(when), frame->commit_seq);
+}
+
+bool wlr_output_timing_write_trace(struct wlr_output_timing *timing,
+		FILE *f) {
+	update_gpu_render_times(timing);
+
+	// Output names are generated by backends, they don't need escaping
+	fprintf(f, "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [");
+	fprintf(f, "\n\t\t{\"name\": \"thread_name\", \"ph\": \"M\", "
+		"\"pid\": 0, \"tid\": 0, \"args\": {\"name\": \"%s\"}}",
+		timing->output->name);
+
+	for (size_t age = timing->history_len; age-- > 0;) {
+		const struct wlr_output_frame_timing *frame = get_frame(timing, age);
+		write_instant(f, "frame", &frame->frame, frame);
+		if (write_span(f, "render", &frame->render_begin,
+				&frame->render_end, frame)) {
+			if (frame->has_gpu_render_time) {
+				fprintf(f, ", \"gpu_render_us\": %.3f",
+					(double)frame->gpu_render_ns / 1000);
+			}
+			fprintf(f, "}}");
+		}
+		if (write_span(f, "commit", &frame->commit_begin,
+				&frame->commit_end, frame)) {
+			fprintf(f, "}}");
+		}
+		if (write_span(f, "latency", &frame->render_end,
+				&frame->present, frame)) {
+			fprintf(f, "}}");
+		}
+		write_instant(f, "present", &frame->present, frame);
+	}
+
+	fprintf(f, "\n\t]\n}\n");
+	return !ferror(f);
+}
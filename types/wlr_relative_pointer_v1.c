@@ -8,6 +8,7 @@
 #include <wlr/types/wlr_seat.h>
 #include <wlr/util/log.h>
 #include "relative-pointer-unstable-v1-protocol.h"
+#include "types/wlr_seat.h"
 
 #define RELATIVE_POINTER_MANAGER_VERSION 1
 
@@ -42,6 +43,7 @@ static void relative_pointer_destroy(struct wlr_relative_pointer_v1 *relative_po
 
 	wl_list_remove(&relative_pointer->link);
 	wl_list_remove(&relative_pointer->seat_destroy.link);
+	wl_list_remove(&relative_pointer->seat_motion_flush.link);
 	wl_list_remove(&relative_pointer->pointer_destroy.link);
 
 	wl_resource_set_user_data(relative_pointer->resource, NULL);
@@ -76,6 +78,31 @@ static void relative_pointer_handle_seat_destroy(struct wl_listener *listener,
 	relative_pointer_destroy(relative_pointer);
 }
 
+static void relative_pointer_send_motion(
+		struct wlr_relative_pointer_v1 *relative_pointer, uint64_t time_usec,
+		double dx, double dy, double dx_unaccel, double dy_unaccel) {
+	zwp_relative_pointer_v1_send_relative_motion(relative_pointer->resource,
+		(uint32_t)(time_usec >> 32), (uint32_t)time_usec,
+		wl_fixed_from_double(dx), wl_fixed_from_double(dy),
+		wl_fixed_from_double(dx_unaccel), wl_fixed_from_double(dy_unaccel));
+}
+
+static void relative_pointer_handle_seat_motion_flush(
+		struct wl_listener *listener, void *data) {
+	struct wlr_relative_pointer_v1 *relative_pointer =
+		wl_container_of(listener, relative_pointer, seat_motion_flush);
+	if (!relative_pointer->motion_pending) {
+		return;
+	}
+	relative_pointer->motion_pending = false;
+
+	relative_pointer_send_motion(relative_pointer,
+		relative_pointer->motion_time_usec,
+		relative_pointer->motion_dx, relative_pointer->motion_dy,
+		relative_pointer->motion_dx_unaccel,
+		relative_pointer->motion_dy_unaccel);
+}
+
 static void relative_pointer_handle_pointer_destroy(struct wl_listener *listener,
 		void *data) {
 	struct wlr_relative_pointer_v1 *relative_pointer =
@@ -135,6 +162,11 @@ static void relative_pointer_manager_v1_handle_get_relative_pointer(struct wl_cl
 			&relative_pointer->seat_destroy);
 	relative_pointer->seat_destroy.notify = relative_pointer_handle_seat_destroy;
 
+	wl_signal_add(&relative_pointer->seat->pointer_state.events.motion_flush,
+			&relative_pointer->seat_motion_flush);
+	relative_pointer->seat_motion_flush.notify =
+		relative_pointer_handle_seat_motion_flush;
+
 	wl_resource_add_destroy_listener(relative_pointer->pointer_resource,
 			&relative_pointer->pointer_destroy);
 	relative_pointer->pointer_destroy.notify = relative_pointer_handle_pointer_destroy;
@@ -226,6 +258,7 @@ void wlr_relative_pointer_manager_v1_send_relative_motion(
 		return;
 	}
 
+	bool coalesce = seat->pointer_state.coalesce_output != NULL;
 	struct wlr_relative_pointer_v1 *pointer;
 	wl_list_for_each(pointer, &manager->relative_pointers, link) {
 		struct wlr_seat_client *seat_client =
@@ -234,9 +267,25 @@ void wlr_relative_pointer_manager_v1_send_relative_motion(
 			continue;
 		}
 
-		zwp_relative_pointer_v1_send_relative_motion(pointer->resource,
-			(uint32_t)(time_usec >> 32), (uint32_t)time_usec,
-			wl_fixed_from_double(dx), wl_fixed_from_double(dy),
-			wl_fixed_from_double(dx_unaccel), wl_fixed_from_double(dy_unaccel));
+		if (!coalesce) {
+			relative_pointer_send_motion(pointer, time_usec, dx, dy,
+				dx_unaccel, dy_unaccel);
+			continue;
+		}
+
+		if (!pointer->motion_pending) {
+			pointer->motion_pending = true;
+			pointer->motion_dx = pointer->motion_dy = 0;
+			pointer->motion_dx_unaccel = pointer->motion_dy_unaccel = 0;
+		}
+		pointer->motion_time_usec = time_usec;
+		pointer->motion_dx += dx;
+		pointer->motion_dy += dy;
+		pointer->motion_dx_unaccel += dx_unaccel;
+		pointer->motion_dy_unaccel += dy_unaccel;
+	}
+
+	if (coalesce) {
+		seat_pointer_defer_motion(seat);
 	}
 }
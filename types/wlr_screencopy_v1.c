@@ -10,9 +10,12 @@
 #include <wlr/util/log.h>
 #include "wlr-screencopy-unstable-v1-protocol.h"
 #include "render/pixel_format.h"
+#include "render/wlr_texture.h"
 #include "util/signal.h"
 
 #define SCREENCOPY_MANAGER_VERSION 3
+// Maximum number of client DMA-BUFs tracked per client and output
+#define BLIT_TARGETS_CAP 4
 
 struct screencopy_damage {
 	struct wl_list link;
@@ -21,6 +24,18 @@ struct screencopy_damage {
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
 	uint32_t last_commit_seq;
+	struct wl_list blit_targets; // screencopy_blit_target.link
+};
+
+/**
+ * A client DMA-BUF previously filled with the output contents. Only the
+ * damage accumulated since then needs to be copied again.
+ */
+struct screencopy_blit_target {
+	struct wl_list link; // most recently used first
+	struct wlr_buffer *buffer;
+	pixman_region32_t damage;
+	struct wl_listener buffer_destroy;
 };
 
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
@@ -50,21 +65,81 @@ static void screencopy_damage_accumulate(struct screencopy_damage *damage) {
 		return;
 	}
 
+	pixman_region32_t commit_damage;
+	pixman_region32_init(&commit_damage);
 	if (output->pending.committed & WLR_OUTPUT_STATE_DAMAGE) {
 		// If the compositor submitted damage, copy it over
-		pixman_region32_union(region, region, &output->pending.damage);
-		pixman_region32_intersect_rect(region, region, 0, 0,
-			output->width, output->height);
+		pixman_region32_intersect_rect(&commit_damage,
+			&output->pending.damage, 0, 0, output->width, output->height);
 	} else if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
 		// If the compositor did not submit damage but did submit a buffer
 		// damage everything
-		pixman_region32_union_rect(region, region, 0, 0,
+		pixman_region32_union_rect(&commit_damage, &commit_damage, 0, 0,
 			output->width, output->height);
 	}
 
+	pixman_region32_union(region, region, &commit_damage);
+	struct screencopy_blit_target *target;
+	wl_list_for_each(target, &damage->blit_targets, link) {
+		pixman_region32_union(&target->damage, &target->damage,
+			&commit_damage);
+	}
+	pixman_region32_fini(&commit_damage);
+
 	damage->last_commit_seq = output->commit_seq;
 }
 
+static void blit_target_destroy(struct screencopy_blit_target *target) {
+	wl_list_remove(&target->link);
+	wl_list_remove(&target->buffer_destroy.link);
+	pixman_region32_fini(&target->damage);
+	free(target);
+}
+
+static void blit_target_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct screencopy_blit_target *target =
+		wl_container_of(listener, target, buffer_destroy);
+	blit_target_destroy(target);
+}
+
+/**
+ * Get the blit target for a client buffer, creating it if necessary. New
+ * targets are fully damaged.
+ */
+static struct screencopy_blit_target *blit_target_get_or_create(
+		struct screencopy_damage *damage, struct wlr_buffer *buffer) {
+	struct screencopy_blit_target *target;
+	size_t len = 0;
+	wl_list_for_each(target, &damage->blit_targets, link) {
+		if (target->buffer == buffer) {
+			wl_list_remove(&target->link);
+			wl_list_insert(&damage->blit_targets, &target->link);
+			return target;
+		}
+		len++;
+	}
+
+	if (len >= BLIT_TARGETS_CAP) {
+		struct screencopy_blit_target *lru =
+			wl_container_of(damage->blit_targets.prev, lru, link);
+		blit_target_destroy(lru);
+	}
+
+	target = calloc(1, sizeof(*target));
+	if (target == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	target->buffer = buffer;
+	pixman_region32_init_rect(&target->damage, 0, 0,
+		damage->output->width, damage->output->height);
+	target->buffer_destroy.notify = blit_target_handle_buffer_destroy;
+	wl_signal_add(&buffer->events.destroy, &target->buffer_destroy);
+	wl_list_insert(&damage->blit_targets, &target->link);
+	return target;
+}
+
 static void screencopy_damage_handle_output_precommit(
 		struct wl_listener *listener, void *data) {
 	struct screencopy_damage *damage =
@@ -73,6 +148,10 @@ static void screencopy_damage_handle_output_precommit(
 }
 
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	struct screencopy_blit_target *target, *tmp_target;
+	wl_list_for_each_safe(target, tmp_target, &damage->blit_targets, link) {
+		blit_target_destroy(target);
+	}
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -101,6 +180,7 @@ static struct screencopy_damage *screencopy_damage_create(
 	pixman_region32_init_rect(&damage->damage, 0, 0, output->width,
 		output->height);
 	wl_list_insert(&client->damages, &damage->link);
+	wl_list_init(&damage->blit_targets);
 
 	wl_signal_add(&output->events.precommit, &damage->output_precommit);
 	damage->output_precommit.notify =
@@ -158,36 +238,53 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 	wl_list_remove(&frame->output_destroy.link);
 	wl_list_remove(&frame->output_enable.link);
 	wl_list_remove(&frame->buffer_destroy.link);
+	if (frame->readback_source != NULL) {
+		wl_event_source_remove(frame->readback_source);
+	}
+	wlr_readback_destroy(frame->readback);
 	// Make the frame resource inert
 	wl_resource_set_user_data(frame->resource, NULL);
 	client_unref(frame->client);
 	free(frame);
 }
 
-static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame) {
+/**
+ * Get the extents of the damage accumulated since the client's last frame,
+ * and reset it. Returns false if the frame doesn't track damage.
+ */
+static bool frame_take_damage(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_box *box) {
 	if (!frame->with_damage) {
-		return;
+		return false;
 	}
 
 	struct screencopy_damage *damage =
 		screencopy_damage_get_or_create(frame->client, frame->output);
 	if (damage == NULL) {
-		return;
+		return false;
 	}
 
 	// TODO: send fine-grained damage events
 	struct pixman_box32 *damage_box =
 		pixman_region32_extents(&damage->damage);
 
-	int damage_x = damage_box->x1;
-	int damage_y = damage_box->y1;
-	int damage_width = damage_box->x2 - damage_box->x1;
-	int damage_height = damage_box->y2 - damage_box->y1;
-
-	zwlr_screencopy_frame_v1_send_damage(frame->resource,
-		damage_x, damage_y, damage_width, damage_height);
+	box->x = damage_box->x1;
+	box->y = damage_box->y1;
+	box->width = damage_box->x2 - damage_box->x1;
+	box->height = damage_box->y2 - damage_box->y1;
 
 	pixman_region32_clear(&damage->damage);
+	return true;
+}
+
+static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame) {
+	struct wlr_box box;
+	if (!frame_take_damage(frame, &box)) {
+		return;
+	}
+
+	zwlr_screencopy_frame_v1_send_damage(frame->resource,
+		box.x, box.y, box.width, box.height);
 }
 
 static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
@@ -199,6 +296,81 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
+static int frame_handle_readback_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_screencopy_frame_v1 *frame = data;
+
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		// Finishing the read-back waits for the GPU if it isn't done yet
+		wlr_log(WLR_DEBUG, "Failed to wait for read-back fence");
+	}
+
+	struct wl_shm_buffer *shm_buffer = frame->shm_buffer;
+	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
+
+	wl_shm_buffer_begin_access(shm_buffer);
+	void *shm_data = wl_shm_buffer_get_data(shm_buffer);
+	uint32_t renderer_flags = 0;
+	bool ok = wlr_readback_finish(frame->readback, &renderer_flags,
+		stride, 0, 0, shm_data);
+	uint32_t flags = renderer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT ?
+		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
+	wl_shm_buffer_end_access(shm_buffer);
+
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to read pixels from renderer");
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+		frame_destroy(frame);
+		return 0;
+	}
+
+	zwlr_screencopy_frame_v1_send_flags(frame->resource, flags);
+	if (frame->readback_has_damage) {
+		struct wlr_box *box = &frame->readback_damage;
+		zwlr_screencopy_frame_v1_send_damage(frame->resource,
+			box->x, box->y, box->width, box->height);
+	}
+	frame_send_ready(frame, &frame->readback_when);
+	frame_destroy(frame);
+	return 0;
+}
+
+/**
+ * Start copying the output's pixels into the shm buffer in the background.
+ * The frame is completed by frame_handle_readback_fence() once the GPU is
+ * done. Returns false if asynchronous read-back isn't available.
+ */
+static bool frame_start_readback(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_renderer *renderer, uint32_t drm_format,
+		struct timespec *when) {
+	struct wl_shm_buffer *shm_buffer = frame->shm_buffer;
+	int32_t width = wl_shm_buffer_get_width(shm_buffer);
+	int32_t height = wl_shm_buffer_get_height(shm_buffer);
+
+	frame->readback = wlr_renderer_read_pixels_async(renderer, drm_format,
+		width, height, frame->box.x, frame->box.y);
+	if (frame->readback == NULL) {
+		return false;
+	}
+
+	int fence_fd = wlr_readback_get_fence_fd(frame->readback);
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(frame->output->display);
+	if (fence_fd >= 0) {
+		frame->readback_source = wl_event_loop_add_fd(loop, fence_fd,
+			WL_EVENT_READABLE, frame_handle_readback_fence, frame);
+	}
+	if (frame->readback_source == NULL) {
+		wlr_readback_destroy(frame->readback);
+		frame->readback = NULL;
+		return false;
+	}
+
+	frame->readback_when = *when;
+	frame->readback_has_damage =
+		frame_take_damage(frame, &frame->readback_damage);
+	return true;
+}
+
 static void frame_handle_output_precommit(struct wl_listener *listener,
 		void *_data) {
 	struct wlr_screencopy_frame_v1 *frame =
@@ -236,6 +408,13 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 
 	enum wl_shm_format wl_shm_format = wl_shm_buffer_get_format(shm_buffer);
 	uint32_t drm_format = convert_wl_shm_format_to_drm(wl_shm_format);
+
+	// Don't block the output commit on the GPU if we can avoid it: the frame
+	// will be ready a little later
+	if (frame_start_readback(frame, renderer, drm_format, event->when)) {
+		return;
+	}
+
 	int32_t width = wl_shm_buffer_get_width(shm_buffer);
 	int32_t height = wl_shm_buffer_get_height(shm_buffer);
 	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
@@ -264,36 +443,121 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 
 static bool blit_dmabuf(struct wlr_renderer *renderer,
 		struct wlr_dmabuf_v1_buffer *dst_dmabuf,
-		struct wlr_dmabuf_attributes *src_attrs) {
+		struct wlr_texture *src_tex, pixman_region32_t *damage) {
 	struct wlr_buffer *dst_buffer = wlr_buffer_lock(&dst_dmabuf->base);
 
-	struct wlr_texture *src_tex = wlr_texture_from_dmabuf(renderer, src_attrs);
-	if (src_tex == NULL) {
-		goto error_src_tex;
-	}
-
 	float mat[9];
 	wlr_matrix_identity(mat);
 	wlr_matrix_scale(mat, dst_buffer->width, dst_buffer->height);
 
 	if (!wlr_renderer_begin_with_buffer(renderer, dst_buffer)) {
-		goto error_renderer_begin;
-	}
-
-	wlr_renderer_clear(renderer, (float[]){ 0.0, 0.0, 0.0, 0.0 });
-	wlr_render_texture_with_matrix(renderer, src_tex, mat, 1.0f);
-
+		wlr_buffer_unlock(dst_buffer);
+		return false;
+	}
+
+	int rects_len;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		struct wlr_box box = {
+			.x = rects[i].x1,
+			.y = rects[i].y1,
+			.width = rects[i].x2 - rects[i].x1,
+			.height = rects[i].y2 - rects[i].y1,
+		};
+		wlr_renderer_scissor(renderer, &box);
+		wlr_renderer_clear(renderer, (float[]){ 0.0, 0.0, 0.0, 0.0 });
+		wlr_render_texture_with_matrix(renderer, src_tex, mat, 1.0f);
+	}
+	wlr_renderer_scissor(renderer, NULL);
+
+	// The GPU work isn't waited for: the buffer is protected by its fence
 	wlr_renderer_end(renderer);
 
-	wlr_texture_destroy(src_tex);
 	wlr_buffer_unlock(dst_buffer);
 	return true;
+}
 
-error_renderer_begin:
-	wlr_texture_destroy(src_tex);
-error_src_tex:
-	wlr_buffer_unlock(dst_buffer);
-	return false;
+/**
+ * Get a texture for the committed output buffer. Textures imported from the
+ * buffer are cached by the renderer.
+ */
+static struct wlr_texture *frame_get_source_texture(
+		struct wlr_screencopy_frame_v1 *frame, struct wlr_renderer *renderer,
+		struct wlr_output_event_commit *event) {
+	if (event->buffer != NULL) {
+		return wlr_texture_from_buffer(renderer, event->buffer);
+	}
+
+	struct wlr_dmabuf_attributes attr = { 0 };
+	if (!wlr_output_export_dmabuf(frame->output, &attr)) {
+		return NULL;
+	}
+	struct wlr_texture *tex = wlr_texture_from_dmabuf(renderer, &attr);
+	wlr_dmabuf_attributes_finish(&attr);
+	return tex;
+}
+
+/**
+ * Forget about a client buffer on all outputs but the one it's about to be
+ * filled from: the damage tracked there doesn't apply to its new contents.
+ */
+static void client_invalidate_blit_targets(
+		struct wlr_screencopy_v1_client *client, struct wlr_buffer *buffer,
+		struct screencopy_damage *keep) {
+	struct screencopy_damage *damage;
+	wl_list_for_each(damage, &client->damages, link) {
+		if (damage == keep) {
+			continue;
+		}
+		struct screencopy_blit_target *target;
+		wl_list_for_each(target, &damage->blit_targets, link) {
+			if (target->buffer == buffer) {
+				blit_target_destroy(target);
+				break;
+			}
+		}
+	}
+}
+
+static bool frame_blit(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_renderer *renderer,
+		struct wlr_output_event_commit *event) {
+	struct wlr_dmabuf_v1_buffer *dma_buffer = frame->dma_buffer;
+
+	struct screencopy_damage *damage =
+		screencopy_damage_get_or_create(frame->client, frame->output);
+	client_invalidate_blit_targets(frame->client, &dma_buffer->base, damage);
+	struct screencopy_blit_target *target = NULL;
+	if (damage != NULL) {
+		target = blit_target_get_or_create(damage, &dma_buffer->base);
+	}
+
+	// Only copy what changed since the client buffer was last filled. This is
+	// only possible with copy_with_damage: with a plain copy, the client
+	// isn't required to preserve its buffer contents between frames.
+	pixman_region32_t region;
+	if (target != NULL && frame->with_damage) {
+		pixman_region32_init(&region);
+		pixman_region32_copy(&region, &target->damage);
+	} else {
+		pixman_region32_init_rect(&region, 0, 0,
+			frame->output->width, frame->output->height);
+	}
+
+	bool ok = true;
+	if (pixman_region32_not_empty(&region)) {
+		struct wlr_texture *src_tex =
+			frame_get_source_texture(frame, renderer, event);
+		ok = src_tex != NULL &&
+			blit_dmabuf(renderer, dma_buffer, src_tex, &region);
+		wlr_texture_destroy(src_tex);
+	}
+	pixman_region32_fini(&region);
+
+	if (ok && target != NULL) {
+		pixman_region32_clear(&target->damage);
+	}
+	return ok;
 }
 
 static void frame_handle_output_commit(struct wl_listener *listener,
@@ -334,12 +598,9 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 		return;
 	}
 
-	struct wlr_dmabuf_attributes attr = { 0 };
-	bool ok = wlr_output_export_dmabuf(output, &attr);
-	ok = ok && blit_dmabuf(renderer, dma_buffer, &attr);
+	bool ok = frame_blit(frame, renderer, event);
 	uint32_t flags = dma_buffer->attributes.flags & WLR_DMABUF_ATTRIBUTES_FLAGS_Y_INVERT ?
 		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
-	wlr_dmabuf_attributes_finish(&attr);
 
 	if (!ok) {
 		zwlr_screencopy_frame_v1_send_failed(frame->resource);
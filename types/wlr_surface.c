@@ -328,6 +328,25 @@ static void surface_state_move(struct wlr_surface_state *state,
 	next->cached_state_locks = 0;
 }
 
+/**
+ * Mark the flattened tree of the surface and its ancestors as outdated.
+ */
+static void surface_invalidate_tree(struct wlr_surface *surface) {
+	while (surface != NULL) {
+		surface->tree_dirty = true;
+
+		if (!wlr_surface_is_subsurface(surface)) {
+			break;
+		}
+		struct wlr_subsurface *subsurface =
+			wlr_subsurface_from_wlr_surface(surface);
+		if (subsurface == NULL) {
+			break;
+		}
+		surface = subsurface->parent;
+	}
+}
+
 static void surface_damage_subsurfaces(struct wlr_subsurface *subsurface) {
 	// XXX: This is probably the wrong way to do it, because this damage should
 	// come from the client, but weston doesn't do it correctly either and it
@@ -349,6 +368,26 @@ static void surface_damage_subsurfaces(struct wlr_subsurface *subsurface) {
 	}
 }
 
+static void surface_drop_spare_buffer(struct wlr_surface *surface) {
+	if (surface->spare_buffer != NULL) {
+		wlr_buffer_unlock(&surface->spare_buffer->base);
+	}
+	surface->spare_buffer = NULL;
+	pixman_region32_clear(&surface->spare_damage);
+}
+
+/**
+ * Check whether a client buffer replaced by a new commit is worth keeping as
+ * the spare: it must be a wl_shm buffer which has been released to the client,
+ * with a texture that can be updated in-place. Otherwise keeping it would only
+ * pin the client's previous buffer.
+ */
+static bool client_buffer_can_be_spare(struct wlr_client_buffer *buffer) {
+	return buffer->resource_released && buffer->resource != NULL &&
+		wl_shm_buffer_get(buffer->resource) != NULL &&
+		buffer->texture != NULL && buffer->texture->impl->write_pixels != NULL;
+}
+
 static void surface_apply_damage(struct wlr_surface *surface) {
 	struct wl_resource *resource = surface->current.buffer_resource;
 	if (resource == NULL) {
@@ -357,6 +396,7 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 			wlr_buffer_unlock(&surface->buffer->base);
 		}
 		surface->buffer = NULL;
+		surface_drop_spare_buffer(surface);
 		return;
 	}
 
@@ -366,6 +406,37 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 			&surface->buffer_damage);
 		if (updated_buffer != NULL) {
 			surface->buffer = updated_buffer;
+			pixman_region32_union(&surface->spare_damage,
+				&surface->spare_damage, &surface->buffer_damage);
+			return;
+		}
+	}
+
+	// Clients usually alternate between two wl_shm buffers. The current
+	// texture can't be updated in-place while it's still in use, but the
+	// spare one can be brought up-to-date by uploading the damage it has
+	// missed since it was last used.
+	if (surface->spare_buffer != NULL) {
+		pixman_region32_t damage;
+		pixman_region32_init(&damage);
+		pixman_region32_union(&damage, &surface->spare_damage,
+			&surface->buffer_damage);
+		struct wlr_client_buffer *updated_buffer =
+			wlr_client_buffer_apply_damage(surface->spare_buffer, resource,
+			&damage);
+		pixman_region32_fini(&damage);
+		if (updated_buffer != NULL) {
+			struct wlr_client_buffer *old_buffer = surface->buffer;
+			surface->buffer = updated_buffer;
+			surface->spare_buffer = NULL;
+			pixman_region32_clear(&surface->spare_damage);
+			if (old_buffer != NULL && client_buffer_can_be_spare(old_buffer)) {
+				surface->spare_buffer = old_buffer;
+				pixman_region32_copy(&surface->spare_damage,
+					&surface->buffer_damage);
+			} else if (old_buffer != NULL) {
+				wlr_buffer_unlock(&old_buffer->base);
+			}
 			return;
 		}
 	}
@@ -377,8 +448,15 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		return;
 	}
 
+	surface_drop_spare_buffer(surface);
 	if (surface->buffer != NULL) {
-		wlr_buffer_unlock(&surface->buffer->base);
+		if (client_buffer_can_be_spare(surface->buffer)) {
+			surface->spare_buffer = surface->buffer;
+			pixman_region32_copy(&surface->spare_damage,
+				&surface->buffer_damage);
+		} else {
+			wlr_buffer_unlock(&surface->buffer->base);
+		}
 	}
 	surface->buffer = buffer;
 }
@@ -442,6 +520,7 @@ static void surface_commit_state(struct wlr_surface *surface,
 	surface_update_input_region(surface);
 
 	// commit subsurface order
+	bool reordered = false;
 	struct wlr_subsurface *subsurface;
 	wl_list_for_each_reverse(subsurface, &surface->subsurfaces_pending_above,
 			parent_pending_link) {
@@ -451,6 +530,7 @@ static void surface_commit_state(struct wlr_surface *surface,
 		if (subsurface->reordered) {
 			// TODO: damage all the subsurfaces
 			surface_damage_subsurfaces(subsurface);
+			reordered = true;
 		}
 	}
 	wl_list_for_each_reverse(subsurface, &surface->subsurfaces_pending_below,
@@ -461,8 +541,12 @@ static void surface_commit_state(struct wlr_surface *surface,
 		if (subsurface->reordered) {
 			// TODO: damage all the subsurfaces
 			surface_damage_subsurfaces(subsurface);
+			reordered = true;
 		}
 	}
+	if (reordered) {
+		surface_invalidate_tree(surface);
+	}
 
 	if (surface->role && surface->role->commit) {
 		surface->role->commit(surface);
@@ -670,6 +754,7 @@ static void subsurface_destroy(struct wlr_subsurface *subsurface) {
 	wl_list_remove(&subsurface->surface_destroy.link);
 
 	if (subsurface->parent) {
+		surface_invalidate_tree(subsurface->parent);
 		wl_list_remove(&subsurface->parent_link);
 		wl_list_remove(&subsurface->parent_pending_link);
 		wl_list_remove(&subsurface->parent_destroy.link);
@@ -710,6 +795,9 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
+	surface_drop_spare_buffer(surface);
+	pixman_region32_fini(&surface->spare_damage);
+	free(surface->tree);
 	free(surface);
 }
 
@@ -760,6 +848,8 @@ struct wlr_surface *surface_create(struct wl_client *client,
 	pixman_region32_init(&surface->buffer_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
+	pixman_region32_init(&surface->spare_damage);
+	surface->tree_dirty = true;
 
 	wl_signal_add(&renderer->events.destroy, &surface->renderer_destroy);
 	surface->renderer_destroy.notify = surface_handle_renderer_destroy;
@@ -1079,6 +1169,7 @@ static void subsurface_role_commit(struct wlr_surface *surface) {
 
 		subsurface->current.x = subsurface->pending.x;
 		subsurface->current.y = subsurface->pending.y;
+		surface_invalidate_tree(subsurface->parent);
 
 		if ((surface->current.transform & WL_OUTPUT_TRANSFORM_90) != 0) {
 			int tmp = dx;
@@ -1176,6 +1267,7 @@ struct wlr_subsurface *wlr_subsurface_create(struct wlr_surface *surface,
 	wl_list_insert(parent->subsurfaces_above.prev, &subsurface->parent_link);
 	wl_list_insert(parent->subsurfaces_pending_above.prev,
 		&subsurface->parent_pending_link);
+	surface_invalidate_tree(parent);
 
 	surface->role_data = subsurface;
 
@@ -1214,13 +1306,68 @@ bool wlr_surface_point_accepts_input(struct wlr_surface *surface,
 		pixman_region32_contains_point(&surface->current.input, floor(sx), floor(sy), NULL);
 }
 
-struct wlr_surface *wlr_surface_surface_at(struct wlr_surface *surface,
+static bool surface_tree_append(struct wlr_surface *root,
+		struct wlr_surface *surface, int x, int y) {
+	struct wlr_subsurface *subsurface;
+	wl_list_for_each(subsurface, &surface->subsurfaces_below, parent_link) {
+		if (!surface_tree_append(root, subsurface->surface,
+				x + subsurface->current.x, y + subsurface->current.y)) {
+			return false;
+		}
+	}
+
+	if (root->tree_len == root->tree_cap) {
+		size_t cap = root->tree_cap == 0 ? 4 : root->tree_cap * 2;
+		struct wlr_surface_tree_entry *tree =
+			realloc(root->tree, cap * sizeof(*tree));
+		if (tree == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return false;
+		}
+		root->tree = tree;
+		root->tree_cap = cap;
+	}
+	root->tree[root->tree_len++] = (struct wlr_surface_tree_entry){
+		.surface = surface,
+		.x = x,
+		.y = y,
+	};
+
+	wl_list_for_each(subsurface, &surface->subsurfaces_above, parent_link) {
+		if (!surface_tree_append(root, subsurface->surface,
+				x + subsurface->current.x, y + subsurface->current.y)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Rebuild the flattened surface tree if needed, ordered from bottom to top.
+ * Returns false on allocation failure.
+ */
+static bool surface_update_tree(struct wlr_surface *surface) {
+	if (!surface->tree_dirty) {
+		return true;
+	}
+
+	surface->tree_len = 0;
+	if (!surface_tree_append(surface, surface, 0, 0)) {
+		surface->tree_len = 0;
+		return false;
+	}
+	surface->tree_dirty = false;
+	return true;
+}
+
+static struct wlr_surface *surface_at_recursive(struct wlr_surface *surface,
 		double sx, double sy, double *sub_x, double *sub_y) {
 	struct wlr_subsurface *subsurface;
 	wl_list_for_each_reverse(subsurface, &surface->subsurfaces_above, parent_link) {
 		double _sub_x = subsurface->current.x;
 		double _sub_y = subsurface->current.y;
-		struct wlr_surface *sub = wlr_surface_surface_at(subsurface->surface,
+		struct wlr_surface *sub = surface_at_recursive(subsurface->surface,
 			sx - _sub_x, sy - _sub_y, sub_x, sub_y);
 		if (sub != NULL) {
 			return sub;
@@ -1240,7 +1387,7 @@ struct wlr_surface *wlr_surface_surface_at(struct wlr_surface *surface,
 	wl_list_for_each_reverse(subsurface, &surface->subsurfaces_below, parent_link) {
 		double _sub_x = subsurface->current.x;
 		double _sub_y = subsurface->current.y;
-		struct wlr_surface *sub = wlr_surface_surface_at(subsurface->surface,
+		struct wlr_surface *sub = surface_at_recursive(subsurface->surface,
 			sx - _sub_x, sy - _sub_y, sub_x, sub_y);
 		if (sub != NULL) {
 			return sub;
@@ -1250,6 +1397,30 @@ struct wlr_surface *wlr_surface_surface_at(struct wlr_surface *surface,
 	return NULL;
 }
 
+struct wlr_surface *wlr_surface_surface_at(struct wlr_surface *surface,
+		double sx, double sy, double *sub_x, double *sub_y) {
+	if (!surface_update_tree(surface)) {
+		return surface_at_recursive(surface, sx, sy, sub_x, sub_y);
+	}
+
+	// Walk the tree from top to bottom
+	for (size_t i = surface->tree_len; i-- > 0;) {
+		const struct wlr_surface_tree_entry *entry = &surface->tree[i];
+		double x = sx - entry->x, y = sy - entry->y;
+		if (wlr_surface_point_accepts_input(entry->surface, x, y)) {
+			if (sub_x) {
+				*sub_x = x;
+			}
+			if (sub_y) {
+				*sub_y = y;
+			}
+			return entry->surface;
+		}
+	}
+
+	return NULL;
+}
+
 static void surface_output_destroy(struct wlr_surface_output *surface_output) {
 	wl_list_remove(&surface_output->bind.link);
 	wl_list_remove(&surface_output->destroy.link);
@@ -1366,7 +1537,15 @@ static void surface_for_each_surface(struct wlr_surface *surface, int x, int y,
 
 void wlr_surface_for_each_surface(struct wlr_surface *surface,
 		wlr_surface_iterator_func_t iterator, void *user_data) {
-	surface_for_each_surface(surface, 0, 0, iterator, user_data);
+	if (!surface_update_tree(surface)) {
+		surface_for_each_surface(surface, 0, 0, iterator, user_data);
+		return;
+	}
+
+	for (size_t i = 0; i < surface->tree_len; i++) {
+		const struct wlr_surface_tree_entry *entry = &surface->tree[i];
+		iterator(entry->surface, entry->x, entry->y, user_data);
+	}
 }
 
 struct bound_acc {
@@ -1,8 +1,10 @@
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <wlr/config.h>
@@ -53,3 +55,69 @@ int allocate_shm_file(size_t size) {
 
 	return fd;
 }
+
+static bool fill_shm_file(int fd, const void *data, size_t size) {
+	int ret;
+	do {
+		ret = ftruncate(fd, size);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		return false;
+	}
+
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		return false;
+	}
+	memcpy(ptr, data, size);
+	munmap(ptr, size);
+	return true;
+}
+
+int allocate_ro_shm_file(const void *data, size_t size) {
+#ifdef MFD_ALLOW_SEALING
+	int memfd = memfd_create("wlroots", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (memfd >= 0) {
+		if (!fill_shm_file(memfd, data, size) ||
+				fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+					F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+			close(memfd);
+			return -1;
+		}
+		return memfd;
+	}
+	// Fall back to a read-only shared memory object, the kernel may not
+	// support memfd
+#endif
+
+	int retries = 100;
+	int rw_fd;
+	char name[] = "/wlroots-XXXXXX";
+	do {
+		randname(name + strlen(name) - 6);
+
+		--retries;
+		rw_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	} while (rw_fd < 0 && retries > 0 && errno == EEXIST);
+	if (rw_fd < 0) {
+		return -1;
+	}
+
+	int ro_fd = shm_open(name, O_RDONLY, 0);
+	shm_unlink(name);
+	if (ro_fd < 0) {
+		close(rw_fd);
+		return -1;
+	}
+
+	// Make sure the file can't be re-opened read-write, e.g. via
+	// /proc/self/fd/ on Linux
+	bool ok = fchmod(rw_fd, 0) == 0 && fill_shm_file(rw_fd, data, size);
+	close(rw_fd);
+	if (!ok) {
+		close(ro_fd);
+		return -1;
+	}
+
+	return ro_fd;
+}
@@ -10,6 +10,10 @@ int64_t timespec_to_msec(const struct timespec *a) {
 	return (int64_t)a->tv_sec * 1000 + a->tv_nsec / 1000000;
 }
 
+int64_t timespec_to_nsec(const struct timespec *a) {
+	return (int64_t)a->tv_sec * NSEC_PER_SEC + a->tv_nsec;
+}
+
 void timespec_from_nsec(struct timespec *r, int64_t nsec) {
 	r->tv_sec = nsec / NSEC_PER_SEC;
 	r->tv_nsec = nsec % NSEC_PER_SEC;
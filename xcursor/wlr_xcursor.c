@@ -25,6 +25,7 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,94 @@
 #include <wlr/xcursor.h>
 #include "xcursor/xcursor.h"
 
+struct wlr_xcursor_theme_entry {
+	char *name;
+	// Files to decode on first lookup, in theme lookup order: if one fails to
+	// decode, an inherited theme can still provide the cursor. Freed once
+	// attempted.
+	char **paths;
+	size_t paths_len;
+	struct wlr_xcursor *cursor;
+	struct wlr_xcursor_theme_entry *next;
+};
+
+static uint32_t hash_name(const char *name) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const char *c = name; *c != '\0'; c++) {
+		hash ^= (uint8_t)*c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static struct wlr_xcursor_theme_entry *theme_find_entry(
+		struct wlr_xcursor_theme *theme, const char *name) {
+	if (theme->entries_cap == 0) {
+		return NULL;
+	}
+	size_t i = hash_name(name) & (theme->entries_cap - 1);
+	struct wlr_xcursor_theme_entry *entry;
+	for (entry = theme->entries[i]; entry != NULL; entry = entry->next) {
+		if (strcmp(entry->name, name) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static struct wlr_xcursor_theme_entry *theme_add_entry(
+		struct wlr_xcursor_theme *theme, const char *name) {
+	if (theme->entries_len >= theme->entries_cap) {
+		size_t cap = theme->entries_cap ? theme->entries_cap * 2 : 64;
+		struct wlr_xcursor_theme_entry **entries =
+			calloc(cap, sizeof(*entries));
+		if (entries == NULL) {
+			return NULL;
+		}
+		for (size_t i = 0; i < theme->entries_cap; i++) {
+			struct wlr_xcursor_theme_entry *entry, *next;
+			for (entry = theme->entries[i]; entry != NULL; entry = next) {
+				next = entry->next;
+				size_t j = hash_name(entry->name) & (cap - 1);
+				entry->next = entries[j];
+				entries[j] = entry;
+			}
+		}
+		free(theme->entries);
+		theme->entries = entries;
+		theme->entries_cap = cap;
+	}
+
+	struct wlr_xcursor_theme_entry *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return NULL;
+	}
+	entry->name = strdup(name);
+	if (entry->name == NULL) {
+		free(entry);
+		return NULL;
+	}
+
+	size_t i = hash_name(name) & (theme->entries_cap - 1);
+	entry->next = theme->entries[i];
+	theme->entries[i] = entry;
+	theme->entries_len++;
+	return entry;
+}
+
+static bool theme_add_cursor(struct wlr_xcursor_theme *theme,
+		struct wlr_xcursor *cursor) {
+	struct wlr_xcursor **cursors = realloc(theme->cursors,
+		(theme->cursor_count + 1) * sizeof(theme->cursors[0]));
+	if (cursors == NULL) {
+		return false;
+	}
+	theme->cursors = cursors;
+	theme->cursors[theme->cursor_count++] = cursor;
+	return true;
+}
+
 static void xcursor_destroy(struct wlr_xcursor *cursor) {
 	for (size_t i = 0; i < cursor->image_count; i++) {
 		free(cursor->images[i]->buffer);
@@ -124,6 +213,14 @@ static void load_default_theme(struct wlr_xcursor_theme *theme) {
 		}
 	}
 	theme->cursor_count = i;
+
+	for (i = 0; i < theme->cursor_count; ++i) {
+		struct wlr_xcursor_theme_entry *entry =
+			theme_add_entry(theme, theme->cursors[i]->name);
+		if (entry != NULL) {
+			entry->cursor = theme->cursors[i];
+		}
+	}
 }
 
 static struct wlr_xcursor *xcursor_create_from_xcursor_images(
@@ -188,7 +285,7 @@ static void load_callback(XcursorImages *images, void *data) {
 	struct wlr_xcursor_theme *theme = data;
 	struct wlr_xcursor *cursor;
 
-	if (wlr_xcursor_theme_get_cursor(theme, images->name)) {
+	if (theme_find_entry(theme, images->name)) {
 		XcursorImagesDestroy(images);
 		return;
 	}
@@ -196,28 +293,57 @@ static void load_callback(XcursorImages *images, void *data) {
 	cursor = xcursor_create_from_xcursor_images(images, theme);
 
 	if (cursor) {
-		struct wlr_xcursor **cursors;
-		theme->cursor_count++;
-		cursors =
-			realloc(theme->cursors,
-				theme->cursor_count * sizeof(theme->cursors[0]));
-
-		if (cursors == NULL) {
-			theme->cursor_count--;
-			free(cursor);
+		if (!theme_add_cursor(theme, cursor)) {
+			xcursor_destroy(cursor);
 		} else {
-			theme->cursors = cursors;
-			theme->cursors[theme->cursor_count - 1] = cursor;
+			struct wlr_xcursor_theme_entry *entry =
+				theme_add_entry(theme, cursor->name);
+			if (entry == NULL) {
+				theme->cursor_count--;
+				xcursor_destroy(cursor);
+			} else {
+				entry->cursor = cursor;
+			}
 		}
 	}
 
 	XcursorImagesDestroy(images);
 }
 
-struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
-	struct wlr_xcursor_theme *theme;
+static void entry_free_paths(struct wlr_xcursor_theme_entry *entry) {
+	for (size_t i = 0; i < entry->paths_len; i++) {
+		free(entry->paths[i]);
+	}
+	free(entry->paths);
+	entry->paths = NULL;
+	entry->paths_len = 0;
+}
+
+static void index_callback(const char *name, const char *path, void *data) {
+	struct wlr_xcursor_theme *theme = data;
 
-	theme = malloc(sizeof(*theme));
+	struct wlr_xcursor_theme_entry *entry = theme_find_entry(theme, name);
+	if (entry == NULL) {
+		entry = theme_add_entry(theme, name);
+		if (entry == NULL) {
+			return;
+		}
+	}
+
+	char **paths = realloc(entry->paths,
+		(entry->paths_len + 1) * sizeof(*paths));
+	if (paths == NULL) {
+		return;
+	}
+	entry->paths = paths;
+	paths[entry->paths_len] = strdup(path);
+	if (paths[entry->paths_len] != NULL) {
+		entry->paths_len++;
+	}
+}
+
+static struct wlr_xcursor_theme *theme_create(const char *name, int size) {
+	struct wlr_xcursor_theme *theme = calloc(1, sizeof(*theme));
 	if (!theme) {
 		return NULL;
 	}
@@ -228,13 +354,21 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 
 	theme->name = strdup(name);
 	if (!theme->name) {
-		goto out_error_name;
+		free(theme);
+		return NULL;
 	}
 	theme->size = size;
-	theme->cursor_count = 0;
-	theme->cursors = NULL;
 
-	xcursor_load_theme(name, size, load_callback, theme);
+	return theme;
+}
+
+struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
+	struct wlr_xcursor_theme *theme = theme_create(name, size);
+	if (!theme) {
+		return NULL;
+	}
+
+	xcursor_load_theme(theme->name, size, load_callback, theme);
 
 	if (theme->cursor_count == 0) {
 		load_default_theme(theme);
@@ -244,10 +378,25 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 			theme->name, size, theme->cursor_count);
 
 	return theme;
+}
 
-out_error_name:
-	free(theme);
-	return NULL;
+struct wlr_xcursor_theme *wlr_xcursor_theme_load_lazy(const char *name,
+		int size) {
+	struct wlr_xcursor_theme *theme = theme_create(name, size);
+	if (!theme) {
+		return NULL;
+	}
+
+	xcursor_scan_theme(theme->name, index_callback, theme);
+
+	if (theme->entries_len == 0) {
+		load_default_theme(theme);
+	}
+
+	wlr_log(WLR_DEBUG, "Indexed cursor theme '%s' at size %d (%zu available cursors)",
+			theme->name, size, theme->entries_len);
+
+	return theme;
 }
 
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
@@ -257,6 +406,17 @@ void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
 		xcursor_destroy(theme->cursors[i]);
 	}
 
+	for (size_t j = 0; j < theme->entries_cap; j++) {
+		struct wlr_xcursor_theme_entry *entry, *next;
+		for (entry = theme->entries[j]; entry != NULL; entry = next) {
+			next = entry->next;
+			free(entry->name);
+			entry_free_paths(entry);
+			free(entry);
+		}
+	}
+
+	free(theme->entries);
 	free(theme->name);
 	free(theme->cursors);
 	free(theme);
@@ -264,15 +424,42 @@ void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
 
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
 		const char *name) {
-	unsigned int i;
+	struct wlr_xcursor_theme_entry *entry = theme_find_entry(theme, name);
+	if (entry == NULL) {
+		return NULL;
+	}
 
-	for (i = 0; i < theme->cursor_count; i++) {
-		if (strcmp(name, theme->cursors[i]->name) == 0) {
-			return theme->cursors[i];
+	if (entry->cursor == NULL && entry->paths != NULL) {
+		// Like eager loading, use the first candidate which decodes
+		for (size_t i = 0; i < entry->paths_len; i++) {
+			XcursorImages *images =
+				xcursor_load_file(entry->paths[i], entry->name, theme->size);
+			if (images == NULL) {
+				continue;
+			}
+
+			struct wlr_xcursor *cursor =
+				xcursor_create_from_xcursor_images(images, theme);
+			XcursorImagesDestroy(images);
+			if (cursor == NULL) {
+				continue;
+			}
+			if (!theme_add_cursor(theme, cursor)) {
+				xcursor_destroy(cursor);
+				break;
+			}
+			entry->cursor = cursor;
+			break;
+		}
+		entry_free_paths(entry);
+
+		if (entry->cursor == NULL) {
+			wlr_log(WLR_DEBUG, "Failed to load cursor '%s' from theme '%s'",
+				name, theme->name);
 		}
 	}
 
-	return NULL;
+	return entry->cursor;
 }
 
 static int xcursor_frame_and_duration(struct wlr_xcursor *cursor,
@@ -874,16 +874,31 @@ XcursorLibraryLoadImages (const char *file, const char *theme, int size)
     return images;
 }
 
+XcursorImages *
+xcursor_load_file(const char *path, const char *name, int size)
+{
+	FILE *f = fopen(path, "r");
+	XcursorImages *images;
+
+	if (!f)
+		return NULL;
+
+	images = XcursorFileLoadImages(f, size);
+	if (images)
+		XcursorImagesSetName(images, name);
+
+	fclose(f);
+	return images;
+}
+
 static void
-load_all_cursors_from_dir(const char *path, int size,
-			  void (*load_callback)(XcursorImages *, void *),
+scan_all_cursors_from_dir(const char *path,
+			  void (*file_callback)(const char *, const char *, void *),
 			  void *user_data)
 {
-	FILE *f;
 	DIR *dir = opendir(path);
 	struct dirent *ent;
 	char *full;
-	XcursorImages *images;
 
 	if (!dir)
 		return;
@@ -899,49 +914,32 @@ load_all_cursors_from_dir(const char *path, int size,
 		if (!full)
 			continue;
 
-		f = fopen(full, "r");
-		if (!f) {
-			free(full);
-			continue;
-		}
-
-		images = XcursorFileLoadImages(f, size);
-
-		if (images) {
-			XcursorImagesSetName(images, ent->d_name);
-			load_callback(images, user_data);
-		}
-
-		fclose (f);
+		file_callback(ent->d_name, full, user_data);
 		free(full);
 	}
 
 	closedir(dir);
 }
 
-/** Load all the cursor of a theme
+/** Enumerate all the cursor files of a theme
  *
- * This function loads all the cursor images of a given theme and its
- * inherited themes. Each cursor is loaded into an XcursorImages object
- * which is passed to the caller's load callback. If a cursor appears
- * more than once across all the inherited themes, the load callback
- * will be called multiple times, with possibly different XcursorImages
- * object which have the same name. The user is expected to destroy the
- * XcursorImages objects passed to the callback with
- * XcursorImagesDestroy().
+ * This function walks the cursor directories of a given theme and its
+ * inherited themes in lookup order, and calls the file callback with the
+ * cursor name and the full path of each file found, without opening it.
+ * If a cursor appears more than once across all the inherited themes, the
+ * first occurrence is the one that should be used.
  *
- * \param theme The name of theme that should be loaded
- * \param size The desired size of the cursor images
- * \param load_callback A callback function that will be called
- * for each cursor loaded. The first parameter is the XcursorImages
- * object representing the loaded cursor and the second is a pointer
- * to data provided by the user.
- * \param user_data The data that should be passed to the load callback
+ * \param theme The name of theme that should be scanned
+ * \param file_callback A callback function that will be called
+ * for each cursor file. The first parameter is the cursor name, the
+ * second is the full path to the file and the third is a pointer to
+ * data provided by the user.
+ * \param user_data The data that should be passed to the file callback
  */
 void
-xcursor_load_theme(const char *theme, int size,
-		    void (*load_callback)(XcursorImages *, void *),
-		    void *user_data)
+xcursor_scan_theme(const char *theme,
+		   void (*file_callback)(const char *, const char *, void *),
+		   void *user_data)
 {
 	char *full, *dir;
 	char *inherits = NULL;
@@ -960,7 +958,7 @@ xcursor_load_theme(const char *theme, int size,
 		full = _XcursorBuildFullname(dir, "cursors", "");
 
 		if (full) {
-			load_all_cursors_from_dir(full, size, load_callback,
+			scan_all_cursors_from_dir(full, file_callback,
 						  user_data);
 			free(full);
 		}
@@ -977,8 +975,57 @@ xcursor_load_theme(const char *theme, int size,
 	}
 
 	for (i = inherits; i; i = _XcursorNextPath(i))
-		xcursor_load_theme(i, size, load_callback, user_data);
+		xcursor_scan_theme(i, file_callback, user_data);
 
 	if (inherits)
 		free(inherits);
 }
+
+struct load_theme_data {
+	int size;
+	void (*load_callback)(XcursorImages *, void *);
+	void *user_data;
+};
+
+static void
+load_theme_file(const char *name, const char *path, void *data)
+{
+	struct load_theme_data *load = data;
+	XcursorImages *images = xcursor_load_file(path, name, load->size);
+
+	if (images)
+		load->load_callback(images, load->user_data);
+}
+
+/** Load all the cursor of a theme
+ *
+ * This function loads all the cursor images of a given theme and its
+ * inherited themes. Each cursor is loaded into an XcursorImages object
+ * which is passed to the caller's load callback. If a cursor appears
+ * more than once across all the inherited themes, the load callback
+ * will be called multiple times, with possibly different XcursorImages
+ * object which have the same name. The user is expected to destroy the
+ * XcursorImages objects passed to the callback with
+ * XcursorImagesDestroy().
+ *
+ * \param theme The name of theme that should be loaded
+ * \param size The desired size of the cursor images
+ * \param load_callback A callback function that will be called
+ * for each cursor loaded. The first parameter is the XcursorImages
+ * object representing the loaded cursor and the second is a pointer
+ * to data provided by the user.
+ * \param user_data The data that should be passed to the load callback
+ */
+void
+xcursor_load_theme(const char *theme, int size,
+		    void (*load_callback)(XcursorImages *, void *),
+		    void *user_data)
+{
+	struct load_theme_data load = {
+		.size = size,
+		.load_callback = load_callback,
+		.user_data = user_data,
+	};
+
+	xcursor_scan_theme(theme, load_theme_file, &load);
+}
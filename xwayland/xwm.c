@@ -3,6 +3,7 @@
 #endif
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_data_device.h>
@@ -16,6 +17,7 @@
 #include <xcb/render.h>
 #include <xcb/res.h>
 #include <xcb/xcb_icccm.h>
+#include <xcb/xcbext.h>
 #include <xcb/xfixes.h>
 #include "util/signal.h"
 #include "xwayland/xwm.h"
@@ -100,18 +102,142 @@ struct wlr_xwayland_surface *wlr_xwayland_surface_from_wlr_surface(
 	return (struct wlr_xwayland_surface *)surface->role_data;
 }
 
-// TODO: replace this with hash table?
-static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
-		xcb_window_t window_id) {
-	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->window_id == window_id) {
-			return surface;
+static size_t id_map_hash(uint32_t key, size_t cap) {
+	// Fibonacci hashing: multiply by 2^32 / phi and keep the top log2(cap)
+	// bits of the 32-bit product, since X11 resource ids of a client only
+	// differ in their low bits
+	uint32_t product = key * 2654435769u;
+	return (size_t)(((uint64_t)product * cap) >> 32);
+}
+
+static struct xwm_id_map_entry *id_map_find(struct xwm_id_map *map,
+		uint32_t key) {
+	if (map->cap == 0 || key == 0) {
+		return NULL;
+	}
+	size_t i = id_map_hash(key, map->cap);
+	while (map->entries[i].key != 0) {
+		if (map->entries[i].key == key) {
+			return &map->entries[i];
 		}
+		i = (i + 1) & (map->cap - 1);
 	}
 	return NULL;
 }
 
+static void id_map_put_entry(struct xwm_id_map_entry *entries, size_t cap,
+		uint32_t key, struct wlr_xwayland_surface *surface) {
+	size_t i = id_map_hash(key, cap);
+	while (entries[i].key != 0 && entries[i].key != key) {
+		i = (i + 1) & (cap - 1);
+	}
+	entries[i].key = key;
+	entries[i].surface = surface;
+}
+
+/**
+ * Associates `key` with `surface`, replacing any previous value. Returns false
+ * on allocation failure.
+ */
+static bool id_map_insert(struct xwm_id_map *map, uint32_t key,
+		struct wlr_xwayland_surface *surface) {
+	assert(key != 0);
+	struct xwm_id_map_entry *entry = id_map_find(map, key);
+	if (entry != NULL) {
+		entry->surface = surface;
+		return true;
+	}
+
+	// Keep the load factor below 3/4
+	if ((map->len + 1) * 4 > map->cap * 3) {
+		size_t cap = map->cap ? map->cap * 2 : 16;
+		struct xwm_id_map_entry *entries = calloc(cap, sizeof(*entries));
+		if (entries == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return false;
+		}
+		for (size_t i = 0; i < map->cap; i++) {
+			if (map->entries[i].key != 0) {
+				id_map_put_entry(entries, cap, map->entries[i].key,
+					map->entries[i].surface);
+			}
+		}
+		free(map->entries);
+		map->entries = entries;
+		map->cap = cap;
+	}
+
+	id_map_put_entry(map->entries, map->cap, key, surface);
+	map->len++;
+	return true;
+}
+
+/**
+ * Removes `key` if it is associated with `surface`. Uses backward-shift
+ * deletion so that lookups never need tombstones.
+ */
+static void id_map_remove(struct xwm_id_map *map, uint32_t key,
+		struct wlr_xwayland_surface *surface) {
+	struct xwm_id_map_entry *entry = id_map_find(map, key);
+	if (entry == NULL || entry->surface != surface) {
+		return;
+	}
+
+	size_t mask = map->cap - 1;
+	size_t hole = entry - map->entries;
+	size_t i = hole;
+	while (true) {
+		i = (i + 1) & mask;
+		if (map->entries[i].key == 0) {
+			break;
+		}
+		// Move the entry into the hole unless its home slot lies
+		// cyclically in (hole, i]
+		size_t home = id_map_hash(map->entries[i].key, map->cap);
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			map->entries[hole] = map->entries[i];
+			hole = i;
+		}
+	}
+	map->entries[hole].key = 0;
+	map->entries[hole].surface = NULL;
+	map->len--;
+}
+
+static void id_map_finish(struct xwm_id_map *map) {
+	free(map->entries);
+	map->entries = NULL;
+	map->len = map->cap = 0;
+}
+
+static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
+		xcb_window_t window_id) {
+	struct xwm_id_map_entry *entry =
+		id_map_find(&xwm->surfaces_by_window, window_id);
+	return entry != NULL ? entry->surface : NULL;
+}
+
+static bool xsurface_set_unpaired(struct wlr_xwayland_surface *xsurface,
+		uint32_t surface_id) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	if (!id_map_insert(&xwm->unpaired_by_surface_id, surface_id, xsurface)) {
+		return false;
+	}
+	xsurface->surface_id = surface_id;
+	wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+	return true;
+}
+
+static void xsurface_clear_unpaired(struct wlr_xwayland_surface *xsurface) {
+	if (xsurface->surface_id == 0) {
+		return;
+	}
+	id_map_remove(&xsurface->xwm->unpaired_by_surface_id,
+		xsurface->surface_id, xsurface);
+	wl_list_remove(&xsurface->unpaired_link);
+	xsurface->surface_id = 0;
+}
+
 static int xwayland_surface_handle_ping_timeout(void *data) {
 	struct wlr_xwayland_surface *surface = data;
 
@@ -150,6 +276,7 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	wl_list_init(&surface->children);
 	wl_list_init(&surface->stack_link);
 	wl_list_init(&surface->parent_link);
+	wl_list_init(&surface->pending_replies);
 	wl_signal_init(&surface->events.destroy);
 	wl_signal_init(&surface->events.request_configure);
 	wl_signal_init(&surface->events.request_move);
@@ -189,6 +316,11 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 		return NULL;
 	}
 
+	if (!id_map_insert(&xwm->surfaces_by_window, window_id, surface)) {
+		wl_event_source_remove(surface->ping_timer);
+		free(surface);
+		return NULL;
+	}
 	wl_list_insert(&xwm->surfaces, &surface->link);
 
 	wlr_signal_emit_safe(&xwm->xwayland->events.new_surface, surface);
@@ -224,57 +356,114 @@ static void xwm_send_wm_message(struct wlr_xwayland_surface *surface,
 	xcb_flush(xwm->xcb_conn);
 }
 
-static void xwm_set_net_client_list(struct wlr_xwm *xwm) {
-	// FIXME: _NET_CLIENT_LIST is expected to be ordered by map time, but the
-	// order of surfaces in `xwm->surfaces` is by creation time. The order of
-	// windows _NET_CLIENT_LIST exposed by wlroots is wrong.
-
-	size_t mapped_surfaces = 0;
-	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->mapped) {
-			mapped_surfaces++;
-		}
+static bool ensure_window_array(xcb_window_t **windows, size_t *cap,
+		size_t len) {
+	if (len <= *cap) {
+		return true;
 	}
-
-	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * mapped_surfaces);
-	if (!windows) {
-		return;
+	size_t new_cap = *cap ? *cap * 2 : 16;
+	while (new_cap < len) {
+		new_cap *= 2;
 	}
-
-	size_t index = 0;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->mapped) {
-			windows[index++] = surface->window_id;
-		}
+	xcb_window_t *new_windows =
+		realloc(*windows, new_cap * sizeof(xcb_window_t));
+	if (new_windows == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
 	}
+	*windows = new_windows;
+	*cap = new_cap;
+	return true;
+}
 
-	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE,
+static void xwm_flush_client_list(struct wlr_xwm *xwm) {
+	if (xwm->client_list_replace) {
+		xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE,
 			xwm->screen->root, xwm->atoms[NET_CLIENT_LIST],
-			XCB_ATOM_WINDOW, 32, mapped_surfaces, windows);
-	free(windows);
+			XCB_ATOM_WINDOW, 32, xwm->client_list_len, xwm->client_list);
+	} else if (xwm->client_list_written < xwm->client_list_len) {
+		// Only windows were mapped since the last update
+		xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_APPEND,
+			xwm->screen->root, xwm->atoms[NET_CLIENT_LIST], XCB_ATOM_WINDOW,
+			32, xwm->client_list_len - xwm->client_list_written,
+			&xwm->client_list[xwm->client_list_written]);
+	}
+	xwm->client_list_written = xwm->client_list_len;
+	xwm->client_list_replace = false;
 }
 
-static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+static void xwm_flush_client_list_stacking(struct wlr_xwm *xwm) {
 	size_t num_surfaces = wl_list_length(&xwm->surfaces_in_stack_order);
-	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * num_surfaces);
-	if (!windows) {
+	if (!ensure_window_array(&xwm->client_list_stacking,
+			&xwm->client_list_stacking_cap, num_surfaces)) {
 		return;
 	}
 
-	// We store surfaces in top-to-bottom order because this is easier to reason
-	// about, but _NET_CLIENT_LIST_STACKING is supposed to be in bottom-to-top
-	// order, so iterate backwards through the list.
 	size_t i = 0;
 	struct wlr_xwayland_surface *xsurface;
 	wl_list_for_each(xsurface, &xwm->surfaces_in_stack_order, stack_link) {
-		windows[i++] = xsurface->window_id;
+		xwm->client_list_stacking[i++] = xsurface->window_id;
 	}
 
 	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE, xwm->screen->root,
 			xwm->atoms[NET_CLIENT_LIST_STACKING], XCB_ATOM_WINDOW, 32, num_surfaces,
-			windows);
-	free(windows);
+			xwm->client_list_stacking);
+	xwm->client_list_stacking_dirty = false;
+}
+
+static void xwm_handle_client_list_idle(void *data) {
+	struct wlr_xwm *xwm = data;
+	xwm->client_list_idle = NULL;
+
+	xwm_flush_client_list(xwm);
+	if (xwm->client_list_stacking_dirty) {
+		xwm_flush_client_list_stacking(xwm);
+	}
+	xcb_flush(xwm->xcb_conn);
+}
+
+static void xwm_schedule_client_list_update(struct wlr_xwm *xwm) {
+	if (xwm->client_list_idle != NULL) {
+		return;
+	}
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(xwm->xwayland->wl_display);
+	xwm->client_list_idle =
+		wl_event_loop_add_idle(loop, xwm_handle_client_list_idle, xwm);
+	if (xwm->client_list_idle == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add idle event source");
+		xwm_handle_client_list_idle(xwm);
+	}
+}
+
+static void xwm_client_list_add(struct wlr_xwm *xwm, xcb_window_t window) {
+	if (!ensure_window_array(&xwm->client_list, &xwm->client_list_cap,
+			xwm->client_list_len + 1)) {
+		return;
+	}
+	xwm->client_list[xwm->client_list_len++] = window;
+	xwm_schedule_client_list_update(xwm);
+}
+
+static void xwm_client_list_remove(struct wlr_xwm *xwm, xcb_window_t window) {
+	for (size_t i = 0; i < xwm->client_list_len; i++) {
+		if (xwm->client_list[i] != window) {
+			continue;
+		}
+		memmove(&xwm->client_list[i], &xwm->client_list[i + 1],
+			(xwm->client_list_len - i - 1) * sizeof(xcb_window_t));
+		xwm->client_list_len--;
+		if (i < xwm->client_list_written) {
+			xwm->client_list_replace = true;
+		}
+		xwm_schedule_client_list_update(xwm);
+		return;
+	}
+}
+
+static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+	xwm->client_list_stacking_dirty = true;
+	xwm_schedule_client_list_update(xwm);
 }
 
 static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface);
@@ -374,19 +563,45 @@ static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface) {
 		i, property);
 }
 
+/**
+ * A request whose reply is consumed asynchronously by the X11 event handler,
+ * so that the compositor never blocks on the X server.
+ */
+struct xwm_pending_reply {
+	struct wl_list link; // wlr_xwm::pending_replies
+	struct wl_list surface_link; // wlr_xwayland_surface::pending_replies
+	struct wlr_xwayland_surface *xsurface;
+	unsigned int sequence;
+	// XCB_ATOM_NONE for a client ID query, the property to read otherwise
+	xcb_atom_t property;
+};
+
 static void xsurface_unmap(struct wlr_xwayland_surface *surface);
+static void pending_reply_destroy(struct wlr_xwm *xwm,
+	struct xwm_pending_reply *pending, bool discard);
 
 static void xwayland_surface_destroy(
 		struct wlr_xwayland_surface *xsurface) {
 	xsurface_unmap(xsurface);
 
+	struct xwm_pending_reply *pending, *pending_tmp;
+	wl_list_for_each_safe(pending, pending_tmp, &xsurface->pending_replies,
+			surface_link) {
+		pending_reply_destroy(xsurface->xwm, pending, true);
+	}
+
 	wlr_signal_emit_safe(&xsurface->events.destroy, xsurface);
 
 	if (xsurface == xsurface->xwm->focus_surface) {
 		xwm_surface_activate(xsurface->xwm, NULL);
 	}
 
+	id_map_remove(&xsurface->xwm->surfaces_by_window, xsurface->window_id,
+		xsurface);
 	wl_list_remove(&xsurface->link);
+	if (!wl_list_empty(&xsurface->stack_link)) {
+		xwm_set_net_client_list_stacking(xsurface->xwm);
+	}
 	wl_list_remove(&xsurface->stack_link);
 	wl_list_remove(&xsurface->parent_link);
 
@@ -397,9 +612,7 @@ static void xwayland_surface_destroy(
 		child->parent = NULL;
 	}
 
-	if (xsurface->surface_id) {
-		wl_list_remove(&xsurface->unpaired_link);
-	}
+	xsurface_clear_unpaired(xsurface);
 
 	if (xsurface->surface) {
 		wl_list_remove(&xsurface->surface_destroy.link);
@@ -542,20 +755,8 @@ static void read_surface_parent(struct wlr_xwm *xwm,
 }
 
 static void read_surface_client_id(struct wlr_xwm *xwm,
-		struct wlr_xwayland_surface *xsurface) {
-	xcb_res_client_id_spec_t spec = {
-		.client = xsurface->window_id,
-		.mask = XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID
-	};
-
-	xcb_res_query_client_ids_cookie_t cookie = xcb_res_query_client_ids(
-		xwm->xcb_conn, 1, &spec);
-	xcb_res_query_client_ids_reply_t *reply = xcb_res_query_client_ids_reply(
-		xwm->xcb_conn, cookie,  NULL);
-	if (reply == NULL) {
-		return;
-	}
-
+		struct wlr_xwayland_surface *xsurface,
+		xcb_res_query_client_ids_reply_t *reply) {
 	uint32_t *pid = NULL;
 	xcb_res_client_id_value_iterator_t iter =
 		xcb_res_query_client_ids_ids_iterator(reply);
@@ -568,12 +769,10 @@ static void read_surface_client_id(struct wlr_xwm *xwm,
 		xcb_res_client_id_value_next(&iter);
 	}
 	if (pid == NULL) {
-		free(reply);
 		return;
 	}
 	xsurface->pid = *pid;
 	wlr_signal_emit_safe(&xsurface->events.set_pid, xsurface);
-	free(reply);
 }
 
 static void read_surface_window_type(struct wlr_xwm *xwm,
@@ -759,15 +958,8 @@ char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom) {
 }
 
 static void read_surface_property(struct wlr_xwm *xwm,
-		struct wlr_xwayland_surface *xsurface, xcb_atom_t property) {
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
-		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
-	xcb_get_property_reply_t *reply = xcb_get_property_reply(xwm->xcb_conn,
-		cookie, NULL);
-	if (reply == NULL) {
-		return;
-	}
-
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
+		xcb_get_property_reply_t *reply) {
 	if (property == XCB_ATOM_WM_CLASS) {
 		read_surface_class(xwm, xsurface, reply);
 	} else if (property == XCB_ATOM_WM_NAME ||
@@ -797,8 +989,110 @@ static void read_surface_property(struct wlr_xwm *xwm,
 			property, prop_name ? prop_name : "(null)", xsurface->window_id);
 		free(prop_name);
 	}
+}
 
-	free(reply);
+static void pending_reply_create(struct wlr_xwayland_surface *xsurface,
+		unsigned int sequence, xcb_atom_t property) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	struct xwm_pending_reply *pending = calloc(1, sizeof(*pending));
+	if (pending == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		xcb_discard_reply(xwm->xcb_conn, sequence);
+		return;
+	}
+	pending->xsurface = xsurface;
+	pending->sequence = sequence;
+	pending->property = property;
+	wl_list_insert(xwm->pending_replies.prev, &pending->link);
+	wl_list_insert(xsurface->pending_replies.prev, &pending->surface_link);
+}
+
+static void pending_reply_destroy(struct wlr_xwm *xwm,
+		struct xwm_pending_reply *pending, bool discard) {
+	if (discard) {
+		xcb_discard_reply(xwm->xcb_conn, pending->sequence);
+	}
+	wl_list_remove(&pending->link);
+	wl_list_remove(&pending->surface_link);
+	free(pending);
+}
+
+static void xsurface_request_property(struct wlr_xwayland_surface *xsurface,
+		xcb_atom_t property) {
+	xcb_get_property_cookie_t cookie =
+		xcb_get_property(xsurface->xwm->xcb_conn, 0, xsurface->window_id,
+		property, XCB_ATOM_ANY, 0, 2048);
+	pending_reply_create(xsurface, cookie.sequence, property);
+}
+
+static void xsurface_request_client_id(struct wlr_xwayland_surface *xsurface) {
+	xcb_res_client_id_spec_t spec = {
+		.client = xsurface->window_id,
+		.mask = XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID
+	};
+	xcb_res_query_client_ids_cookie_t cookie =
+		xcb_res_query_client_ids(xsurface->xwm->xcb_conn, 1, &spec);
+	pending_reply_create(xsurface, cookie.sequence, XCB_ATOM_NONE);
+}
+
+static void xsurface_consider_map(struct wlr_xwayland_surface *surface);
+
+/**
+ * Handle the replies which have been received. Returns the number of replies
+ * handled.
+ */
+static int xwm_handle_pending_replies(struct wlr_xwm *xwm) {
+	int count = 0;
+	while (!wl_list_empty(&xwm->pending_replies)) {
+		struct xwm_pending_reply *pending =
+			wl_container_of(xwm->pending_replies.next, pending, link);
+
+		void *reply = NULL;
+		xcb_generic_error_t *error = NULL;
+		if (!xcb_poll_for_reply(xwm->xcb_conn, pending->sequence,
+				&reply, &error)) {
+			// Replies are received in order, the next ones aren't there
+			// either
+			break;
+		}
+		count++;
+
+		struct wlr_xwayland_surface *xsurface = pending->xsurface;
+		xcb_atom_t property = pending->property;
+		pending_reply_destroy(xwm, pending, false);
+
+		if (reply != NULL) {
+			if (property == XCB_ATOM_NONE) {
+				read_surface_client_id(xwm, xsurface, reply);
+			} else {
+				read_surface_property(xwm, xsurface, property, reply);
+			}
+		}
+		free(reply);
+		free(error);
+
+		if (wl_list_empty(&xsurface->pending_replies)) {
+			xsurface_consider_map(xsurface);
+		}
+	}
+	return count;
+}
+
+/**
+ * Map the surface once it has a buffer. Mapping is delayed until the window
+ * properties requested when the surface was associated have been received,
+ * so that the compositor sees them when handling the map event.
+ */
+static void xsurface_consider_map(struct wlr_xwayland_surface *surface) {
+	if (surface->mapped || surface->surface == NULL ||
+			!wlr_surface_has_buffer(surface->surface) ||
+			!wl_list_empty(&surface->pending_replies)) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&surface->events.map, surface);
+	surface->mapped = true;
+	xwm_client_list_add(surface->xwm, surface->window_id);
 }
 
 static void xwayland_surface_role_commit(struct wlr_surface *wlr_surface) {
@@ -808,11 +1102,7 @@ static void xwayland_surface_role_commit(struct wlr_surface *wlr_surface) {
 		return;
 	}
 
-	if (!surface->mapped && wlr_surface_has_buffer(surface->surface)) {
-		wlr_signal_emit_safe(&surface->events.map, surface);
-		surface->mapped = true;
-		xwm_set_net_client_list(surface->xwm);
-	}
+	xsurface_consider_map(surface);
 }
 
 static void xwayland_surface_role_precommit(struct wlr_surface *wlr_surface) {
@@ -828,7 +1118,7 @@ static void xwayland_surface_role_precommit(struct wlr_surface *wlr_surface) {
 		if (surface->mapped) {
 			wlr_signal_emit_safe(&surface->events.unmap, surface);
 			surface->mapped = false;
-			xwm_set_net_client_list(surface->xwm);
+			xwm_client_list_remove(surface->xwm, surface->window_id);
 		}
 	}
 }
@@ -868,11 +1158,12 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 		xwm->atoms[NET_WM_WINDOW_TYPE],
 		xwm->atoms[NET_WM_NAME],
 	};
+	// The replies are handled by the X11 event handler
 	for (size_t i = 0; i < sizeof(props)/sizeof(xcb_atom_t); i++) {
-		read_surface_property(xwm, xsurface, props[i]);
+		xsurface_request_property(xsurface, props[i]);
 	}
 	if (xwm->xres) {
-		read_surface_client_id(xwm, xsurface);
+		xsurface_request_client_id(xsurface);
 	}
 
 	xsurface->surface_destroy.notify = handle_surface_destroy;
@@ -883,15 +1174,14 @@ static void xsurface_unmap(struct wlr_xwayland_surface *surface) {
 	if (surface->mapped) {
 		wlr_signal_emit_safe(&surface->events.unmap, surface);
 		surface->mapped = false;
-		xwm_set_net_client_list(surface->xwm);
+		xwm_client_list_remove(surface->xwm, surface->window_id);
 	}
 
 	if (surface->surface_id) {
 		// Make sure we're not on the unpaired surface list or we
 		// could be assigned a surface during surface creation that
 		// was mapped before this unmap request.
-		wl_list_remove(&surface->unpaired_link);
-		surface->surface_id = 0;
+		xsurface_clear_unpaired(surface);
 	}
 
 	if (surface->surface) {
@@ -1080,7 +1370,7 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	read_surface_property(xwm, xsurface, ev->atom);
+	xsurface_request_property(xsurface, ev->atom);
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -1092,17 +1382,24 @@ static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
 			ev->window);
 		return;
 	}
-	/* Check if we got notified after wayland surface create event */
 	uint32_t id = ev->data.data32[0];
+	if (id == 0) {
+		// 0 is never a valid object ID, and marks free slots in the ID maps
+		wlr_log(WLR_DEBUG, "client message WL_SURFACE_ID with invalid "
+			"surface ID 0 for window %u", ev->window);
+		return;
+	}
+
+	/* Check if we got notified after wayland surface create event */
 	struct wl_resource *resource =
 		wl_client_get_object(xwm->xwayland->server->client, id);
 	if (resource) {
 		struct wlr_surface *surface = wlr_surface_from_resource(resource);
-		xsurface->surface_id = 0;
+		xsurface_clear_unpaired(xsurface);
 		xwm_map_shell_surface(xwm, xsurface, surface);
 	} else {
-		xsurface->surface_id = id;
-		wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+		xsurface_clear_unpaired(xsurface);
+		xsurface_set_unpaired(xsurface, id);
 	}
 }
 
@@ -1545,6 +1842,8 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 		free(event);
 	}
 
+	count += xwm_handle_pending_replies(xwm);
+
 	if (count) {
 		xcb_flush(xwm->xcb_conn);
 	}
@@ -1566,15 +1865,13 @@ static void handle_compositor_new_surface(struct wl_listener *listener,
 	wlr_log(WLR_DEBUG, "New xwayland surface: %p", surface);
 
 	uint32_t surface_id = wl_resource_get_id(surface->resource);
-	struct wlr_xwayland_surface *xsurface;
-	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
-		if (xsurface->surface_id == surface_id) {
-			xwm_map_shell_surface(xwm, xsurface, surface);
-			xsurface->surface_id = 0;
-			wl_list_remove(&xsurface->unpaired_link);
-			xcb_flush(xwm->xcb_conn);
-			return;
-		}
+	struct xwm_id_map_entry *entry =
+		id_map_find(&xwm->unpaired_by_surface_id, surface_id);
+	if (entry != NULL) {
+		struct wlr_xwayland_surface *xsurface = entry->surface;
+		xwm_map_shell_surface(xwm, xsurface, surface);
+		xsurface_clear_unpaired(xsurface);
+		xcb_flush(xwm->xcb_conn);
 	}
 }
 
@@ -1686,6 +1983,13 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	wl_list_for_each_safe(xsurface, tmp, &xwm->unpaired_surfaces, unpaired_link) {
 		xwayland_surface_destroy(xsurface);
 	}
+	if (xwm->client_list_idle) {
+		wl_event_source_remove(xwm->client_list_idle);
+	}
+	free(xwm->client_list);
+	free(xwm->client_list_stacking);
+	id_map_finish(&xwm->surfaces_by_window);
+	id_map_finish(&xwm->unpaired_by_surface_id);
 	wl_list_remove(&xwm->compositor_new_surface.link);
 	wl_list_remove(&xwm->compositor_destroy.link);
 	xcb_disconnect(xwm->xcb_conn);
@@ -1930,6 +2234,7 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	wl_list_init(&xwm->surfaces);
 	wl_list_init(&xwm->surfaces_in_stack_order);
 	wl_list_init(&xwm->unpaired_surfaces);
+	wl_list_init(&xwm->pending_replies);
 	xwm->ping_timeout = 10000;
 
 	xwm->xcb_conn = xcb_connect_to_fd(wm_fd, NULL);